@@ -35,6 +35,12 @@ class AudioAnnouncer {
         this.audioCache = new Map();
         this.preloadedAudios = new Set();
         
+        // Voice packs downloaded as one bundle and kept in IndexedDB
+        // (Cache Storage needs a secure context, the device serves plain http)
+        this.audioDbPromise = null;
+        this.cachedAudioUrls = new Map();
+        this.voicePackLoads = new Map();
+        
         // Load TTS engine preference
         const savedEngine = localStorage.getItem('ttsEngine');
         if (savedEngine) {
@@ -83,9 +89,15 @@ class AudioAnnouncer {
             return true;
         }
         
+        if (await this.getCachedAudioUrl(audioPath)) {
+            this.preloadedAudios.add(audioPath);
+            return true;
+        }
+        
         try {
-            // Use GET instead of HEAD for better compatibility
-            const response = await fetch(audioPath, { method: 'GET', cache: 'no-cache' });
+            // Use GET instead of HEAD for better compatibility. Voice clips are
+            // served immutable with an ETag, so this normally hits the browser cache
+            const response = await fetch(audioPath, { method: 'GET' });
             if (response.ok) {
                 this.preloadedAudios.add(audioPath);
                 console.log('[AudioAnnouncer] Verified audio file exists:', audioPath);
@@ -100,10 +112,157 @@ class AudioAnnouncer {
         return false;
     }
 
+    /**
+     * Open the local audio database (null if IndexedDB is unavailable)
+     */
+    openAudioDb() {
+        if (!this.audioDbPromise) {
+            this.audioDbPromise = new Promise((resolve) => {
+                if (!window.indexedDB) {
+                    resolve(null);
+                    return;
+                }
+                const request = indexedDB.open('fpvgate-audio', 1);
+                request.onupgradeneeded = () => {
+                    request.result.createObjectStore('clips');  // path -> Blob
+                    request.result.createObjectStore('packs');  // voice dir -> bundle ETag
+                };
+                request.onsuccess = () => resolve(request.result);
+                request.onerror = () => {
+                    console.warn('[AudioAnnouncer] IndexedDB unavailable:', request.error);
+                    resolve(null);
+                };
+            });
+        }
+        return this.audioDbPromise;
+    }
+
+    idbGet(db, store, key) {
+        return new Promise((resolve, reject) => {
+            const request = db.transaction(store, 'readonly').objectStore(store).get(key);
+            request.onsuccess = () => resolve(request.result);
+            request.onerror = () => reject(request.error);
+        });
+    }
+
+    /**
+     * Split a ustar archive into { name, data } entries
+     */
+    parseTar(buffer) {
+        const bytes = new Uint8Array(buffer);
+        const decoder = new TextDecoder();
+        const field = (start, length) =>
+            decoder.decode(bytes.subarray(start, start + length)).replace(/\0.*$/s, '').trim();
+        const files = [];
+        let offset = 0;
+        
+        while (offset + 512 <= bytes.length) {
+            const name = field(offset, 100);
+            if (!name) break;  // End-of-archive zero block
+            const size = parseInt(field(offset + 124, 12), 8) || 0;
+            offset += 512;
+            files.push({ name, data: bytes.slice(offset, offset + size) });
+            offset += Math.ceil(size / 512) * 512;
+        }
+        return files;
+    }
+
+    /**
+     * Download a whole voice pack in one request and store it locally.
+     * Revalidated with the bundle ETag, so an unchanged pack costs one 304.
+     */
+    loadVoicePack(voice = this.selectedVoice) {
+        const voiceDir = this.voiceDirectories[voice];
+        // The desktop app loads the clips from its own files already
+        if (!voiceDir || location.protocol === 'file:') {
+            return Promise.resolve(false);
+        }
+        if (!this.voicePackLoads.has(voiceDir)) {
+            const load = this.fetchVoicePack(voiceDir).finally(() => this.voicePackLoads.delete(voiceDir));
+            this.voicePackLoads.set(voiceDir, load);
+        }
+        return this.voicePackLoads.get(voiceDir);
+    }
+
+    async fetchVoicePack(voiceDir) {
+        const db = await this.openAudioDb();
+        if (!db) return false;
+        
+        try {
+            const etag = await this.idbGet(db, 'packs', voiceDir);
+            const response = await fetch(`/voices/bundle?dir=${encodeURIComponent(voiceDir)}`, {
+                cache: 'no-store',
+                headers: etag ? { 'If-None-Match': etag } : {}
+            });
+            if (response.status === 304) {
+                console.log('[AudioAnnouncer] Voice pack up to date:', voiceDir);
+                return true;
+            }
+            if (!response.ok) {
+                console.warn('[AudioAnnouncer] Voice pack not available (status ' + response.status + '):', voiceDir);
+                return false;
+            }
+            
+            const files = this.parseTar(await response.arrayBuffer());
+            await new Promise((resolve, reject) => {
+                const tx = db.transaction(['clips', 'packs'], 'readwrite');
+                const clips = tx.objectStore('clips');
+                clips.delete(IDBKeyRange.bound(`${voiceDir}/`, `${voiceDir}/\uffff`));
+                for (const file of files) {
+                    clips.put(new Blob([file.data], { type: 'audio/mpeg' }), `${voiceDir}/${file.name}`);
+                }
+                tx.objectStore('packs').put(response.headers.get('ETag'), voiceDir);
+                tx.oncomplete = resolve;
+                tx.onerror = () => reject(tx.error);
+            });
+            
+            this.releaseCachedUrls(voiceDir);
+            console.log(`[AudioAnnouncer] Voice pack ${voiceDir} cached (${files.length} clips)`);
+            return true;
+        } catch (e) {
+            console.warn('[AudioAnnouncer] Voice pack download failed:', voiceDir, e);
+            return false;
+        }
+    }
+
+    /**
+     * Object URL for a locally stored clip, or null to fetch it from the device
+     */
+    async getCachedAudioUrl(audioPath) {
+        const key = audioPath.replace(/^\//, '');
+        if (this.cachedAudioUrls.has(key)) {
+            return this.cachedAudioUrls.get(key);
+        }
+        const db = await this.openAudioDb();
+        if (!db) return null;
+        
+        try {
+            const blob = await this.idbGet(db, 'clips', key);
+            if (!blob) return null;
+            const url = URL.createObjectURL(blob);
+            this.cachedAudioUrls.set(key, url);
+            return url;
+        } catch (e) {
+            return null;
+        }
+    }
+
+    releaseCachedUrls(voiceDir) {
+        for (const [key, url] of this.cachedAudioUrls) {
+            if (key.startsWith(`${voiceDir}/`)) {
+                URL.revokeObjectURL(url);
+                this.cachedAudioUrls.delete(key);
+            }
+        }
+    }
+
     /**
      * Play pre-recorded audio file with optimized playback and instant transitions
      */
     async playPrerecorded(audioPath) {
+        // Local copy from the voice pack if there is one
+        const source = this.audioCache.has(audioPath) ? null : (await this.getCachedAudioUrl(audioPath)) || audioPath;
+        
         return new Promise((resolve, reject) => {
             // Check cache first
             if (this.audioCache.has(audioPath)) {
@@ -140,7 +299,7 @@ class AudioAnnouncer {
             audio.preload = 'auto';
             audio.playbackRate = this.rate;
             audio.preservesPitch = false;
-            audio.src = audioPath;
+            audio.src = source;
             
             let resolved = false;
             
@@ -615,6 +774,10 @@ class AudioAnnouncer {
         this.preloadedAudios.clear();
         
         console.log('[AudioAnnouncer] Voice changed, cache cleared');
+        
+        if (this.audioEnabled) {
+            this.loadVoicePack(voice);
+        }
     }
 
     /**
@@ -627,6 +790,9 @@ class AudioAnnouncer {
         // iOS/Safari requires audio to be "unlocked" with user interaction
         await this.unlockAudioContextiOS();
         
+        // Fetch the voice pack in the background; clips stream from the device until it lands
+        this.loadVoicePack();
+        
         this.processQueue();  // Start processing any queued items
     }
     
@@ -41,11 +41,30 @@ const bandNames = ['A', 'B', 'E', 'F', 'R', 'L'];
 // Initialize on load
 window.addEventListener('load', () => {
   console.log('FPVGate OSD loaded');
-  loadConfig();
+  loadBands().then(loadConfig);
   connectToEvents();
   startCurrentLapTimer();
 });
 
+// Band plan from the timer, matched to the built-in table by letter like
+// script.js does; keeps the built-in rows if it can't be fetched
+function loadBands() {
+  return fetch('/bands')
+    .then(response => response.json())
+    .then(plan => {
+      if (!plan.bands) return;
+      plan.bands.forEach(band => {
+        const i = bandNames.indexOf(band.band);
+        if (i >= 0 && band.freq.length === freqLookup[i].length) {
+          freqLookup[i] = band.freq;
+        }
+      });
+    })
+    .catch(error => {
+      console.warn('Band plan unavailable, using built-in table:', error);
+    });
+}
+
 // Load configuration
 function loadConfig() {
   fetch('/config')
@@ -29,6 +29,7 @@ const freqLookup = [
   [5658, 5695, 5732, 5769, 5806, 5843, 5880, 5917],
   [5362, 5399, 5436, 5473, 5510, 5547, 5584, 5621],
 ];
+// Built-in table above is the fallback; loadBands() replaces rows with the timer's band plan
 
 const config = document.getElementById("config");
 const race = document.getElementById("race");
@@ -210,9 +211,19 @@ function setupWiFiEvents() {
       addLap(lap);
       console.log("lap raw:", e.data, " formatted:", lap);
     }, false);
+    
+    eventSource.addEventListener("storageError", function (e) {
+      reportStorageError(JSON.parse(e.data));
+    }, false);
   }
 }
 
+// Saves return before the device has written them; a failed write comes back as an event
+function reportStorageError(data) {
+  console.error("Storage write failed:", data.path);
+  alert(`Saving to the timer failed (${data.path}). The change may be lost after a restart.`);
+}
+
 function setupUSBEvents() {
   if (!transportManager) return;
   
@@ -230,6 +241,10 @@ function setupUSBEvents() {
     console.log("USB lap raw:", data, " formatted:", lap);
   });
   
+  transportManager.on('storageError', (data) => {
+    reportStorageError(data);
+  });
+  
   transportManager.on('disconnect', () => {
     console.log('USB disconnected');
     usbConnected = false;
@@ -310,6 +325,10 @@ onload = async function (e) {
   // Initialize transport (USB/WiFi)
   await initializeTransport();
   
+  if (!usbConnected) {
+    await loadBands();
+  }
+
   // Fetch config using appropriate transport
   let configData;
   try {
@@ -459,6 +478,11 @@ onload = async function (e) {
         webhookLapToggle.checked = configData.webhookLap === 1;
       }
       
+      const rawRecordToggle = document.getElementById('rawRecord');
+      if (rawRecordToggle && configData.rawRecord !== undefined) {
+        rawRecordToggle.checked = configData.rawRecord === 1;
+      }
+      
       // Initialize battery monitoring UI on page load (default is disabled)
       const batterySection = document.getElementById('batteryMonitoringSection');
       const batteryToggle = document.getElementById('batteryMonitorToggle');
@@ -967,12 +991,19 @@ function startTimer() {
     timer.innerHTML = `${m}:${s}:${ms}s`;
   }, 10);
 
+  // Race metadata for the on-device recorder
+  const raceInfo = {
+    timestamp: Math.floor(Date.now() / 1000),
+    callsign: document.getElementById('pcallsign')?.value || '',
+    band: bandSelect.options[bandSelect.selectedIndex].value,
+    channel: parseInt(channelSelect.options[channelSelect.selectedIndex].value)
+  };
   if (usbConnected && transportManager) {
-    transportManager.sendCommand('timer/start', 'POST')
+    transportManager.sendCommand('timer/start', 'POST', raceInfo)
       .then((response) => console.log("/timer/start:", response))
       .catch(err => console.error('Failed to start timer:', err));
   } else {
-    fetch("/timer/start", {
+    fetch("/timer/start?" + new URLSearchParams(raceInfo).toString(), {
       method: "POST",
       headers: {
         Accept: "application/json",
@@ -1275,6 +1306,20 @@ function toggleWebhookRaceStop(enabled) {
     .catch(err => console.error('Failed to toggle webhook race stop:', err));
 }
 
+function toggleRawRecord(enabled) {
+  fetch('/config', {
+    method: 'POST',
+    headers: {
+      'Accept': 'application/json',
+      'Content-Type': 'application/json'
+    },
+    body: JSON.stringify({ rawRecord: enabled ? 1 : 0 })
+  })
+    .then(response => response.json())
+    .then(data => console.log('Raw RSSI recording:', enabled ? 'enabled' : 'disabled', data))
+    .catch(err => console.error('Failed to toggle raw RSSI recording:', err));
+}
+
 function toggleWebhookLap(enabled) {
   const enable = enabled ? 1 : 0;
   
@@ -1433,9 +1478,9 @@ function stopRace() {
   // Stop distance polling
   stopDistancePolling();
 
-  // Auto-save race if there are laps
+  // The device records and saves the race itself, just refresh history
   if (lapTimes.length > 0) {
-    saveCurrentRace();
+    setTimeout(loadRaceHistory, 1000);
   }
 
   lapNo = -1;
@@ -1450,11 +1495,6 @@ function stopRace() {
 }
 
 function clearLaps() {
-  // Auto-save race if there are laps before clearing
-  if (lapTimes.length > 0) {
-    saveCurrentRace();
-  }
-
   var tableHeaderRowCount = 1;
   var rowCount = lapTable.rows.length;
   for (var i = tableHeaderRowCount; i < rowCount; i++) {
@@ -1478,6 +1518,24 @@ function clearLaps() {
 
 // EventSource initialization moved to setupWiFiEvents() function above
 
+// Band plan from the timer, matched to the band dropdown by letter
+async function loadBands() {
+  try {
+    const response = await fetch("/bands");
+    if (!response.ok) return;
+    const plan = await response.json();
+    plan.bands.forEach(band => {
+      for (let i = 0; i < bandSelect.options.length; i++) {
+        if (bandSelect.options[i].value === band.band && band.freq.length === freqLookup[i].length) {
+          freqLookup[i] = band.freq;
+        }
+      }
+    });
+  } catch (err) {
+    console.warn('[Script] Band plan unavailable, using built-in table:', err);
+  }
+}
+
 function setBandChannelIndex(freq) {
   for (var i = 0; i < freqLookup.length; i++) {
     for (var j = 0; j < freqLookup[i].length; j++) {
@@ -1752,77 +1810,23 @@ function createBarItemWithColor(label, time, maxTime, displayTime, colorIndex) {
 
 // Race History Functions
 let raceHistoryData = [];
+let rawRecordings = new Set();  // Race timestamps with a raw RSSI recording on SD
 let currentDetailRace = null;
 
-function saveCurrentRace() {
-  if (lapTimes.length === 0) return;
-  
-  // Calculate stats
-  const fastest = Math.min(...lapTimes);
-  const sorted = [...lapTimes].sort((a, b) => a - b);
-  const mid = Math.floor(sorted.length / 2);
-  const median = sorted.length % 2 === 0 ? (sorted[mid - 1] + sorted[mid]) / 2 : sorted[mid];
-  
-  let best3Total = 0;
-  if (lapTimes.length >= 3) {
-    const best3 = sorted.slice(0, 3);
-    best3Total = best3.reduce((sum, t) => sum + t, 0);
-  }
-  
-  // Get current pilot and frequency info
-  const pilotCallsign = document.getElementById('pcallsign')?.value || '';
-  const bandValue = bandSelect.options[bandSelect.selectedIndex].value;
-  const channelValue = parseInt(channelSelect.options[channelSelect.selectedIndex].value);
-  
-  // Calculate total race distance: track length per lap × number of laps
-  let totalRaceDistance = 0;
-  console.log(`DEBUG: trackLapLength=${trackLapLength}, currentTrackId=${currentTrackId}, currentTrackName='${currentTrackName}'`);
-  if (trackLapLength > 0 && lapTimes.length > 0) {
-    totalRaceDistance = trackLapLength * lapTimes.length;
-    console.log(`Saving race: trackLapLength=${trackLapLength}m, lapCount=${lapTimes.length}, totalDistance=${totalRaceDistance}m`);
-  } else {
-    console.warn(`WARNING: No track distance to save! trackLapLength=${trackLapLength}, lapCount=${lapTimes.length}`);
-    console.warn(`Did you select a track before starting the race? currentTrackId=${currentTrackId}`);
-  }
-  
-  const raceData = {
-    timestamp: Math.floor(Date.now() / 1000),
-    lapTimes: lapTimes.map(t => Math.round(t * 1000)), // Convert to milliseconds
-    fastestLap: Math.round(fastest * 1000),
-    medianLap: Math.round(median * 1000),
-    best3LapsTotal: Math.round(best3Total * 1000),
-    pilotName: pilotNameInput.value || '',
-    pilotCallsign: pilotCallsign,
-    frequency: frequency,
-    band: bandValue,
-    channel: channelValue,
-    trackId: currentTrackId || 0,
-    trackName: currentTrackName || '',
-    totalDistance: totalRaceDistance
-  };
-  
-  fetch('/races/save', {
-    method: 'POST',
-    headers: {
-      'Accept': 'application/json',
-      'Content-Type': 'application/json'
-    },
-    body: JSON.stringify(raceData)
-  })
-  .then(response => response.json())
-  .then(data => {
-    console.log('Race saved:', data);
-    loadRaceHistory();
-  })
-  .catch(error => console.error('Error saving race:', error));
-}
-
 function loadRaceHistory() {
   fetch('/races')
     .then(response => response.json())
     .then(data => {
       raceHistoryData = data.races || [];
       renderRaceHistory();
+      return fetch('/rawrssi');
+    })
+    .then(response => response.json())
+    .then(data => {
+      rawRecordings = new Set((data.recordings || []).map(r => r.timestamp));
+      if (rawRecordings.size > 0) {
+        renderRaceHistory();
+      }
     })
     .catch(error => console.error('Error loading races:', error));
 }
@@ -1853,6 +1857,7 @@ function renderRaceHistory() {
         <div class="race-item-buttons">
           <button class="race-item-button" onclick="event.stopPropagation(); openEditModal(${index})">Edit</button>
           <button class="race-item-button" onclick="event.stopPropagation(); downloadSingleRace(${race.timestamp})">Download</button>
+          ${rawRecordings.has(race.timestamp) ? `<button class="race-item-button" onclick="event.stopPropagation(); downloadRawRssi(${race.timestamp})">Raw RSSI</button>` : ''}
           <button class="race-item-button" style="border-color: #e74c3c; color: #e74c3c;" onclick="event.stopPropagation(); deleteRace(${race.timestamp})">Delete</button>
         </div>
         <div class="race-item-header">
@@ -1987,10 +1992,16 @@ function downloadSingleRace(timestamp) {
   window.open('/races/downloadOne?timestamp=' + timestamp, '_blank');
 }
 
+function downloadRawRssi(timestamp) {
+  window.open('/rawrssi/download?timestamp=' + timestamp, '_blank');
+}
+
 let editingRaceIndex = null;
+let pendingLapEdits = [];  // Lap operations replayed on the device when saving
 
 function openEditModal(index) {
   editingRaceIndex = index;
+  pendingLapEdits = [];
   const race = raceHistoryData[index];
   
   document.getElementById('raceName').value = race.name || '';
@@ -2018,6 +2029,12 @@ function renderEditLapsList(lapTimes) {
                style="flex: 1; padding: 6px; background-color: var(--bg-primary); border: 1px solid var(--border-color); border-radius: 4px; color: var(--primary-color);" 
                title="Edit lap time in seconds" />
         <span style="min-width: 20px;">s</span>
+        <button onclick="splitLapInEdit(${index})" 
+                style="padding: 4px 8px; background-color: var(--bg-primary); border: 1px solid var(--border-color); border-radius: 4px; color: var(--primary-color); cursor: pointer;" 
+                title="Split into two laps (missed gate pass)">Split</button>
+        <button onclick="mergeLapInEdit(${index})" ${index === lapTimes.length - 1 ? 'disabled' : ''}
+                style="padding: 4px 8px; background-color: var(--bg-primary); border: 1px solid var(--border-color); border-radius: 4px; color: var(--primary-color); cursor: pointer;" 
+                title="Merge with the next lap (false gate pass)">Merge</button>
         <button onclick="deleteLapFromEdit(${index})" 
                 style="padding: 4px 10px; background-color: var(--danger-color); border: none; border-radius: 4px; color: white; cursor: pointer; font-size: 18px; line-height: 1;" 
                 title="Delete this lap">&times;</button>
@@ -2039,10 +2056,39 @@ function deleteLapFromEdit(index) {
   
   if (confirm('Delete this lap?')) {
     race.lapTimes.splice(index, 1);
+    pendingLapEdits.push({ op: 'delete', index: index });
     renderEditLapsList(race.lapTimes);
   }
 }
 
+function splitLapInEdit(index) {
+  if (editingRaceIndex === null) return;
+  const race = raceHistoryData[editingRaceIndex];
+  const lapTime = race.lapTimes[index];
+  
+  const input = prompt('Time of the first part in seconds:', (lapTime / 2000).toFixed(3));
+  if (input === null) return;
+  const first = Math.round(parseFloat(input) * 1000);
+  if (isNaN(first) || first <= 0 || first >= lapTime) {
+    alert('The first part must be shorter than the lap');
+    return;
+  }
+  
+  race.lapTimes.splice(index, 1, first, lapTime - first);
+  pendingLapEdits.push({ op: 'split', index: index, lapTime: first });
+  renderEditLapsList(race.lapTimes);
+}
+
+function mergeLapInEdit(index) {
+  if (editingRaceIndex === null) return;
+  const race = raceHistoryData[editingRaceIndex];
+  if (index + 1 >= race.lapTimes.length) return;
+  
+  race.lapTimes.splice(index, 2, race.lapTimes[index] + race.lapTimes[index + 1]);
+  pendingLapEdits.push({ op: 'merge', index: index });
+  renderEditLapsList(race.lapTimes);
+}
+
 function addNewLapToEdit() {
   if (editingRaceIndex === null) return;
   const race = raceHistoryData[editingRaceIndex];
@@ -2056,6 +2102,7 @@ function addNewLapToEdit() {
     defaultValue = 10000; // 10 seconds default
   }
   
+  pendingLapEdits.push({ op: 'insert', index: race.lapTimes.length, lapTime: defaultValue });
   race.lapTimes.push(defaultValue);
   renderEditLapsList(race.lapTimes);
   
@@ -2067,6 +2114,7 @@ function addNewLapToEdit() {
 function closeEditModal() {
   document.getElementById('editRaceModal').style.display = 'none';
   editingRaceIndex = null;
+  pendingLapEdits = [];
 }
 
 function closeEditModalOnBackdrop(event) {
@@ -2111,6 +2159,14 @@ function saveRaceEdit() {
     return;
   }
   
+  // Typed changes become 'set' edits after the structural ones
+  const lapEdits = pendingLapEdits.slice();
+  updatedLapTimes.forEach((lapTime, index) => {
+    if (lapTime !== race.lapTimes[index]) {
+      lapEdits.push({ op: 'set', index: index, lapTime: lapTime });
+    }
+  });
+  
   // First update metadata (name/tag/distance)
   const formData = new URLSearchParams();
   formData.append('timestamp', race.timestamp);
@@ -2129,22 +2185,12 @@ function saveRaceEdit() {
   .then(data => {
     console.log('Race metadata updated:', data);
     
-    // Then update lap times if they changed
-    return fetch('/races/updateLaps', {
-      method: 'POST',
-      headers: {
-        'Accept': 'application/json',
-        'Content-Type': 'application/json'
-      },
-      body: JSON.stringify({
-        timestamp: race.timestamp,
-        lapTimes: updatedLapTimes
-      })
-    });
+    // Then all lap edits in one request, in the order they were made; the
+    // device applies all of them or none
+    return lapEdits.length > 0 ? sendLapEdits(race.timestamp, lapEdits) : null;
   })
-  .then(response => response.json())
-  .then(data => {
-    console.log('Race laps updated:', data);
+  .then(() => {
+    console.log('Race laps updated:', lapEdits.length, 'edits');
     loadRaceHistory();
     closeEditModal();
   })
@@ -2154,6 +2200,23 @@ function saveRaceEdit() {
   });
 }
 
+function sendLapEdits(timestamp, edits) {
+  return fetch('/races/editLaps', {
+    method: 'POST',
+    headers: {
+      'Content-Type': 'application/json'
+    },
+    body: JSON.stringify({ timestamp: timestamp, edits: edits })
+  })
+  .then(response => response.json())
+  .then(data => {
+    if (data.status !== 'OK') {
+      throw new Error(data.message || 'Lap edits rejected');
+    }
+    return data;
+  });
+}
+
 function importRaces(input) {
   const file = input.files[0];
   if (!file) return;
@@ -2459,14 +2522,62 @@ function startCalibrationWizard() {
     });
 }
 
+// Append the samples recorded since the last poll to wizardState.data
+function fetchCalibrationSamples() {
+  return fetch('/calibration/data?since=' + wizardState.data.length)
+    .then(response => response.json())
+    .then(data => {
+      if (data.since < wizardState.data.length) {
+        wizardState.data.length = data.since;  // Recording restarted
+      }
+      const count = Math.min(data.rssi.length, data.time.length);
+      for (let i = 0; i < count; i++) {
+        wizardState.data.push({ rssi: data.rssi[i], time: data.time[i] });
+      }
+      return data;
+    });
+}
+
+// Last 10 seconds of the recording, so passes can be checked while flying
+function drawWizardLiveChart() {
+  const canvas = document.getElementById('wizardLiveChart');
+  if (!canvas) return;
+  const ctx = canvas.getContext('2d');
+  canvas.width = canvas.offsetWidth;
+  canvas.height = 120;
+  
+  const samples = wizardState.data.slice(-500);
+  ctx.fillStyle = getComputedStyle(document.body).getPropertyValue('--bg-primary').trim();
+  ctx.fillRect(0, 0, canvas.width, canvas.height);
+  if (samples.length < 2) return;
+  
+  const rssiValues = samples.map(d => d.rssi);
+  const minRssi = Math.min(...rssiValues) - 5;
+  const rssiRange = Math.max(Math.max(...rssiValues) + 5 - minRssi, 1);
+  
+  ctx.strokeStyle = '#00d4ff';
+  ctx.lineWidth = 2;
+  ctx.beginPath();
+  rssiValues.forEach((rssi, i) => {
+    const x = (i / (rssiValues.length - 1)) * canvas.width;
+    const y = canvas.height - ((rssi - minRssi) / rssiRange) * canvas.height;
+    if (i === 0) {
+      ctx.moveTo(x, y);
+    } else {
+      ctx.lineTo(x, y);
+    }
+  });
+  ctx.stroke();
+}
+
 function wizardRecordingLoop() {
   if (!wizardState.recording) return;
   
-  // Fetch current sample count
-  fetch('/calibration/data')
-    .then(response => response.json())
+  // Fetch only the new samples and plot them
+  fetchCalibrationSamples()
     .then(data => {
       document.getElementById('wizardSampleCount').textContent = `Samples: ${data.count}`;
+      drawWizardLiveChart();
       if (wizardState.recording) {
         setTimeout(wizardRecordingLoop, 200);
       }
@@ -2482,13 +2593,11 @@ function stopCalibrationWizard() {
   fetch('/calibration/stop', { method: 'POST' })
     .then(response => response.json())
     .then(() => {
-      // Fetch recorded data
-      return fetch('/calibration/data');
+      // Fetch the samples recorded since the last poll
+      return fetchCalibrationSamples();
     })
-    .then(response => response.json())
     .then(data => {
       console.log('Calibration data received:', data.count, 'samples');
-      wizardState.data = data.data;
       
       if (wizardState.data.length < 10) {
         alert('Not enough data recorded. Please try again with at least 3 clear gate passes.');
@@ -2758,6 +2867,8 @@ function cancelCalibrationWizard() {
 
 function closeCalibrationWizard() {
   wizardState.recording = false;
+  // Recording buffer is only needed while the wizard is open
+  fetch('/calibration/clear', { method: 'POST' }).catch(() => {});
   document.getElementById('calibrationWizardModal').style.display = 'none';
   document.getElementById('wizardRecording').style.display = 'none';
   document.getElementById('wizardMarking').style.display = 'none';
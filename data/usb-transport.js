@@ -418,10 +418,11 @@ class TransportManager {
      * Start timer
      */
     async startTimer() {
+        const timestamp = Math.floor(Date.now() / 1000);
         if (this.mode === 'usb') {
-            await this.usb.sendCommand('timer/start');
+            await this.usb.sendCommand('timer/start', 'POST', { timestamp });
         } else {
-            await fetch('/timer/start', { method: 'POST' });
+            await fetch('/timer/start?timestamp=' + timestamp, { method: 'POST' });
         }
     }
 
@@ -0,0 +1,49 @@
+#include "bands.h"
+
+constexpr band_t Bands::table[BAND_COUNT];
+
+int8_t Bands::bandIndex(char letter) {
+    for (uint8_t b = 0; b < BAND_COUNT; b++) {
+        if (table[b].letter == letter) {
+            return b;
+        }
+    }
+    return -1;
+}
+
+bool Bands::find(uint16_t frequency, uint8_t &band, uint8_t &channel) {
+    for (uint8_t b = 0; b < BAND_COUNT; b++) {
+        for (uint8_t c = 0; c < BAND_CHANNELS; c++) {
+            if (table[b].channels[c].frequency == frequency) {
+                band = b;
+                channel = c;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint16_t Bands::registerValue(uint16_t frequency) {
+    uint8_t band, channel;
+    if (find(frequency, band, channel)) {
+        return lookup(band, channel).reg;
+    }
+    return rx5808RegisterValue(frequency);
+}
+
+void Bands::toJson(Print &out) {
+    out.print("{\"bands\":[");
+    for (uint8_t b = 0; b < BAND_COUNT; b++) {
+        out.printf("%s{\"band\":\"%c\",\"name\":\"%s\",\"freq\":[", b > 0 ? "," : "", table[b].letter, table[b].name);
+        for (uint8_t c = 0; c < BAND_CHANNELS; c++) {
+            out.printf("%s%u", c > 0 ? "," : "", lookup(b, c).frequency);
+        }
+        out.print("],\"reg\":[");
+        for (uint8_t c = 0; c < BAND_CHANNELS; c++) {
+            out.printf("%s%u", c > 0 ? "," : "", lookup(b, c).reg);
+        }
+        out.print("]}");
+    }
+    out.print("]}");
+}
@@ -0,0 +1,72 @@
+#ifndef BANDS_H
+#define BANDS_H
+
+/**
+ * 5.8 GHz band plan
+ *
+ * Every standard band and channel with its frequency and RX5808
+ * synthesiser register value, worked out at compile time.
+ *
+ * - lookup() is band/channel to frequency and register, a plain index.
+ * - registerValue() is what the receiver driver tunes with: the table
+ *   entry for band plan frequencies, and the same constexpr formula the
+ *   table is built from for anything else (spectrum points, custom
+ *   channels), so the two can't disagree.
+ * - /bands serves the table to the web UI, config accepts a band and
+ *   channel in place of a frequency and reports the band and channel it
+ *   is on.
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#define BAND_COUNT 6
+#define BAND_CHANNELS 8
+
+typedef struct {
+    uint16_t frequency;  // MHz
+    uint16_t reg;        // RX5808 register 0x1
+} band_channel_t;
+
+typedef struct {
+    char letter;
+    const char *name;
+    band_channel_t channels[BAND_CHANNELS];
+} band_t;
+
+// RX5808 register 0x1 for a frequency: N (bits 7+) and A (bits 0-6) of the synthesiser
+constexpr uint16_t rx5808RegisterValue(uint16_t freqMhz) {
+    return (((freqMhz - 479) / 2 / 32) << 7) + ((freqMhz - 479) / 2 % 32);
+}
+
+#define BAND_CH(f) { f, rx5808RegisterValue(f) }
+
+class Bands {
+   public:
+    static constexpr band_t table[BAND_COUNT] = {
+        {'A', "Boscam A", {BAND_CH(5865), BAND_CH(5845), BAND_CH(5825), BAND_CH(5805), BAND_CH(5785), BAND_CH(5765), BAND_CH(5745), BAND_CH(5725)}},
+        {'B', "Boscam B", {BAND_CH(5733), BAND_CH(5752), BAND_CH(5771), BAND_CH(5790), BAND_CH(5809), BAND_CH(5828), BAND_CH(5847), BAND_CH(5866)}},
+        {'E', "Boscam E", {BAND_CH(5705), BAND_CH(5685), BAND_CH(5665), BAND_CH(5645), BAND_CH(5885), BAND_CH(5905), BAND_CH(5925), BAND_CH(5945)}},
+        {'F', "Fatshark", {BAND_CH(5740), BAND_CH(5760), BAND_CH(5780), BAND_CH(5800), BAND_CH(5820), BAND_CH(5840), BAND_CH(5860), BAND_CH(5880)}},
+        {'R', "RaceBand", {BAND_CH(5658), BAND_CH(5695), BAND_CH(5732), BAND_CH(5769), BAND_CH(5806), BAND_CH(5843), BAND_CH(5880), BAND_CH(5917)}},
+        {'L', "LowBand", {BAND_CH(5362), BAND_CH(5399), BAND_CH(5436), BAND_CH(5473), BAND_CH(5510), BAND_CH(5547), BAND_CH(5584), BAND_CH(5621)}},
+    };
+
+    // Band and channel are 0-based; {0, 0} when out of range
+    static constexpr band_channel_t lookup(uint8_t band, uint8_t channel) {
+        return band < BAND_COUNT && channel < BAND_CHANNELS ? table[band].channels[channel] : band_channel_t{0, 0};
+    }
+    static int8_t bandIndex(char letter);  // -1 when there is no such band
+
+    // First band/channel on a frequency; some are in more than one band
+    static bool find(uint16_t frequency, uint8_t &band, uint8_t &channel);
+
+    // RX5808 register 0x1 for any frequency
+    static uint16_t registerValue(uint16_t frequency);
+
+    static void toJson(Print &out);
+};
+
+static_assert(Bands::lookup(4, 0).frequency == 5658 && Bands::lookup(4, 0).reg == 0x281D, "RaceBand 1 register");
+
+#endif
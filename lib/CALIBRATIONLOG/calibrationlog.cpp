@@ -0,0 +1,282 @@
+#include "calibrationlog.h"
+
+#include <Arduino.h>
+
+#include "debug.h"
+#include "varint.h"
+
+CalibrationLog::CalibrationLog()
+    : storage(nullptr), blocks(nullptr), blockStarts(nullptr), ramBlocks(0), count(0),
+      blockCount(0), evictedBlocks(0), spilledBlocks(0), queuedSpills(0), dropped(0),
+      lastRssi(0), lastTimeMs(0), recording(false), appending(false), spillEnabled(false) {
+}
+
+void CalibrationLog::init(Storage* storageBackend) {
+    storage = storageBackend;
+}
+
+bool CalibrationLog::begin() {
+    release();
+
+#ifdef BOARD_HAS_PSRAM
+    if (psramFound()) {
+        blocks = (callog_block_t*)ps_malloc(CALLOG_BLOCKS_PSRAM * sizeof(callog_block_t));
+        if (blocks) {
+            ramBlocks = CALLOG_BLOCKS_PSRAM;
+        }
+    }
+#endif
+    if (!blocks) {
+        blocks = (callog_block_t*)malloc(CALLOG_BLOCKS * sizeof(callog_block_t));
+        ramBlocks = blocks ? CALLOG_BLOCKS : 0;
+    }
+    blockStarts = (uint32_t*)malloc(CALLOG_MAX_BLOCKS * sizeof(uint32_t));
+
+    if (!blocks || !blockStarts) {
+        DEBUG("CalibrationLog: failed to allocate buffer\n");
+        release();
+        return false;
+    }
+
+    count = 0;
+    blockCount = 0;
+    evictedBlocks = 0;
+    spilledBlocks = 0;
+    queuedSpills = 0;
+    dropped = 0;
+
+    // Long recordings continue on SD once RAM is full
+    spillEnabled = storage && storage->isSDAvailable();
+    if (spillEnabled) {
+        storage->mkdir(CALLOG_DIR);
+        deleteSpillFiles();
+    }
+
+    DEBUG("CalibrationLog: %u blocks in RAM (%u bytes)%s\n", ramBlocks,
+          ramBlocks * sizeof(callog_block_t), spillEnabled ? ", spilling to SD" : "");
+    recording.store(true);
+    return true;
+}
+
+void CalibrationLog::release() {
+    recording.store(false);
+    while (appending.load()) {
+        delay(1);
+    }
+
+    // Spill jobs write straight from their RAM slot
+    if (storage && queuedSpills > 0) {
+        storage->flush();
+        deleteSpillFiles();
+    }
+
+    free(blocks);
+    free(blockStarts);
+    blocks = nullptr;
+    blockStarts = nullptr;
+    ramBlocks = 0;
+    count = 0;
+    blockCount = 0;
+    evictedBlocks = 0;
+    spilledBlocks = 0;
+    queuedSpills = 0;
+}
+
+bool CalibrationLog::append(uint8_t rssi, uint32_t timeMs) {
+    appending.store(true);
+    if (!recording.load()) {
+        appending.store(false);
+        return false;
+    }
+
+    bool stored;
+    if (blockCount == 0) {
+        stored = startBlock(rssi, timeMs);
+    } else {
+        callog_block_t& block = blocks[(blockCount - 1) % ramBlocks];
+
+        int32_t delta = (int32_t)rssi - (int32_t)lastRssi;
+        uint8_t encoded[2 * VARINT_MAX_BYTES];
+        size_t len = writeVarint(encoded, zigzag(delta));
+        len += writeVarint(encoded + len, timeMs - lastTimeMs);
+
+        if (block.samples >= CALLOG_BLOCK_SAMPLES || block.used + len > sizeof(block.payload)) {
+            stored = startBlock(rssi, timeMs);
+        } else {
+            memcpy(block.payload + block.used, encoded, len);
+            block.used += len;
+            *(volatile uint16_t*)&block.samples = block.samples + 1;
+            lastRssi = rssi;
+            lastTimeMs = timeMs;
+            count = count + 1;
+            stored = true;
+        }
+    }
+
+    appending.store(false);
+    return stored;
+}
+
+bool CalibrationLog::startBlock(uint8_t rssi, uint32_t timeMs) {
+    uint32_t blockNo = blockCount;
+
+    // The previous block is final now
+    if (spillEnabled && blockNo > 0 && queuedSpills < blockNo) {
+        spillBlock(blockNo - 1);
+    }
+
+    if (blockNo >= CALLOG_MAX_BLOCKS) {
+        dropped++;
+        return false;
+    }
+    if (blockNo >= ramBlocks) {
+        // The slot still holds an older block; it can only be reused
+        // once that block is on SD
+        uint32_t oldest = blockNo - ramBlocks;
+        if (!spillEnabled || spilledBlocks <= oldest) {
+            dropped++;
+            return false;
+        }
+        evictedBlocks = oldest + 1;  // Before the slot is overwritten
+    }
+
+    callog_block_t& block = blocks[blockNo % ramBlocks];
+    block.firstIndex = count;
+    block.firstTimeMs = timeMs;
+    block.firstRssi = rssi;
+    block.used = 0;
+    *(volatile uint16_t*)&block.samples = 1;
+    blockStarts[blockNo] = count;
+    blockCount = blockNo + 1;
+
+    lastRssi = rssi;
+    lastTimeMs = timeMs;
+    count = count + 1;
+    return true;
+}
+
+void CalibrationLog::spillBlock(uint32_t blockNo) {
+    // The slot isn't reused before the write completes, so no copy is needed
+    const callog_block_t* block = &blocks[blockNo % ramBlocks];
+    queuedSpills = blockNo + 1;
+    storage->writeStreamAsync(blockPath(blockNo), [block](Print& out) {
+        return out.write((const uint8_t*)block, sizeof(callog_block_t)) == sizeof(callog_block_t);
+    }, [this, blockNo](bool success) {
+        if (success) {
+            spilledBlocks = blockNo + 1;
+        } else {
+            DEBUG("CalibrationLog: failed to spill block %u\n", blockNo);
+        }
+    });
+}
+
+bool CalibrationLog::loadBlock(uint32_t blockNo, callog_block_t& out) {
+    if (!blocks || blockNo >= blockCount) {
+        return false;
+    }
+
+    if (blockNo >= evictedBlocks) {
+        const callog_block_t& src = blocks[blockNo % ramBlocks];
+        uint16_t samples = *(volatile const uint16_t*)&src.samples;
+        memcpy(&out, &src, sizeof(out));
+        out.samples = samples;
+        if (blockNo >= evictedBlocks) {
+            return true;  // Not overwritten while copying
+        }
+    }
+
+    if (blockNo < spilledBlocks) {
+        return storage->readChunk(blockPath(blockNo), 0, (uint8_t*)&out, sizeof(out)) == sizeof(out);
+    }
+    return false;
+}
+
+bool CalibrationLog::seek(callog_cursor_t& cursor, uint32_t index) {
+    cursor.index = index;
+    cursor.loaded = false;
+    return index <= count;
+}
+
+bool CalibrationLog::locate(callog_cursor_t& cursor) {
+    // Last block starting at or before the index
+    uint32_t lo = 0;
+    uint32_t hi = blockCount;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (blockStarts[mid] <= cursor.index) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (!loadBlock(lo, cursor.data)) {
+        return false;
+    }
+    cursor.block = lo;
+    cursor.sample = 0;
+    cursor.offset = 0;
+    cursor.loaded = true;
+
+    uint32_t skip = cursor.index - cursor.data.firstIndex;
+    if (skip >= cursor.data.samples) {
+        return false;
+    }
+    while (cursor.sample < skip) {
+        decodeStep(cursor);
+    }
+    return true;
+}
+
+void CalibrationLog::decodeStep(callog_cursor_t& cursor) {
+    if (cursor.sample == 0) {
+        cursor.rssi = cursor.data.firstRssi;
+        cursor.timeMs = cursor.data.firstTimeMs;
+    } else {
+        uint16_t limit = sizeof(cursor.data.payload);
+        int32_t delta = unzigzag(readVarint(cursor.data.payload, cursor.offset, limit));
+        cursor.rssi = (uint8_t)(cursor.rssi + delta);
+        cursor.timeMs += readVarint(cursor.data.payload, cursor.offset, limit);
+    }
+    cursor.sample++;
+}
+
+bool CalibrationLog::next(callog_cursor_t& cursor, uint8_t& rssi, uint32_t& timeMs) {
+    if (!blocks || cursor.index >= count) {
+        return false;
+    }
+
+    if (cursor.loaded && cursor.sample >= cursor.data.samples) {
+        // The copy may predate samples added since; blocks only grow, so
+        // the position in the fresh copy stays valid
+        if (!loadBlock(cursor.block, cursor.data) || cursor.sample >= cursor.data.samples) {
+            cursor.loaded = false;
+        }
+    }
+    if (!cursor.loaded && !locate(cursor)) {
+        return false;
+    }
+
+    decodeStep(cursor);
+    rssi = cursor.rssi;
+    timeMs = cursor.timeMs;
+    cursor.index++;
+    return true;
+}
+
+void CalibrationLog::deleteSpillFiles() {
+    std::vector<String> files;
+    if (storage->listDir(CALLOG_DIR, files)) {
+        for (const String& name : files) {
+            if (name.endsWith(".bin")) {
+                storage->deleteFileAsync(String(CALLOG_DIR) + "/" + name);
+            }
+        }
+    }
+}
+
+String CalibrationLog::blockPath(uint32_t blockNo) {
+    char path[32];
+    snprintf(path, sizeof(path), CALLOG_DIR "/%05u.bin", (unsigned)blockNo);
+    return String(path);
+}
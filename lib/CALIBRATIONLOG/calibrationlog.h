@@ -0,0 +1,108 @@
+#ifndef CALIBRATIONLOG_H
+#define CALIBRATIONLOG_H
+
+/**
+ * Calibration wizard RSSI recording
+ *
+ * Samples are stored in fixed-size blocks: the first sample of a block is
+ * kept in full in its header (a checkpoint to seek to), the rest as a
+ * zigzag varint RSSI delta and a varint time delta - two bytes per sample
+ * at the usual 50 Hz. Blocks are allocated when recording starts (PSRAM
+ * when available) and freed with release(), so the wizard costs no RAM
+ * while it isn't used.
+ *
+ * With an SD card, finished blocks are written to CALLOG_DIR in the
+ * background and their RAM slot is reused, so recordings are limited by
+ * CALLOG_MAX_BLOCKS rather than by RAM.
+ *
+ * Single writer (the timing loop); readers on other tasks use a cursor,
+ * which copies one block at a time and never sees a half-written sample.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+
+#include "storage.h"
+
+#define CALLOG_BLOCK_SIZE 1024
+#define CALLOG_BLOCKS 24             // RAM blocks in internal RAM
+#define CALLOG_BLOCKS_PSRAM 256      // RAM blocks when PSRAM is available
+#define CALLOG_MAX_BLOCKS 1024       // Recording limit, about 3 hours at 50 Hz
+#define CALLOG_BLOCK_SAMPLES 512     // Samples per block at most
+#define CALLOG_DIR "/calibration"
+
+typedef struct {
+    uint32_t firstIndex;   // Index of the first sample in the recording
+    uint32_t firstTimeMs;  // First sample, stored in full
+    uint8_t firstRssi;
+    uint8_t reserved;
+    uint16_t used;         // Payload bytes
+    uint16_t samples;      // Published after the sample's bytes
+    uint16_t reserved2;
+    uint8_t payload[CALLOG_BLOCK_SIZE - 16];
+} callog_block_t;
+
+// Read position; holds a copy of the block it is reading
+typedef struct {
+    uint32_t index;     // Next sample to return
+    uint32_t block;     // Block number of data
+    uint16_t sample;    // Next sample within the block
+    uint16_t offset;    // Payload offset of that sample
+    uint8_t rssi;       // Previous sample, the base for the next delta
+    uint32_t timeMs;
+    bool loaded;
+    callog_block_t data;
+} callog_cursor_t;
+
+class CalibrationLog {
+   public:
+    CalibrationLog();
+    void init(Storage* storage);
+
+    // Allocates the buffer (dropping any previous recording)
+    bool begin();
+    void end() { recording.store(false); }
+    void release();  // Frees RAM and spilled blocks
+
+    // Timing loop only
+    bool append(uint8_t rssi, uint32_t timeMs);
+
+    uint32_t size() const { return count; }
+    uint32_t getDropped() const { return dropped; }
+    bool isRecording() const { return recording.load(); }
+    bool isAllocated() const { return blocks != nullptr; }
+    uint32_t getRamBlocks() const { return ramBlocks; }
+
+    // Readers, any task
+    bool seek(callog_cursor_t& cursor, uint32_t index);
+    bool next(callog_cursor_t& cursor, uint8_t& rssi, uint32_t& timeMs);
+
+   private:
+    Storage* storage;
+    callog_block_t* blocks;     // RAM slots, block n lives in slot n % ramBlocks
+    uint32_t* blockStarts;      // First sample index of every block
+    uint32_t ramBlocks;
+    volatile uint32_t count;
+    volatile uint32_t blockCount;     // Blocks started
+    volatile uint32_t evictedBlocks;  // Leading blocks whose RAM slot was reused
+    volatile uint32_t spilledBlocks;  // Leading blocks safely on SD
+    uint32_t queuedSpills;
+    uint32_t dropped;
+    uint8_t lastRssi;
+    uint32_t lastTimeMs;
+    std::atomic<bool> recording;
+    std::atomic<bool> appending;  // Lets release() wait out an append in progress
+    bool spillEnabled;
+
+    bool startBlock(uint8_t rssi, uint32_t timeMs);
+    void spillBlock(uint32_t blockNo);
+    bool loadBlock(uint32_t blockNo, callog_block_t& out);
+    bool locate(callog_cursor_t& cursor);
+    static void decodeStep(callog_cursor_t& cursor);
+    void deleteSpillFiles();
+    static String blockPath(uint32_t blockNo);
+};
+
+#endif
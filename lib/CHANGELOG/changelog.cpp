@@ -0,0 +1,223 @@
+#include "changelog.h"
+
+#include <memory>
+
+#include "debug.h"
+#include "racehistory.h"
+#include "trackmanager.h"
+
+ChangeLog::ChangeLog() : storage(nullptr), mutex(NULL), head(0), count(0), seq(0), epoch(0) {
+}
+
+bool ChangeLog::init(Storage* storageBackend) {
+    storage = storageBackend;
+    if (!storage) {
+        DEBUG("ChangeLog: Storage backend is null!\n");
+        return false;
+    }
+    if (!mutex) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    return load();
+}
+
+bool ChangeLog::load() {
+    if (!storage || !mutex) {
+        return false;
+    }
+    storage->flush();
+    storage->mkdir(CHANGELOG_DIR);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    head = 0;
+    count = 0;
+    bool loaded = false;
+
+    File file = storage->openFile(CHANGELOG_PATH, "r");
+    if (file) {
+        changelog_header_t header;
+        if (file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == CHANGELOG_MAGIC && header.count <= CHANGELOG_CAPACITY) {
+            size_t bytes = header.count * sizeof(change_entry_t);
+            if (file.read((uint8_t*)entries, bytes) == bytes) {
+                epoch = header.epoch;
+                seq = header.seq;
+                count = header.count;
+                loaded = true;
+            }
+        }
+        file.close();
+    }
+
+    if (!loaded) {
+        // Nothing to continue from - clients holding an old epoch resync fully
+        reset();
+        persist();
+    }
+    xSemaphoreGive(mutex);
+
+    DEBUG("ChangeLog: epoch %08x, seq %u, %u entries%s\n", epoch, seq, count, loaded ? "" : " (new)");
+    return true;
+}
+
+void ChangeLog::reset() {
+    epoch = esp_random();
+    seq = 0;
+    head = 0;
+    count = 0;
+}
+
+void ChangeLog::record(uint8_t entity, uint8_t op, uint32_t id) {
+    if (!mutex) {
+        return;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    change_entry_t entry = {};
+    entry.seq = ++seq;
+    entry.id = id;
+    entry.entity = entity;
+    entry.op = op;
+    if (count < CHANGELOG_CAPACITY) {
+        entries[(head + count) % CHANGELOG_CAPACITY] = entry;
+        count++;
+    } else {
+        entries[head] = entry;  // Overwrite the oldest
+        head = (head + 1) % CHANGELOG_CAPACITY;
+    }
+    persist();
+    xSemaphoreGive(mutex);
+}
+
+void ChangeLog::persist() {
+    if (!storage) {
+        return;
+    }
+    // Snapshot oldest first; queued writes of the log coalesce into one
+    std::shared_ptr<std::vector<uint8_t>> image =
+        std::make_shared<std::vector<uint8_t>>(sizeof(changelog_header_t) + count * sizeof(change_entry_t));
+    changelog_header_t header = {CHANGELOG_MAGIC, epoch, seq, (uint32_t)count};
+    memcpy(image->data(), &header, sizeof(header));
+    change_entry_t* out = (change_entry_t*)(image->data() + sizeof(header));
+    for (size_t i = 0; i < count; i++) {
+        out[i] = entries[(head + i) % CHANGELOG_CAPACITY];
+    }
+    storage->writeStreamAsync(CHANGELOG_PATH, [image](Print& file) {
+        return file.write(image->data(), image->size()) == image->size();
+    });
+}
+
+uint32_t ChangeLog::getSeq() {
+    return seq;
+}
+
+uint32_t ChangeLog::getEpoch() {
+    return epoch;
+}
+
+bool ChangeLog::changesSince(uint32_t clientEpoch, uint32_t since, std::vector<change_entry_t>& changes) {
+    changes.clear();
+    if (!mutex) {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    // The log covers since if nothing after it has been overwritten yet
+    uint32_t oldest = count > 0 ? entries[head].seq : seq + 1;
+    bool covered = clientEpoch == epoch && since <= seq && since + 1 >= oldest;
+    if (covered) {
+        for (size_t i = 0; i < count; i++) {
+            const change_entry_t& entry = entries[(head + i) % CHANGELOG_CAPACITY];
+            if (entry.seq <= since) {
+                continue;
+            }
+            // Only the latest change per race/track matters
+            bool replaced = false;
+            for (auto& change : changes) {
+                if (change.entity == entry.entity && change.id == entry.id) {
+                    change = entry;
+                    replaced = true;
+                    break;
+                }
+            }
+            if (!replaced) {
+                changes.push_back(entry);
+            }
+        }
+    }
+    xSemaphoreGive(mutex);
+    return covered;
+}
+
+void ChangeLog::writeSyncJson(Print& out, uint32_t clientEpoch, uint32_t since, RaceHistory* history, TrackManager* tracks) {
+    uint32_t currentEpoch;
+    uint32_t currentSeq;
+    std::vector<change_entry_t> changes;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    currentEpoch = epoch;
+    currentSeq = seq;
+    xSemaphoreGive(mutex);
+    bool full = !changesSince(clientEpoch, since, changes);
+
+    out.printf("{\"epoch\":%u,\"seq\":%u,\"full\":%s", currentEpoch, currentSeq, full ? "true" : "false");
+
+    // Races - everything on a full sync, otherwise only what changed
+    out.print(",\"races\":[");
+    bool first = true;
+    RaceSession race;
+    for (uint32_t cursor = UINT32_MAX; history->getRaceBefore(cursor, race); cursor = race.timestamp) {
+        bool changed = full;
+        for (const auto& change : changes) {
+            if (change.entity == CHANGE_RACE && change.op == CHANGE_UPSERT && change.id == race.timestamp) {
+                changed = true;
+                break;
+            }
+        }
+        if (!changed) {
+            continue;
+        }
+        DynamicJsonDocument doc(16384);
+        RaceHistory::raceToJson(race, doc.to<JsonObject>());
+        if (!first) out.print(",");
+        serializeJson(doc, out);
+        first = false;
+    }
+    out.print("],\"deletedRaces\":[");
+    first = true;
+    for (const auto& change : changes) {
+        // An upsert of a race that has since been dropped counts as a delete
+        if (change.entity == CHANGE_RACE &&
+            (change.op == CHANGE_DELETE || !history->hasRace(change.id))) {
+            out.printf(first ? "%u" : ",%u", change.id);
+            first = false;
+        }
+    }
+
+    out.print("],\"tracks\":[");
+    first = true;
+    for (const auto& track : tracks->getTracks()) {
+        bool changed = full;
+        for (const auto& change : changes) {
+            if (change.entity == CHANGE_TRACK && change.op == CHANGE_UPSERT && change.id == track.trackId) {
+                changed = true;
+                break;
+            }
+        }
+        if (!changed) {
+            continue;
+        }
+        DynamicJsonDocument doc(2048);
+        TrackManager::trackToJson(track, doc.to<JsonObject>());
+        if (!first) out.print(",");
+        serializeJson(doc, out);
+        first = false;
+    }
+    out.print("],\"deletedTracks\":[");
+    first = true;
+    for (const auto& change : changes) {
+        if (change.entity == CHANGE_TRACK &&
+            (change.op == CHANGE_DELETE || !tracks->getTrackById(change.id))) {
+            out.printf(first ? "%u" : ",%u", change.id);
+            first = false;
+        }
+    }
+    out.print("]}");
+}
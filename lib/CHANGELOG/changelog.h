@@ -0,0 +1,90 @@
+#ifndef CHANGELOG_H
+#define CHANGELOG_H
+
+/**
+ * Change log for incremental sync
+ *
+ * Every create, update and delete of a race or track gets a sequence number
+ * from a per-device counter that only goes up. Clients remember the last
+ * sequence they saw and ask for what changed since (/sync?since=N, USB
+ * "sync"); only those races and tracks are sent.
+ *
+ * - The last CHANGELOG_CAPACITY changes are kept in a ring, persisted as a
+ *   small binary file on the storage task.
+ * - The epoch identifies this log. It changes when the log is lost or the
+ *   data moves to another backend (e.g. the SD card mounts), and a client
+ *   whose epoch or sequence falls outside the log gets a full sync.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <vector>
+
+#include "storage.h"
+
+class RaceHistory;
+class TrackManager;
+
+#define CHANGELOG_DIR "/sync"
+#define CHANGELOG_PATH "/sync/changelog.bin"
+#define CHANGELOG_CAPACITY 256
+#define CHANGELOG_MAGIC 0x474C4346  // "FCLG"
+
+typedef enum : uint8_t {
+    CHANGE_RACE,
+    CHANGE_TRACK
+} change_entity_e;
+
+typedef enum : uint8_t {
+    CHANGE_UPSERT,
+    CHANGE_DELETE
+} change_op_e;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t id;      // Race timestamp or track ID
+    uint8_t entity;   // change_entity_e
+    uint8_t op;       // change_op_e
+    uint8_t reserved[2];
+} change_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t epoch;
+    uint32_t seq;     // Last sequence number handed out
+    uint32_t count;   // Entries that follow, oldest first
+} changelog_header_t;
+
+class ChangeLog {
+   public:
+    ChangeLog();
+    bool init(Storage* storage);
+    bool load();  // Reload from the current backend, new epoch if there is no log
+
+    void record(uint8_t entity, uint8_t op, uint32_t id);
+    uint32_t getSeq();
+    uint32_t getEpoch();
+
+    // Latest change per race/track after since. False if the log no longer
+    // covers since (or it is from another epoch) and a full sync is needed.
+    bool changesSince(uint32_t epoch, uint32_t since, std::vector<change_entry_t>& changes);
+
+    // Sync response, streamed one race/track at a time:
+    // {"epoch","seq","full","races","deletedRaces","tracks","deletedTracks"}
+    void writeSyncJson(Print& out, uint32_t epoch, uint32_t since, RaceHistory* history, TrackManager* tracks);
+
+   private:
+    Storage* storage;
+    SemaphoreHandle_t mutex;
+    change_entry_t entries[CHANGELOG_CAPACITY];
+    size_t head;   // Oldest entry
+    size_t count;
+    uint32_t seq;
+    uint32_t epoch;
+
+    void reset();
+    void persist();  // Caller holds the mutex
+};
+
+#endif  // CHANGELOG_H
@@ -1,55 +1,172 @@
 #include "config.h"
 
 #include <EEPROM.h>
+#include <Preferences.h>
+#include <stddef.h>
 
+#include "bands.h"
 #include "debug.h"
 
+typedef struct {
+    const char* key;  // NVS keys are limited to 15 characters
+    uint16_t offset;
+    uint16_t size;
+} config_field_t;
+
+#define CONFIG_FIELD(key, member) \
+    { key, offsetof(laptimer_config_t, member), sizeof(((laptimer_config_t*)0)->member) }
+
+// Every persisted field; the version is kept under its own key
+static const config_field_t configFields[] = {
+    CONFIG_FIELD("freq", frequency),
+    CONFIG_FIELD("minLap", minLap),
+    CONFIG_FIELD("alarm", alarm),
+    CONFIG_FIELD("anType", announcerType),
+    CONFIG_FIELD("anRate", announcerRate),
+    CONFIG_FIELD("enterRssi", enterRssi),
+    CONFIG_FIELD("exitRssi", exitRssi),
+    CONFIG_FIELD("maxLaps", maxLaps),
+    CONFIG_FIELD("ledMode", ledMode),
+    CONFIG_FIELD("ledBright", ledBrightness),
+    CONFIG_FIELD("ledColor", ledColor),
+    CONFIG_FIELD("ledPreset", ledPreset),
+    CONFIG_FIELD("ledSpeed", ledSpeed),
+    CONFIG_FIELD("ledFade", ledFadeColor),
+    CONFIG_FIELD("ledStrobe", ledStrobeColor),
+    CONFIG_FIELD("ledOverride", ledManualOverride),
+    CONFIG_FIELD("opMode", operationMode),
+    CONFIG_FIELD("tracksOn", tracksEnabled),
+    CONFIG_FIELD("trackId", selectedTrackId),
+    CONFIG_FIELD("hooksOn", webhooksEnabled),
+    CONFIG_FIELD("hookIPs", webhookIPs),
+    CONFIG_FIELD("hookCount", webhookCount),
+    CONFIG_FIELD("gateLEDs", gateLEDsEnabled),
+    CONFIG_FIELD("hookStart", webhookRaceStart),
+    CONFIG_FIELD("hookStop", webhookRaceStop),
+    CONFIG_FIELD("hookLap", webhookLap),
+    CONFIG_FIELD("name", pilotName),
+    CONFIG_FIELD("ssid", ssid),
+    CONFIG_FIELD("pwd", password),
+    CONFIG_FIELD("rawRec", rawRecord),
+    CONFIG_FIELD("nodeFreq", nodeFrequency),
+    CONFIG_FIELD("nodeEnter", nodeEnterRssi),
+    CONFIG_FIELD("nodeExit", nodeExitRssi),
+    CONFIG_FIELD("hopPilots", hopPilots),
+    CONFIG_FIELD("hopDwell", hopDwell),
+};
+
+static Preferences prefs;
+
 void Config::init(void) {
-    if (sizeof(laptimer_config_t) > EEPROM_RESERVED_SIZE) {
-        DEBUG("Config size too big, adjust reserved EEPROM size\n");
+    if (!prefs.begin(CONFIG_NVS_NAMESPACE, false)) {
+        DEBUG("Failed to open config NVS namespace, using defaults\n");
+        setDefaultValues();
+        stored = conf;
+        modified = false;
+        publishTiming();
         return;
     }
 
-    EEPROM.begin(EEPROM_RESERVED_SIZE);  // Size of EEPROM
-    load();                              // Override default settings from EEPROM
+    load();
+    publishTiming();
 
     checkTimeMs = millis();
 
-    DEBUG("EEPROM Init Successful\n");
+    DEBUG("Config Init Successful\n");
 }
 
 void Config::load(void) {
     modified = false;
-    EEPROM.get(0, conf);
 
-    uint32_t version = 0xFFFFFFFF;
-    if ((conf.version & CONFIG_MAGIC_MASK) == CONFIG_MAGIC) {
-        version = conf.version & ~CONFIG_MAGIC_MASK;
+    if (!prefs.isKey(CONFIG_NVS_VERSION_KEY)) {
+        // First boot on NVS: bring over the old EEPROM blob once
+        if (!migrateFromEeprom()) {
+            setDefaults();
+        }
+        return;
     }
 
-    // If version is not current, reset to defaults
-    if (version != CONFIG_VERSION) {
+    uint32_t version = prefs.getUInt(CONFIG_NVS_VERSION_KEY, 0);
+    if (version != (CONFIG_VERSION | CONFIG_MAGIC)) {
+        prefs.clear();
         setDefaults();
+        return;
+    }
+
+    // Fields missing from NVS keep their defaults
+    setDefaultValues();
+    uint8_t* base = (uint8_t*)&conf;
+    for (const config_field_t& field : configFields) {
+        if (prefs.getBytesLength(field.key) == field.size) {
+            prefs.getBytes(field.key, base + field.offset, field.size);
+        }
     }
+    stored = conf;
 }
 
-void Config::write(void) {
-    if (!modified) return;
+bool Config::migrateFromEeprom() {
+    if (sizeof(laptimer_config_t) > EEPROM_RESERVED_SIZE || !EEPROM.begin(EEPROM_RESERVED_SIZE)) {
+        return false;
+    }
 
-    DEBUG("Writing to EEPROM\n");
+    laptimer_config_t legacy;
+    EEPROM.get(0, legacy);
+    EEPROM.end();
 
-    EEPROM.put(0, conf);
-    EEPROM.commit();
+    if (legacy.version != (CONFIG_VERSION | CONFIG_MAGIC)) {
+        return false;
+    }
+
+    DEBUG("Migrating config from EEPROM to NVS\n");
+    conf = legacy;
+    conf.rawRecord = 0;  // Added after the EEPROM layout
+    setNodeDefaults();
+    conf.hopPilots = 0;
+    conf.hopDwell = 40;
+    writeFields(true);
+    return true;
+}
+
+void Config::write(void) {
+    if (!modified) return;
+    writeFields(false);
+}
+
+void Config::writeFields(bool all) {
+    // Only fields that differ from NVS are written; NVS spreads the
+    // writes over its pages, so this doesn't wear a fixed flash sector
+    const uint8_t* base = (const uint8_t*)&conf;
+    uint8_t* old = (uint8_t*)&stored;
+    uint8_t written = 0;
+    for (const config_field_t& field : configFields) {
+        if (all || memcmp(base + field.offset, old + field.offset, field.size) != 0) {
+            if (prefs.putBytes(field.key, base + field.offset, field.size) == field.size) {
+                memcpy(old + field.offset, base + field.offset, field.size);
+                written++;
+            }
+        }
+    }
+    if (all || stored.version != conf.version) {
+        prefs.putUInt(CONFIG_NVS_VERSION_KEY, conf.version);
+        stored.version = conf.version;
+    }
 
-    DEBUG("Writing to EEPROM done\n");
+    DEBUG("Config: wrote %u changed fields\n", written);
 
     modified = false;
+    firstChangeMs = 0;
 }
 
 void Config::toJson(AsyncResponseStream& destination) {
     // Use https://arduinojson.org/v6/assistant to estimate memory
-    DynamicJsonDocument config(512);
+    DynamicJsonDocument config(768);
     config["freq"] = conf.frequency;
+    uint8_t band, channel;
+    if (Bands::find(conf.frequency, band, channel)) {
+        // Where the frequency is in the band plan, channel 1-based
+        config["band"] = String(Bands::table[band].letter);
+        config["channel"] = channel + 1;
+    }
     config["minLap"] = conf.minLap;
     config["alarm"] = conf.alarm;
     config["anType"] = conf.announcerType;
@@ -78,6 +195,17 @@ void Config::toJson(AsyncResponseStream& destination) {
     config["webhookRaceStart"] = conf.webhookRaceStart;
     config["webhookRaceStop"] = conf.webhookRaceStop;
     config["webhookLap"] = conf.webhookLap;
+    config["rawRecord"] = conf.rawRecord;
+    config["nodeCount"] = RX_NODE_COUNT;
+    JsonArray nodes = config.createNestedArray("nodes");
+    for (uint8_t i = 0; i < CONFIG_EXTRA_NODES; i++) {
+        JsonObject node = nodes.createNestedObject();
+        node["freq"] = conf.nodeFrequency[i];
+        node["enterRssi"] = conf.nodeEnterRssi[i];
+        node["exitRssi"] = conf.nodeExitRssi[i];
+    }
+    config["hopPilots"] = conf.hopPilots;
+    config["hopDwell"] = conf.hopDwell;
     config["name"] = conf.pilotName;
     config["ssid"] = conf.ssid;
     config["pwd"] = conf.password;
@@ -112,110 +240,147 @@ void Config::toJsonString(char* buf) {
 }
 
 void Config::fromJson(JsonObject source) {
-    if (source["freq"] != conf.frequency) {
-        conf.frequency = source["freq"];
-        modified = true;
+    // Readers must never see the new enter with the old exit; thresholds
+    // are published together once every field is in
+    publishDeferred = true;
+    uint16_t frequency = source["freq"];
+    if (!source.containsKey("freq") && source.containsKey("band")) {
+        // A band letter and 1-based channel in place of the frequency
+        const char* letter = source["band"] | "";
+        int8_t band = Bands::bandIndex(letter[0]);
+        uint8_t channel = source["channel"] | 0;
+        band_channel_t entry = Bands::lookup(band < 0 ? BAND_COUNT : band, channel - 1);
+        frequency = entry.frequency ? entry.frequency : conf.frequency;
+    }
+    if (frequency != conf.frequency) {
+        conf.frequency = frequency;
+        markModified();
     }
     if (source["minLap"] != conf.minLap) {
         conf.minLap = source["minLap"];
-        modified = true;
+        markModified();
     }
     if (source["alarm"] != conf.alarm) {
         conf.alarm = source["alarm"];
-        modified = true;
+        markModified();
     }
     if (source["anType"] != conf.announcerType) {
         conf.announcerType = source["anType"];
-        modified = true;
+        markModified();
     }
     if (source["anRate"] != conf.announcerRate) {
         conf.announcerRate = source["anRate"];
-        modified = true;
+        markModified();
     }
     if (source["enterRssi"] != conf.enterRssi) {
         conf.enterRssi = source["enterRssi"];
-        modified = true;
+        markModified();
     }
     if (source["exitRssi"] != conf.exitRssi) {
         conf.exitRssi = source["exitRssi"];
-        modified = true;
+        markModified();
     }
     if (source["maxLaps"] != conf.maxLaps) {
         conf.maxLaps = source["maxLaps"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("ledMode") && source["ledMode"] != conf.ledMode) {
         conf.ledMode = source["ledMode"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("ledBrightness") && source["ledBrightness"] != conf.ledBrightness) {
         conf.ledBrightness = source["ledBrightness"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("ledColor") && source["ledColor"] != conf.ledColor) {
         conf.ledColor = source["ledColor"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("ledPreset") && source["ledPreset"] != conf.ledPreset) {
         conf.ledPreset = source["ledPreset"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("ledSpeed") && source["ledSpeed"] != conf.ledSpeed) {
         conf.ledSpeed = source["ledSpeed"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("ledFadeColor") && source["ledFadeColor"] != conf.ledFadeColor) {
         conf.ledFadeColor = source["ledFadeColor"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("ledStrobeColor") && source["ledStrobeColor"] != conf.ledStrobeColor) {
         conf.ledStrobeColor = source["ledStrobeColor"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("ledManualOverride") && source["ledManualOverride"] != conf.ledManualOverride) {
         conf.ledManualOverride = source["ledManualOverride"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("opMode") && source["opMode"] != conf.operationMode) {
         conf.operationMode = source["opMode"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("tracksEnabled") && source["tracksEnabled"] != conf.tracksEnabled) {
         conf.tracksEnabled = source["tracksEnabled"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("selectedTrackId") && source["selectedTrackId"] != conf.selectedTrackId) {
         conf.selectedTrackId = source["selectedTrackId"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("gateLEDsEnabled") && source["gateLEDsEnabled"] != conf.gateLEDsEnabled) {
         conf.gateLEDsEnabled = source["gateLEDsEnabled"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("webhookRaceStart") && source["webhookRaceStart"] != conf.webhookRaceStart) {
         conf.webhookRaceStart = source["webhookRaceStart"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("webhookRaceStop") && source["webhookRaceStop"] != conf.webhookRaceStop) {
         conf.webhookRaceStop = source["webhookRaceStop"];
-        modified = true;
+        markModified();
     }
     if (source.containsKey("webhookLap") && source["webhookLap"] != conf.webhookLap) {
         conf.webhookLap = source["webhookLap"];
-        modified = true;
+        markModified();
+    }
+    if (source.containsKey("rawRecord") && source["rawRecord"] != conf.rawRecord) {
+        conf.rawRecord = source["rawRecord"];
+        markModified();
+    }
+    if (source.containsKey("nodes")) {
+        // Entry i is node i + 1
+        JsonArray nodes = source["nodes"];
+        uint8_t i = 0;
+        for (JsonObject node : nodes) {
+            if (i >= CONFIG_EXTRA_NODES) break;
+            setNode(i + 1, node["freq"] | conf.nodeFrequency[i], node["enterRssi"] | conf.nodeEnterRssi[i],
+                    node["exitRssi"] | conf.nodeExitRssi[i]);
+            i++;
+        }
+    }
+    if (source.containsKey("hopPilots") && source["hopPilots"] != conf.hopPilots) {
+        conf.hopPilots = source["hopPilots"];
+        markModified();
+    }
+    if (source.containsKey("hopDwell") && source["hopDwell"] != conf.hopDwell) {
+        conf.hopDwell = source["hopDwell"];
+        markModified();
     }
     if (source["name"] != conf.pilotName) {
         strlcpy(conf.pilotName, source["name"] | "", sizeof(conf.pilotName));
-        modified = true;
+        markModified();
     }
     if (source["ssid"] != conf.ssid) {
         strlcpy(conf.ssid, source["ssid"] | "", sizeof(conf.ssid));
-        modified = true;
+        markModified();
     }
     if (source["pwd"] != conf.password) {
         strlcpy(conf.password, source["pwd"] | "", sizeof(conf.password));
-        modified = true;
+        markModified();
     }
+    publishDeferred = false;
+    publishTiming();
 }
 
 uint16_t Config::getFrequency() {
@@ -250,6 +415,10 @@ char* Config::getPassword() {
     return conf.password;
 }
 
+const char* Config::getPilotName() {
+    return conf.pilotName;
+}
+
 uint8_t Config::getMaxLaps() {
     return conf.maxLaps;
 }
@@ -329,102 +498,129 @@ uint8_t Config::getWebhookLap() {
     return conf.webhookLap;
 }
 
+uint8_t Config::getRawRecord() {
+    return conf.rawRecord;
+}
+
+uint16_t Config::getNodeFrequency(uint8_t node) {
+    if (node < 1 || node > CONFIG_EXTRA_NODES) return 0;
+    return conf.nodeFrequency[node - 1];
+}
+
+uint8_t Config::getNodeEnterRssi(uint8_t node) {
+    if (node < 1 || node > CONFIG_EXTRA_NODES) return 0;
+    return conf.nodeEnterRssi[node - 1];
+}
+
+uint8_t Config::getNodeExitRssi(uint8_t node) {
+    if (node < 1 || node > CONFIG_EXTRA_NODES) return 0;
+    return conf.nodeExitRssi[node - 1];
+}
+
+uint8_t Config::getHopPilots() {
+    return conf.hopPilots;
+}
+
+uint16_t Config::getHopDwellMs() {
+    return conf.hopDwell;
+}
+
 // Setters for RotorHazard node mode
 void Config::setFrequency(uint16_t freq) {
     if (conf.frequency != freq) {
         conf.frequency = freq;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setEnterRssi(uint8_t rssi) {
     if (conf.enterRssi != rssi) {
         conf.enterRssi = rssi;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setExitRssi(uint8_t rssi) {
     if (conf.exitRssi != rssi) {
         conf.exitRssi = rssi;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setOperationMode(uint8_t mode) {
     if (conf.operationMode != mode) {
         conf.operationMode = mode;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setLedPreset(uint8_t preset) {
     if (conf.ledPreset != preset) {
         conf.ledPreset = preset;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setLedBrightness(uint8_t brightness) {
     if (conf.ledBrightness != brightness) {
         conf.ledBrightness = brightness;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setLedSpeed(uint8_t speed) {
     if (conf.ledSpeed != speed) {
         conf.ledSpeed = speed;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setLedColor(uint32_t color) {
     if (conf.ledColor != color) {
         conf.ledColor = color;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setLedFadeColor(uint32_t color) {
     if (conf.ledFadeColor != color) {
         conf.ledFadeColor = color;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setLedStrobeColor(uint32_t color) {
     if (conf.ledStrobeColor != color) {
         conf.ledStrobeColor = color;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setLedManualOverride(uint8_t override) {
     if (conf.ledManualOverride != override) {
         conf.ledManualOverride = override;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setTracksEnabled(uint8_t enabled) {
     if (conf.tracksEnabled != enabled) {
         conf.tracksEnabled = enabled;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setSelectedTrackId(uint32_t trackId) {
     if (conf.selectedTrackId != trackId) {
         conf.selectedTrackId = trackId;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setWebhooksEnabled(uint8_t enabled) {
     if (conf.webhooksEnabled != enabled) {
         conf.webhooksEnabled = enabled;
-        modified = true;
+        markModified();
     }
 }
 
@@ -444,7 +640,7 @@ bool Config::addWebhookIP(const char* ip) {
     
     strlcpy(conf.webhookIPs[conf.webhookCount], ip, 16);
     conf.webhookCount++;
-    modified = true;
+    markModified();
     return true;
 }
 
@@ -457,7 +653,7 @@ bool Config::removeWebhookIP(const char* ip) {
             }
             conf.webhookCount--;
             memset(conf.webhookIPs[conf.webhookCount], 0, 16);  // Clear last entry
-            modified = true;
+            markModified();
             return true;
         }
     }
@@ -467,39 +663,114 @@ bool Config::removeWebhookIP(const char* ip) {
 void Config::clearWebhookIPs() {
     memset(conf.webhookIPs, 0, sizeof(conf.webhookIPs));
     conf.webhookCount = 0;
-    modified = true;
+    markModified();
 }
 
 void Config::setGateLEDsEnabled(uint8_t enabled) {
     if (conf.gateLEDsEnabled != enabled) {
         conf.gateLEDsEnabled = enabled;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setWebhookRaceStart(uint8_t enabled) {
     if (conf.webhookRaceStart != enabled) {
         conf.webhookRaceStart = enabled;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setWebhookRaceStop(uint8_t enabled) {
     if (conf.webhookRaceStop != enabled) {
         conf.webhookRaceStop = enabled;
-        modified = true;
+        markModified();
     }
 }
 
 void Config::setWebhookLap(uint8_t enabled) {
     if (conf.webhookLap != enabled) {
         conf.webhookLap = enabled;
-        modified = true;
+        markModified();
+    }
+}
+
+void Config::setRawRecord(uint8_t enabled) {
+    if (conf.rawRecord != enabled) {
+        conf.rawRecord = enabled;
+        markModified();
+    }
+}
+
+bool Config::setNode(uint8_t node, uint16_t freq, uint8_t enterRssi, uint8_t exitRssi) {
+    if (node < 1 || node > CONFIG_EXTRA_NODES) {
+        return false;
+    }
+    uint8_t i = node - 1;
+    if (conf.nodeFrequency[i] != freq || conf.nodeEnterRssi[i] != enterRssi || conf.nodeExitRssi[i] != exitRssi) {
+        conf.nodeFrequency[i] = freq;
+        conf.nodeEnterRssi[i] = enterRssi;
+        conf.nodeExitRssi[i] = exitRssi;
+        markModified();
+    }
+    return true;
+}
+
+void Config::publishTiming() {
+    uint8_t enterRssi = conf.enterRssi;
+    uint8_t exitRssi = conf.exitRssi;
+    uint32_t minLapMs = getMinLapMs();
+    if (timing.version != 0 && timing.enterRssi == enterRssi &&
+        timing.exitRssi == exitRssi && timing.minLapMs == minLapMs) {
+        return;
     }
+
+    // Writers can come from the web and the main loop; take the odd
+    // sequence number to exclude other writers and make readers retry
+    uint32_t seq = timingSeq.load(std::memory_order_relaxed);
+    do {
+        while (seq & 1) {
+            seq = timingSeq.load(std::memory_order_relaxed);
+        }
+    } while (!timingSeq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire));
+    std::atomic_thread_fence(std::memory_order_release);
+
+    timing.enterRssi = enterRssi;
+    timing.exitRssi = exitRssi;
+    timing.minLapMs = minLapMs;
+    timing.version++;
+
+    timingSeq.store(seq + 2, std::memory_order_release);
+}
+
+void Config::getTimingSnapshot(timing_config_t& out) const {
+    uint32_t before, after;
+    do {
+        before = timingSeq.load(std::memory_order_acquire);
+        out = timing;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = timingSeq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+void Config::markModified() {
+    if (!publishDeferred) {
+        publishTiming();
+    }
+    uint32_t now = millis();
+    if (!modified) {
+        firstChangeMs = now;
+    }
+    checkTimeMs = now;  // Restart the quiet period
+    modified = true;
 }
 
 void Config::setDefaults(void) {
-    DEBUG("Setting EEPROM defaults\n");
+    DEBUG("Setting config defaults\n");
+    setDefaultValues();
+    writeFields(true);
+}
+
+void Config::setDefaultValues(void) {
     // Reset everything to 0/false and then just set anything that zero is not appropriate
     memset(&conf, 0, sizeof(conf));
     conf.version = CONFIG_VERSION | CONFIG_MAGIC;
@@ -529,16 +800,32 @@ void Config::setDefaults(void) {
     conf.webhookRaceStart = 1;  // Race start enabled by default
     conf.webhookRaceStop = 1;  // Race stop enabled by default
     conf.webhookLap = 1;  // Lap enabled by default
+    conf.rawRecord = 0;  // Raw RSSI recording off by default
+    setNodeDefaults();
+    conf.hopPilots = 0;  // One pilot per receiver by default
+    conf.hopDwell = 40;
     strlcpy(conf.ssid, "", sizeof(conf.ssid));
     strlcpy(conf.password, "", sizeof(conf.password));
     strlcpy(conf.pilotName, "", sizeof(conf.pilotName));
-    modified = true;
-    write();
+}
+
+void Config::setNodeDefaults(void) {
+    // R3, R6 and R8 next to node 0 on R1: the usual 4-pilot spread
+    static const uint16_t frequencies[CONFIG_EXTRA_NODES] = {5732, 5843, 5917};
+    for (uint8_t i = 0; i < CONFIG_EXTRA_NODES; i++) {
+        conf.nodeFrequency[i] = frequencies[i];
+        conf.nodeEnterRssi[i] = conf.enterRssi;
+        conf.nodeExitRssi[i] = conf.exitRssi;
+    }
 }
 
 void Config::handleEeprom(uint32_t currentTimeMs) {
-    if (modified && ((currentTimeMs - checkTimeMs) > EEPROM_CHECK_TIME_MS)) {
-        checkTimeMs = currentTimeMs;
+    if (!modified) return;
+
+    // Slider drags change a field many times a second; wait until they
+    // settle, but don't hold changes back indefinitely
+    if ((currentTimeMs - checkTimeMs) > EEPROM_CHECK_TIME_MS ||
+        (currentTimeMs - firstChangeMs) > CONFIG_WRITE_MAX_DELAY_MS) {
         write();
     }
 }
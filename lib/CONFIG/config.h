@@ -5,6 +5,8 @@
 #include <AsyncJson.h>
 #include <stdint.h>
 
+#include <atomic>
+
 /*
 ## Pinout ##
 | ESP32 | RX5880 |
@@ -35,6 +37,7 @@
 #define PIN_BUZZER 5
 #define BUZZER_INVERTED false
 #define PIN_MODE_SWITCH 1     // Mode selection: LOW=WiFi, HIGH=RotorHazard
+#define RX_MAX_NODES 1        // No spare ADC1 pins for more receivers
 
 //ESP32-S3
 #elif defined(ESP32S3)
@@ -51,6 +54,10 @@
 #define PIN_BUZZER 5
 #define BUZZER_INVERTED false
 #define PIN_MODE_SWITCH 9      // Mode selection: LOW=WiFi, HIGH=RotorHazard
+// Extra receivers share DATA and CLOCK, each has its own SELECT and RSSI (ADC1)
+#define RX_MAX_NODES 4
+#define PIN_RX5808_NODE_RSSI {6, 7, 8}
+#define PIN_RX5808_NODE_SELECT {13, 14, 15}
 // SD Card SPI pins (tested and working configuration)
 #define PIN_SD_CS 39
 #define PIN_SD_SCK 36
@@ -71,19 +78,38 @@
 #define PIN_BUZZER 27
 #define BUZZER_INVERTED false
 #define PIN_MODE_SWITCH 33   // Mode selection: LOW=WiFi, HIGH=RotorHazard
+// Extra receivers share DATA and CLOCK, each has its own SELECT and RSSI (ADC1)
+#define RX_MAX_NODES 4
+#define PIN_RX5808_NODE_RSSI {32, 34, 36}
+#define PIN_RX5808_NODE_SELECT {25, 26, 18}
+
+#endif
 
+// Receivers fitted, the first on the PIN_RX5808_* pins; set per build
+// with -DRX_NODE_COUNT=n
+#ifndef RX_NODE_COUNT
+#define RX_NODE_COUNT 1
 #endif
+#if RX_NODE_COUNT < 1 || RX_NODE_COUNT > RX_MAX_NODES
+#error "RX_NODE_COUNT is out of range for this target"
+#endif
+#define CONFIG_EXTRA_NODES 3  // Settings kept for nodes 1-3 on every target
 
 // Mode selection constants
 #define WIFI_MODE LOW          // GND on switch pin = WiFi/Standalone mode
 #define ROTORHAZARD_MODE HIGH  // HIGH (floating/pullup) = RotorHazard node mode
 
-#define EEPROM_RESERVED_SIZE 512
+#define EEPROM_RESERVED_SIZE 512  // Legacy config blob, read once for migration
 #define CONFIG_MAGIC_MASK (0b11U << 30)
 #define CONFIG_MAGIC (0b01U << 30)
 #define CONFIG_VERSION 5U
 
-#define EEPROM_CHECK_TIME_MS 1000
+// Config lives in NVS, one key per field; only changed fields are written
+#define CONFIG_NVS_NAMESPACE "config"
+#define CONFIG_NVS_VERSION_KEY "version"
+
+#define EEPROM_CHECK_TIME_MS 1000       // Quiet time after the last change before writing
+#define CONFIG_WRITE_MAX_DELAY_MS 10000 // Write anyway if changes keep coming
 
 typedef struct {
     uint32_t version;
@@ -116,8 +142,23 @@ typedef struct {
     char pilotName[21];
     char ssid[33];
     char password[33];
+    uint8_t rawRecord;         // Record raw RSSI of every race to SD (0=disabled, 1=enabled)
+    uint16_t nodeFrequency[CONFIG_EXTRA_NODES];  // Nodes 1-3; node 0 uses the fields above
+    uint8_t nodeEnterRssi[CONFIG_EXTRA_NODES];
+    uint8_t nodeExitRssi[CONFIG_EXTRA_NODES];
+    uint8_t hopPilots;         // Pilots sharing one receiver by frequency hopping (0=off, 2-4)
+    uint16_t hopDwell;         // Time on each pilot's frequency once tuned, ms
 } laptimer_config_t;
 
+// Detection thresholds as the timing loop sees them; copied out of Config
+// as a whole so a change never applies halfway through a sample
+typedef struct {
+    uint8_t enterRssi;
+    uint8_t exitRssi;
+    uint32_t minLapMs;
+    uint32_t version;  // Increases with every published change
+} timing_config_t;
+
 class Config {
    public:
     void init();
@@ -127,6 +168,9 @@ class Config {
     void toJsonString(char* buf);
     void fromJson(JsonObject source);
     void handleEeprom(uint32_t currentTimeMs);
+    
+    // Consistent copy of the timing thresholds, safe from any task
+    void getTimingSnapshot(timing_config_t& out) const;
 
     // getters and setters
     uint16_t getFrequency();
@@ -152,8 +196,16 @@ class Config {
     uint8_t getWebhookRaceStart();
     uint8_t getWebhookRaceStop();
     uint8_t getWebhookLap();
+    uint8_t getRawRecord();
+    // Extra receivers, node 1 to CONFIG_EXTRA_NODES
+    uint16_t getNodeFrequency(uint8_t node);
+    uint8_t getNodeEnterRssi(uint8_t node);
+    uint8_t getNodeExitRssi(uint8_t node);
+    uint8_t getHopPilots();
+    uint16_t getHopDwellMs();
     char* getSsid();
     char* getPassword();
+    const char* getPilotName();
     uint8_t getOperationMode();
     
     // Setters for RotorHazard node mode
@@ -180,12 +232,27 @@ class Config {
     void setWebhookRaceStart(uint8_t enabled);
     void setWebhookRaceStop(uint8_t enabled);
     void setWebhookLap(uint8_t enabled);
+    void setRawRecord(uint8_t enabled);
+    bool setNode(uint8_t node, uint16_t freq, uint8_t enterRssi, uint8_t exitRssi);
 
    private:
     laptimer_config_t conf;
+    laptimer_config_t stored;  // What NVS holds, to find the fields that changed
     bool modified;
     volatile uint32_t checkTimeMs = 0;
+    uint32_t firstChangeMs = 0;
+    
+    // Seqlock around timing: odd while a writer is copying in
+    std::atomic<uint32_t> timingSeq{0};
+    timing_config_t timing = {};
+    bool publishDeferred = false;  // fromJson() publishes once, after every field
+    void publishTiming();
     void setDefaults();
+    void setDefaultValues();
+    bool migrateFromEeprom();
+    void setNodeDefaults();
+    void writeFields(bool all);
+    void markModified();
 };
 
 #endif // CONFIG_H
@@ -0,0 +1,132 @@
+#include "filecache.h"
+
+#include <LittleFS.h>
+
+#include "debug.h"
+
+#ifdef ESP32S3
+#include <SD.h>
+#endif
+
+FileCache::FileCache() : storage(nullptr), mutex(NULL), useCounter(0), sdWasAvailable(false) {
+    clear();
+}
+
+void FileCache::init(Storage* storageBackend) {
+    storage = storageBackend;
+    if (!mutex) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    sdWasAvailable = storage && storage->isSDAvailable();
+}
+
+bool FileCache::lookup(const String& path, FileMeta& meta) {
+    if (!mutex) {
+        resolve(path, meta);
+        return meta.found;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    // Paths may have moved to the card once it is mounted
+    bool sdAvailable = storage && storage->isSDAvailable();
+    if (sdAvailable != sdWasAvailable) {
+        for (uint8_t i = 0; i < FILECACHE_ENTRIES; i++) {
+            entries[i].path = "";
+            entries[i].lastUsed = 0;
+        }
+        sdWasAvailable = sdAvailable;
+    }
+
+    uint32_t now = millis();
+    FileMeta* slot = &entries[0];
+    for (uint8_t i = 0; i < FILECACHE_ENTRIES; i++) {
+        FileMeta& entry = entries[i];
+        if (entry.path.length() > 0 && entry.path == path) {
+            uint32_t ttl = entry.found ? FILECACHE_TTL_MS : FILECACHE_MISS_TTL_MS;
+            if (now - entry.resolvedMs < ttl) {
+                entry.lastUsed = ++useCounter;
+                meta = entry;
+                xSemaphoreGive(mutex);
+                return meta.found;
+            }
+            slot = &entry;  // Stale, refresh in place
+            break;
+        }
+        if (entry.lastUsed < slot->lastUsed) {
+            slot = &entry;
+        }
+    }
+
+    // Resolved under the lock - the filesystem calls are short and this keeps
+    // concurrent requests for the same clip from all hitting the card
+    resolve(path, *slot);
+    slot->lastUsed = ++useCounter;
+    meta = *slot;
+    xSemaphoreGive(mutex);
+    return meta.found;
+}
+
+void FileCache::resolve(const String& path, FileMeta& meta) {
+    meta.path = path;
+    meta.found = false;
+    meta.onSD = false;
+    meta.size = 0;
+    meta.lastWrite = 0;
+    meta.etag = "";
+    meta.resolvedMs = millis();
+
+    File file;
+#ifdef ESP32S3
+    if (storage && storage->isSDAvailable() && SD.exists(path)) {
+        file = SD.open(path, FILE_READ);
+        meta.onSD = true;
+    }
+#endif
+    if (!file && LittleFS.exists(path)) {
+        file = LittleFS.open(path, "r");
+        meta.onSD = false;
+    }
+    if (!file || file.isDirectory()) {
+        return;
+    }
+
+    meta.found = true;
+    meta.size = file.size();
+    meta.lastWrite = file.getLastWrite();
+    file.close();
+
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%x-%lx\"", (unsigned)meta.size, (unsigned long)meta.lastWrite);
+    meta.etag = etag;
+}
+
+File FileCache::open(const FileMeta& meta) {
+#ifdef ESP32S3
+    if (meta.onSD) {
+        return SD.open(meta.path, FILE_READ);
+    }
+#endif
+    return LittleFS.open(meta.path, "r");
+}
+
+void FileCache::invalidate(const String& path) {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < FILECACHE_ENTRIES; i++) {
+        if (entries[i].path == path) {
+            entries[i].path = "";
+            entries[i].lastUsed = 0;
+        }
+    }
+    if (mutex) xSemaphoreGive(mutex);
+}
+
+void FileCache::clear() {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < FILECACHE_ENTRIES; i++) {
+        entries[i].path = "";
+        entries[i].found = false;
+        entries[i].lastUsed = 0;
+        entries[i].resolvedMs = 0;
+    }
+    if (mutex) xSemaphoreGive(mutex);
+}
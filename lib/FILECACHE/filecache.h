@@ -0,0 +1,60 @@
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+/**
+ * Metadata cache for files served over HTTP
+ *
+ * Voice clips are requested over and over during a race; resolving them
+ * means an exists() and an open() on SD or LittleFS every time. This keeps
+ * the last few resolved paths with their backend, size, mtime and ETag so
+ * repeat requests (and 304 revalidations) skip the filesystem.
+ *
+ * - Least recently used entry is replaced when full.
+ * - Entries are re-resolved after FILECACHE_TTL_MS, misses after
+ *   FILECACHE_MISS_TTL_MS, and all of them when the SD card comes up.
+ */
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "storage.h"
+
+#define FILECACHE_ENTRIES 32
+#define FILECACHE_TTL_MS 60000
+#define FILECACHE_MISS_TTL_MS 5000
+
+struct FileMeta {
+    String path;
+    bool found;
+    bool onSD;          // Backend the file was found on
+    size_t size;
+    time_t lastWrite;
+    String etag;        // Strong validator from size and mtime
+    uint32_t resolvedMs;
+    uint32_t lastUsed;  // LRU stamp
+};
+
+class FileCache {
+   public:
+    FileCache();
+    void init(Storage* storage);
+
+    // Resolve path on SD (if mounted) then LittleFS; false if it exists on neither
+    bool lookup(const String& path, FileMeta& meta);
+    File open(const FileMeta& meta);
+    void invalidate(const String& path);
+    void clear();
+
+   private:
+    Storage* storage;
+    SemaphoreHandle_t mutex;
+    FileMeta entries[FILECACHE_ENTRIES];
+    uint32_t useCounter;
+    bool sdWasAvailable;
+
+    void resolve(const String& path, FileMeta& meta);
+};
+
+#endif  // FILECACHE_H
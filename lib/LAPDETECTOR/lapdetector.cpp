@@ -0,0 +1,133 @@
+#include "lapdetector.h"
+
+#include <Arduino.h>
+#include <math.h>
+
+#include "debug.h"
+
+LapDetector::LapDetector()
+    : cfg(), rssi(0), peak(0), peakTimeMs(0), raceStartMs(0), lapStartMs(0), running(false) {
+}
+
+bool LapDetector::init() {
+    return laps.init();
+}
+
+void LapDetector::configure(const lap_detector_config_t& config) {
+    cfg = config;
+    if (cfg.smoothing < 1) cfg.smoothing = 1;
+    if (cfg.smoothing > LAPDETECTOR_MAX_SMOOTHING) cfg.smoothing = LAPDETECTOR_MAX_SMOOTHING;
+    kalman.setNoise(cfg.filterQ, cfg.filterR);
+    average.setLength(cfg.smoothing);
+}
+
+void LapDetector::start(uint32_t startMs) {
+    laps.clear();
+    raceStartMs = startMs;
+    lapStartMs = startMs;
+    peak = 0;
+    peakTimeMs = 0;
+    running = true;
+}
+
+void LapDetector::process(uint8_t rawRssi, uint32_t nowMs, bool detecting) {
+    // Filtering runs between races too, so it is settled at the start
+    uint8_t value = rawRssi;
+    kalman.step(value);
+    average.step(value);
+    rssi = value;
+
+    if (!running || !detecting) {
+        return;
+    }
+
+    // Same rules as the live detector: gate 1 skips the minimum lap time
+    bool isGate1 = laps.total() == 0;
+    if (!isGate1 && (nowMs - lapStartMs) <= cfg.minLapMs) {
+        return;
+    }
+
+    if (rssi >= cfg.enterRssi && rssi > peak) {
+        peak = rssi;
+        peakTimeMs = nowMs;
+    }
+
+    bool validPeak = TunablePeakMarginValidator::valid(peak, cfg.enterRssi, cfg.exitRssi, cfg.peakMargin);
+    if (!validPeak || rssi >= cfg.exitRssi) {
+        return;
+    }
+
+    uint32_t lapTimeMs = peakTimeMs - (isGate1 ? raceStartMs : lapStartMs);
+    if (!laps.append(lapTimeMs, peakTimeMs, peak)) {
+        DEBUG("Shadow lap log full, lap %u not kept\n", laps.total());
+    }
+    lapStartMs = peakTimeMs;
+    peak = 0;
+    peakTimeMs = 0;
+}
+
+void LapDetector::compare(const LapLog& live, const LapLog& shadow, lap_compare_t& out) {
+    memset(&out, 0, sizeof(out));
+    uint32_t liveCount = live.size();
+    uint32_t shadowCount = shadow.size();
+    out.livePasses = liveCount;
+    out.shadowPasses = shadowCount;
+
+    // Both logs are in time order; walk them together
+    int64_t passDeltaSum = 0;
+    int64_t lapDeltaSum = 0;
+    bool previousMatched = true;  // Gate 1 is timed from the race start on both
+    uint32_t l = 0;
+    uint32_t s = 0;
+    while (l < liveCount || s < shadowCount) {
+        if (s >= shadowCount) {
+            out.missed++;
+            l++;
+            previousMatched = false;
+            continue;
+        }
+        if (l >= liveCount) {
+            out.extra++;
+            s++;
+            previousMatched = false;
+            continue;
+        }
+
+        const lap_record_t& liveLap = live[l];
+        const lap_record_t& shadowLap = shadow[s];
+        int32_t delta = (int32_t)(shadowLap.timestampMs - liveLap.timestampMs);
+        if (delta > LAPDETECTOR_MATCH_MS) {
+            out.missed++;
+            l++;
+            previousMatched = false;
+        } else if (delta < -LAPDETECTOR_MATCH_MS) {
+            out.extra++;
+            s++;
+            previousMatched = false;
+        } else {
+            out.matched++;
+            passDeltaSum += delta;
+            if ((uint32_t)abs(delta) > out.maxPassDeltaMs) {
+                out.maxPassDeltaMs = abs(delta);
+            }
+            if (previousMatched) {
+                int32_t lapDelta = (int32_t)(shadowLap.lapTimeMs - liveLap.lapTimeMs);
+                out.lapsCompared++;
+                lapDeltaSum += lapDelta;
+                if ((uint32_t)abs(lapDelta) > out.maxLapDeltaMs) {
+                    out.maxLapDeltaMs = abs(lapDelta);
+                }
+            }
+            previousMatched = true;
+            l++;
+            s++;
+        }
+    }
+
+    if (out.matched > 0) {
+        out.meanPassDeltaMs = passDeltaSum / (int64_t)out.matched;
+    }
+    if (out.lapsCompared > 0) {
+        out.meanLapDeltaMs = lapDeltaSum / (int64_t)out.lapsCompared;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef LAPDETECTOR_H
+#define LAPDETECTOR_H
+
+/**
+ * Shadow lap detector
+ *
+ * Runs the same peak detection as LapTimer - Kalman filter, moving
+ * average, peak above enter, lap when the signal drops below exit - with
+ * its own settings, on the raw samples the timer reads. The filter and
+ * peak check are the Tunable stages of rssipipeline.h, so the two
+ * detectors share their code. Its laps only go
+ * to its own LapLog: no buzzer, LEDs, webhooks or transports, so new
+ * thresholds or filter settings can be tried during a live race.
+ *
+ * compare() matches its passes against the live ones by peak time.
+ *
+ * Costs one Kalman step and a short moving average per sample.
+ */
+
+#include <stdint.h>
+
+#include "laplog.h"
+#include "rssipipeline.h"
+
+#define LAPDETECTOR_MAX_SMOOTHING 8  // Longest moving average
+#define LAPDETECTOR_MATCH_MS 1000    // Passes closer than this are the same pass
+
+typedef struct {
+    uint8_t enterRssi;
+    uint8_t exitRssi;
+    uint8_t smoothing;   // Moving average length over the Kalman output
+    uint8_t peakMargin;  // Peak must be this far above exit to count
+    uint32_t minLapMs;
+    uint16_t filterQ;    // Kalman measurement noise x 100
+    uint16_t filterR;    // Kalman process noise x 10000
+} lap_detector_config_t;
+
+// Shadow laps against live laps, one race
+typedef struct {
+    uint32_t livePasses;
+    uint32_t shadowPasses;
+    uint32_t matched;
+    uint32_t missed;          // Live passes the shadow detector didn't see
+    uint32_t extra;           // Shadow passes with no live pass
+    int32_t meanPassDeltaMs;  // Shadow peak time minus live, matched passes
+    uint32_t maxPassDeltaMs;
+    uint32_t lapsCompared;    // Matched passes whose previous pass matched too
+    int32_t meanLapDeltaMs;   // Shadow lap time minus live
+    uint32_t maxLapDeltaMs;
+} lap_compare_t;
+
+class LapDetector {
+   public:
+    LapDetector();
+    bool init();  // Allocates the lap log
+    void configure(const lap_detector_config_t& config);
+    const lap_detector_config_t& getConfig() const { return cfg; }
+
+    void start(uint32_t raceStartMs);
+    void stop() { running = false; }
+
+    // Every sample; laps are only detected while detecting is set
+    void process(uint8_t rawRssi, uint32_t nowMs, bool detecting);
+
+    uint8_t getRssi() const { return rssi; }
+    const LapLog& getLaps() const { return laps; }
+
+    static void compare(const LapLog& live, const LapLog& shadow, lap_compare_t& out);
+
+   private:
+    lap_detector_config_t cfg;
+    TunableKalmanStage kalman;
+    TunableAverageStage<LAPDETECTOR_MAX_SMOOTHING> average;
+    LapLog laps;
+    uint8_t rssi;
+    uint8_t peak;
+    uint32_t peakTimeMs;
+    uint32_t raceStartMs;
+    uint32_t lapStartMs;
+    bool running;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "laplog.h"
+
+#include <Arduino.h>
+
+#include "debug.h"
+
+LapLog::LapLog() : arena(nullptr), maxLaps(0), count(0), dropped(0) {
+}
+
+bool LapLog::init() {
+    if (arena) return true;
+
+#ifdef BOARD_HAS_PSRAM
+    if (psramFound()) {
+        arena = (lap_record_t*)ps_malloc(LAPLOG_MAX_LAPS_PSRAM * sizeof(lap_record_t));
+        if (arena) {
+            maxLaps = LAPLOG_MAX_LAPS_PSRAM;
+        }
+    }
+#endif
+    if (!arena) {
+        arena = (lap_record_t*)malloc(LAPLOG_MAX_LAPS * sizeof(lap_record_t));
+        maxLaps = arena ? LAPLOG_MAX_LAPS : 0;
+    }
+
+    if (!arena) {
+        DEBUG("LapLog: failed to allocate lap arena\n");
+        return false;
+    }
+    DEBUG("LapLog: %u laps (%u bytes)\n", maxLaps, maxLaps * sizeof(lap_record_t));
+    clear();
+    return true;
+}
+
+void LapLog::clear() {
+    count = 0;
+    dropped = 0;
+}
+
+bool LapLog::append(uint32_t lapTimeMs, uint32_t timestampMs, uint8_t peakRssi) {
+    if (count >= maxLaps) {
+        dropped++;
+        return false;
+    }
+    lap_record_t& lap = arena[count];
+    lap.lapTimeMs = lapTimeMs;
+    lap.timestampMs = timestampMs;
+    lap.peakRssi = peakRssi;
+    count = count + 1;  // Publish only after the record is complete
+    return true;
+}
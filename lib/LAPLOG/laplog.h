@@ -0,0 +1,52 @@
+#ifndef LAPLOG_H
+#define LAPLOG_H
+
+/**
+ * Per-race lap log
+ *
+ * Keeps every lap of a race (not just the last few) in an arena that is
+ * allocated once at boot, so endurance sessions never touch the heap while
+ * timing. Append and random access are O(1). When the arena is full further
+ * laps are counted as dropped instead of overwriting earlier ones.
+ *
+ * Single writer (the timing loop); readers on other tasks only ever access
+ * indices below size(), which is published after the record is written.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LAPLOG_MAX_LAPS 512          // Arena size in internal RAM
+#define LAPLOG_MAX_LAPS_PSRAM 8192   // Arena size when PSRAM is available
+
+typedef struct {
+    uint32_t lapTimeMs;    // Lap time (gate 1: time from race start)
+    uint32_t timestampMs;  // millis() of the RSSI peak that closed the lap
+    uint8_t peakRssi;      // Peak RSSI of the pass
+} lap_record_t;
+
+class LapLog {
+   public:
+    LapLog();
+    bool init();
+    void clear();
+    bool append(uint32_t lapTimeMs, uint32_t timestampMs, uint8_t peakRssi);
+
+    uint32_t size() const { return count; }
+    uint32_t capacity() const { return maxLaps; }
+    uint32_t getDropped() const { return dropped; }
+    uint32_t total() const { return count + dropped; }  // Laps seen this race
+    bool empty() const { return count == 0; }
+
+    // Callers must check index < size()
+    const lap_record_t& operator[](uint32_t index) const { return arena[index]; }
+    const lap_record_t& back() const { return arena[count - 1]; }
+
+   private:
+    lap_record_t* arena;
+    uint32_t maxLaps;
+    volatile uint32_t count;
+    uint32_t dropped;
+};
+
+#endif
@@ -1,7 +1,11 @@
 #include "laptimer.h"
+#include "racejournal.h"
+#include "racerecorder.h"
 #include "trackmanager.h"
 #include "webhook.h"
 
+#include <time.h>
+
 #include "debug.h"
 
 #ifdef ESP32S3
@@ -9,38 +13,70 @@
 extern RgbLed* g_rgbLed;
 #endif
 
-// Light Kalman filtering since hardware cap does most of the work
-// Lower Q = less filtering (hardware cap already smooths noise)
-// Lower R = faster response to real signal changes
-const uint16_t rssi_filter_q = 500;   // Light filtering with hardware cap
-const uint16_t rssi_filter_r = 50;    // Fast response
-
-void LapTimer::init(Config *config, RX5808 *rx5808, Buzzer *buzzer, Led *l, WebhookManager *webhook) {
+void LapTimer::init(Config *config, RX5808 *rx5808, Buzzer *buzzer, Led *l, WebhookManager *webhook, RaceJournal *raceJournal, RaceRecorder *raceRecorder, CalibrationLog *calibrationLog, RssiRecorder *rssiRecorder) {
     conf = config;
+    conf->getTimingSnapshot(timing);
     rx = rx5808;
     buz = buzzer;
     led = l;
     webhooks = webhook;
+    journal = raceJournal;
+    recorder = raceRecorder;
+    calibration = calibrationLog;
+    rawRecorder = rssiRecorder;
+
+    laps.init();
+    passTraces.init();
+    candidateActive = false;
+    candidateLapped = false;
 
-    filter.setMeasurementNoise(rssi_filter_q * 0.01f);
-    filter.setProcessNoise(rssi_filter_r * 0.0001f);
+    // The shadow detector starts out as a copy of the live one
+    lap_detector_config_t shadowConfig;
+    shadowConfig.enterRssi = timing.enterRssi;
+    shadowConfig.exitRssi = timing.exitRssi;
+    shadowConfig.smoothing = 3;
+    shadowConfig.peakMargin = 5;
+    shadowConfig.minLapMs = timing.minLapMs;
+    shadowConfig.filterQ = RSSI_FILTER_Q;
+    shadowConfig.filterR = RSSI_FILTER_R;
+    shadow.configure(shadowConfig);
+    shadowEnabled = false;
+    shadowMutex = xSemaphoreCreateMutex();
+    shadowRequestConfig = shadowConfig;
+    shadowRequestEnabled = false;
+    shadowAllocated = false;
+    shadowReportValid = false;
 
     selectedTrack = nullptr;
     totalDistanceTravelled = 0.0f;
     distanceRemaining = 0.0f;
 
-    stop();
+    finishStop();
     memset(rssi, 0, sizeof(rssi));
-    memset(rssi_window, 0, sizeof(rssi_window));
-    rssi_window_index = 0;
+}
+
+bool LapTimer::onTimingTask() const {
+    // Before the first sample nothing else touches the logs either
+    return timingTask == NULL || xTaskGetCurrentTaskHandle() == timingTask;
 }
 
 void LapTimer::start() {
+    // Clears the pass traces, so it runs where they are written
+    if (onTimingTask()) {
+        finishStart();
+    } else {
+        // A stop still pending runs first, making this a restart
+        startRequested.store(true);
+    }
+}
+
+void LapTimer::finishStart() {
     DEBUG("\n=== RACE STARTED ===\n");
     DEBUG("Current Thresholds:\n");
-    DEBUG("  Enter RSSI: %u\n", conf->getEnterRssi());
-    DEBUG("  Exit RSSI: %u\n", conf->getExitRssi());
-    DEBUG("  Min Lap Time: %u ms\n", conf->getMinLapMs());
+    conf->getTimingSnapshot(timing);
+    DEBUG("  Enter RSSI: %u\n", timing.enterRssi);
+    DEBUG("  Exit RSSI: %u\n", timing.exitRssi);
+    DEBUG("  Min Lap Time: %u ms\n", timing.minLapMs);
     DEBUG("\nCurrent RSSI: %u\n", rssi[rssiCount]);
     DEBUG("\nIf laps aren't detected, your thresholds may be too high!\n");
     DEBUG("Suggested values based on typical signal:\n");
@@ -51,12 +87,30 @@ void LapTimer::start() {
     
     raceStartTimeMs = millis();
     startTimeMs = raceStartTimeMs;  // Initialize start time for min lap check
+    passTraces.clear();  // Kept after stop so the finished race can save them
+    if (shadowEnabled) {
+        shadow.start(raceStartTimeMs);
+        shadowReportValid = false;
+    }
+    candidateActive = false;
+    candidateLapped = false;
     state = RUNNING;
+    raceStateSeq++;
     rssiPeak = 0;  // Clear any spurious peak values
     rssiPeakTimeMs = 0;
     gateExited = true;  // Start assuming we're outside the gate
     totalDistanceTravelled = 0.0f;
     distanceRemaining = 0.0f;
+    uint32_t unixTime = (uint32_t)time(nullptr);
+    if (journal) {
+        journal->logRaceStart(unixTime, conf->getFrequency());
+    }
+    if (recorder) {
+        recorder->logRaceStart(unixTime);
+    }
+    if (rawRecorder && conf->getRawRecord()) {
+        rawRecorder->begin(unixTime, conf->getFrequency(), timing.enterRssi, timing.exitRssi);
+    }
     buz->beep(500);
     led->on(500);
 #ifdef ESP32S3
@@ -70,10 +124,37 @@ void LapTimer::start() {
 }
 
 void LapTimer::stop() {
+    // The lap log and pass traces have one writer, the timing loop; a stop
+    // from the web or USB task is handed to it
+    if (onTimingTask()) {
+        finishStop();
+    } else {
+        // Supersedes a start that hasn't run yet
+        startRequested.store(false);
+        stopRequested.store(true);
+    }
+}
+
+void LapTimer::finishStop() {
     DEBUG("LapTimer stopped\n");
+    if (state == RUNNING || state == WAITING) {
+        // Timing task, so no sample() can finalize the same trace; and
+        // before logRaceStop() has the recorder save them with the race
+        passTraces.flush();
+        if (shadowEnabled) {
+            // The live laps are cleared below
+            shadow.stop();
+            LapDetector::compare(laps, shadow.getLaps(), shadowReport);
+            shadowReportValid = true;
+        }
+        if (journal) journal->logRaceStop();
+        if (recorder) recorder->logRaceStop();
+    }
+    if (rawRecorder) rawRecorder->end();
     state = STOPPED;
-    lapCountWraparound = false;
-    lapCount = 0;
+    raceStateSeq++;
+    laps.clear();
+    lastLapTimeMs = 0;
     rssiCount = 0;
     rssiPeak = 0;  // Clear peak tracking
     rssiPeakTimeMs = 0;
@@ -81,7 +162,6 @@ void LapTimer::stop() {
     gateExited = true;
     totalDistanceTravelled = 0.0f;
     distanceRemaining = 0.0f;
-    memset(lapTimes, 0, sizeof(lapTimes));
     buz->beep(500);
     led->on(500);
 #ifdef ESP32S3
@@ -95,29 +175,47 @@ void LapTimer::stop() {
 }
 
 void LapTimer::handleLapTimerUpdate(uint32_t currentTimeMs) {
-    // Read RSSI and apply two-stage filtering:
-    // 1. Kalman filter for adaptive smoothing
-    // 2. Moving average for additional noise reduction
-    uint8_t rawRssi = rx->readRssi();
-    uint8_t kalman_filtered = round(filter.filter(rawRssi, 0));
+    if (timingTask == NULL) {
+        timingTask = xTaskGetCurrentTaskHandle();
+    }
+    // Stop before start, for a restart requested from two calls
+    if (stopRequested.load()) {
+        finishStop();
+        stopRequested.store(false);
+    }
+    if (startRequested.load()) {
+        finishStart();
+        startRequested.store(false);
+    }
+    if (shadowRequested.load()) {
+        applyShadowRequest();
+    }
     
-    // Small moving average (3 samples) - hardware cap provides main filtering
-    rssi_window[rssi_window_index] = kalman_filtered;
-    rssi_window_index = (rssi_window_index + 1) % 3;
+    // Thresholds are taken once per sample; a change made meanwhile from
+    // the web applies from the next sample on, never halfway through
+    conf->getTimingSnapshot(timing);
     
-    // Calculate moving average over 3 samples
-    uint16_t sum = 0;
-    for (int i = 0; i < 3; i++) {
-        sum += rssi_window[i];
+    // Read RSSI and filter it; by default a Kalman filter for adaptive
+    // smoothing, then a 3-sample moving average (see rssipipeline.h)
+    uint8_t rawRssi;
+    if (rx->isHopping()) {
+        // Only samples taken on slot 0, this timer's frequency; the other
+        // pilots' slots go to MultiNode
+        uint8_t slot;
+        if (!rx->readHopSample(slot, rawRssi) || slot != 0) {
+            return;
+        }
+    } else {
+        rawRssi = rx->readRssi();
     }
-    rssi[rssiCount] = sum / 3;
+    rssi[rssiCount] = pipeline.filter(rawRssi);
     
     // RSSI debug output disabled for cleaner serial monitor
     // Uncomment below to re-enable RSSI filtering debug:
     // static uint32_t debugCounter = 0;
     // if (state == RUNNING && debugCounter++ % 50 == 0) {
-    //     DEBUG("Raw: %u -> Kalman: %u -> Avg: %u | Peak: %u, Time: %u ms\n", 
-    //           rawRssi, kalman_filtered, rssi[rssiCount], rssiPeak, currentTimeMs - startTimeMs);
+    //     DEBUG("Raw: %u -> Filtered: %u | Peak: %u, Time: %u ms\n", 
+    //           rawRssi, rssi[rssiCount], rssiPeak, currentTimeMs - startTimeMs);
     // }
 
     switch (state) {
@@ -134,8 +232,8 @@ void LapTimer::handleLapTimerUpdate(uint32_t currentTimeMs) {
         case RUNNING: {
             // Gate 1 (first lap) bypasses minimum lap time check
             // All subsequent laps must respect minimum lap time
-            bool isGate1 = (lapCount == 0 && !lapCountWraparound);
-            bool minLapElapsed = (currentTimeMs - startTimeMs) > conf->getMinLapMs();
+            bool isGate1 = (laps.total() == 0);
+            bool minLapElapsed = (currentTimeMs - startTimeMs) > timing.minLapMs;
             
             if (isGate1 || minLapElapsed) {
                 // Capture peaks and detect laps
@@ -154,24 +252,128 @@ void LapTimer::handleLapTimerUpdate(uint32_t currentTimeMs) {
         case CALIBRATION_WIZARD:
             // Record RSSI data without triggering lap detection
             // Sample every 20ms (50Hz) for longer recording duration with good resolution
-            if (calibrationRssiCount < LAPTIMER_CALIBRATION_HISTORY && 
-                (currentTimeMs - lastCalibrationSampleMs) >= 20) {
-                calibrationRssi[calibrationRssiCount] = rssi[rssiCount];
-                calibrationTimestamps[calibrationRssiCount] = currentTimeMs;
-                calibrationRssiCount++;
+            if (calibration && (currentTimeMs - lastCalibrationSampleMs) >= LAPTIMER_CALIBRATION_INTERVAL_MS) {
+                calibration->append(rssi[rssiCount], currentTimeMs);
                 lastCalibrationSampleMs = currentTimeMs;
             }
             break;
         default:
             break;
     }
+    
+    if (shadowEnabled) {
+        shadow.process(rawRssi, currentTimeMs, state == RUNNING);
+    }
+    
+    if (state == RUNNING || state == WAITING) {
+        if (rawRecorder) {
+            rawRecorder->append(micros(), rawRssi, rssi[rssiCount], state, laps.total());
+        }
+        passTraces.sample(rawRssi, rssi[rssiCount], currentTimeMs);
+        trackPassCandidate(currentTimeMs);
+    }
 
     rssiCount = (rssiCount + 1) % LAPTIMER_RSSI_HISTORY;
 }
 
+void LapTimer::trackPassCandidate(uint32_t currentTimeMs) {
+    // Follows the signal independently of lap detection, so passes the
+    // detector ignored or rejected are traced as well as the laps
+    uint8_t current = rssi[rssiCount];
+    if (candidateLapped) {
+        passTraces.markPass(PASS_ACCEPTED, laps.total(), candidatePeak, timing.enterRssi, timing.exitRssi, currentTimeMs);
+        candidateLapped = false;
+        candidateActive = false;
+        return;
+    }
+    
+    if (!candidateActive) {
+        if (current >= timing.enterRssi) {
+            candidateActive = true;
+            candidatePeak = current;
+            candidateStartMs = currentTimeMs;
+        }
+        return;
+    }
+    
+    if (current > candidatePeak) {
+        candidatePeak = current;
+    }
+    bool exited = current < timing.exitRssi;
+    bool timedOut = (currentTimeMs - candidateStartMs) > PASSTRACE_MAX_PASS_MS;
+    if (!exited && !timedOut) {
+        return;
+    }
+    
+    uint8_t outcome;
+    if (timedOut) {
+        outcome = PASS_REJECTED_TIMEOUT;
+    } else if (state == RUNNING && laps.total() > 0 && (currentTimeMs - startTimeMs) <= timing.minLapMs) {
+        outcome = PASS_REJECTED_MIN_LAP;
+    } else if (candidatePeak <= timing.exitRssi + 5) {
+        outcome = PASS_REJECTED_WEAK;
+    } else {
+        outcome = PASS_REJECTED;
+    }
+    passTraces.markPass(outcome, laps.total(), candidatePeak, timing.enterRssi, timing.exitRssi, currentTimeMs);
+    candidateActive = false;
+}
+
+bool LapTimer::setShadowDetector(bool enabled, const lap_detector_config_t &config) {
+    if (state == RUNNING || state == WAITING) {
+        return false;
+    }
+    // The lap log is only allocated here, before the detector is ever
+    // enabled, so the timing loop can't be using it yet
+    if (enabled && !shadowAllocated) {
+        if (!shadow.init()) {
+            return false;
+        }
+        shadowAllocated = true;
+    }
+    xSemaphoreTake(shadowMutex, portMAX_DELAY);
+    shadowRequestConfig = config;
+    shadowRequestEnabled = enabled;
+    shadowRequested.store(true);
+    xSemaphoreGive(shadowMutex);
+    return true;
+}
+
+lap_detector_config_t LapTimer::getShadowConfig() {
+    xSemaphoreTake(shadowMutex, portMAX_DELAY);
+    lap_detector_config_t config = shadowRequestConfig;
+    xSemaphoreGive(shadowMutex);
+    return config;
+}
+
+void LapTimer::applyShadowRequest() {
+    // Timing loop, between shadow.process() calls. A race that started
+    // after the request was accepted keeps the old settings until it stops;
+    // a request being written right now is picked up on the next sample.
+    if (isRaceActive() || xSemaphoreTake(shadowMutex, 0) != pdTRUE) {
+        return;
+    }
+    shadow.configure(shadowRequestConfig);
+    shadowEnabled = shadowRequestEnabled;
+    shadowRequested.store(false);
+    xSemaphoreGive(shadowMutex);
+}
+
+bool LapTimer::getShadowReport(lap_compare_t &report) {
+    if (shadowEnabled && (state == RUNNING || state == WAITING)) {
+        LapDetector::compare(laps, shadow.getLaps(), report);
+        return true;
+    }
+    if (shadowReportValid) {
+        report = shadowReport;
+        return true;
+    }
+    return false;
+}
+
 void LapTimer::lapPeakCapture() {
     // Capture any RSSI above enter threshold as a potential peak
-    if (rssi[rssiCount] >= conf->getEnterRssi()) {
+    if (rssi[rssiCount] >= timing.enterRssi) {
         if (rssi[rssiCount] > rssiPeak) {
             rssiPeak = rssi[rssiCount];
             rssiPeakTimeMs = millis();
@@ -185,14 +387,13 @@ bool LapTimer::lapPeakCaptured() {
     // Lap detection with strict validation:
     // 1. Must have captured a peak
     // 2. Peak must have crossed enter threshold (not just noise)
-    // 3. Peak must be significantly above exit threshold (at least 5 RSSI units)
+    // 3. Peak must be significantly above exit threshold (at least 5 RSSI
+    //    units; the validator is selected per target, see rssipipeline.h)
     // 4. Current RSSI must have dropped back below exit threshold
     
-    bool validPeak = (rssiPeak > 0) && 
-                     (rssiPeak >= conf->getEnterRssi()) && 
-                     (rssiPeak > (conf->getExitRssi() + 5));  // Peak must be well above exit
+    bool validPeak = LapTimerPeakValidator::valid(rssiPeak, timing.enterRssi, timing.exitRssi);
     
-    bool droppedBelowExit = (rssi[rssiCount] < conf->getExitRssi());
+    bool droppedBelowExit = (rssi[rssiCount] < timing.exitRssi);
     
     bool captured = validPeak && droppedBelowExit;
     
@@ -200,9 +401,9 @@ bool LapTimer::lapPeakCaptured() {
         DEBUG("\n*** LAP DETECTED! ***\n");
         DEBUG("  Current RSSI: %u\n", rssi[rssiCount]);
         DEBUG("  Peak was: %u\n", rssiPeak);
-        DEBUG("  Enter threshold: %u\n", conf->getEnterRssi());
-        DEBUG("  Exit threshold: %u\n", conf->getExitRssi());
-        DEBUG("  Peak margin above exit: %d\n", rssiPeak - conf->getExitRssi());
+        DEBUG("  Enter threshold: %u\n", timing.enterRssi);
+        DEBUG("  Exit threshold: %u\n", timing.exitRssi);
+        DEBUG("  Peak margin above exit: %d\n", rssiPeak - timing.exitRssi);
         DEBUG("******************\n\n");
     }
     
@@ -212,6 +413,10 @@ bool LapTimer::lapPeakCaptured() {
 void LapTimer::startLap() {
     DEBUG("Lap started - Peak was %u, new lap begins\n", rssiPeak);
     startTimeMs = rssiPeakTimeMs;
+    if (!candidateActive || rssiPeak > candidatePeak) {
+        candidatePeak = rssiPeak;
+    }
+    candidateLapped = true;  // Hole shot or lap, traced as accepted
     rssiPeak = 0;  // Reset peak for next lap
     rssiPeakTimeMs = 0;
     buz->beep(200);
@@ -219,16 +424,22 @@ void LapTimer::startLap() {
 }
 
 void LapTimer::finishLap() {
-    lapTimes[lapCount] = rssiPeakTimeMs - startTimeMs;
-    if (lapCount == 0 && lapCountWraparound == false)
-    {
-        lapTimes[0] = rssiPeakTimeMs - raceStartTimeMs;
+    // Gate 1 is timed from race start, every other lap from the previous pass
+    if (laps.total() == 0) {
+        lastLapTimeMs = rssiPeakTimeMs - raceStartTimeMs;
+    } else {
+        lastLapTimeMs = rssiPeakTimeMs - startTimeMs;
+    }
+    if (!laps.append(lastLapTimeMs, rssiPeakTimeMs, rssiPeak)) {
+        DEBUG("Lap log full, lap %u not kept\n", laps.total());
+    }
+    DEBUG("Lap finished, lap time = %u\n", lastLapTimeMs);
+    if (journal) {
+        journal->logLap(lastLapTimeMs, rssiPeak);
     }
-    else
-    {
-        lapTimes[lapCount] = rssiPeakTimeMs - startTimeMs;
+    if (recorder) {
+        recorder->logLap(lastLapTimeMs);
     }
-    DEBUG("Lap finished, lap time = %u\n", lapTimes[lapCount]);
     
     // Update distance if track is selected
     if (selectedTrack && selectedTrack->distance > 0) {
@@ -237,10 +448,7 @@ void LapTimer::finishLap() {
         // Calculate remaining distance if maxLaps is set
         uint8_t maxLaps = conf->getMaxLaps();
         if (maxLaps > 0) {
-            int lapsCompleted = lapCount + 1;
-            if (lapCountWraparound) {
-                lapsCompleted = LAPTIMER_LAP_HISTORY + (lapCount + 1);
-            }
+            int lapsCompleted = laps.total();
             int lapsRemaining = maxLaps - lapsCompleted;
             distanceRemaining = (lapsRemaining > 0) ? (lapsRemaining * selectedTrack->distance) : 0.0f;
         } else {
@@ -251,10 +459,6 @@ void LapTimer::finishLap() {
               totalDistanceTravelled, distanceRemaining);
     }
     
-    if ((lapCount + 1) % LAPTIMER_LAP_HISTORY == 0) {
-        lapCountWraparound = true;
-    }
-    lapCount = (lapCount + 1) % LAPTIMER_LAP_HISTORY;
     lapAvailable = true;
 #ifdef ESP32S3
     if (g_rgbLed) g_rgbLed->flashLap();
@@ -270,27 +474,44 @@ uint8_t LapTimer::getRssi() {
 }
 
 uint32_t LapTimer::getLapTime() {
-    uint32_t lapTime = 0;
     lapAvailable = false;
-    if (lapCount == 0) {
-        lapTime = lapTimes[LAPTIMER_LAP_HISTORY - 1];
-    } else {
-        lapTime = lapTimes[lapCount - 1];
+    return lastLapTimeMs;
+}
+
+uint32_t LapTimer::getLapCount() {
+    return laps.size();
+}
+
+bool LapTimer::getLap(uint32_t index, lap_record_t &lap) {
+    if (index >= laps.size()) {
+        return false;
     }
-    return lapTime;
+    lap = laps[index];
+    return true;
 }
 
 bool LapTimer::isLapAvailable() {
     return lapAvailable;
 }
 
+void LapTimer::addManualLap(uint32_t lapTimeMs) {
+    // Manual laps are timed by the client, only record them
+    if (state != RUNNING && state != WAITING) return;
+    if (journal) {
+        journal->logLap(lapTimeMs, 0);
+    }
+    if (recorder) {
+        recorder->logLap(lapTimeMs);
+    }
+}
+
 void LapTimer::startCalibrationWizard() {
     DEBUG("Calibration wizard started\n");
-    state = CALIBRATION_WIZARD;
-    calibrationRssiCount = 0;
+    if (calibration && !calibration->begin()) {
+        DEBUG("Calibration buffer unavailable\n");
+    }
     lastCalibrationSampleMs = 0;  // Reset sample timing
-    memset(calibrationRssi, 0, sizeof(calibrationRssi));
-    memset(calibrationTimestamps, 0, sizeof(calibrationTimestamps));
+    state = CALIBRATION_WIZARD;
     buz->beep(300);
     led->on(300);
 #ifdef ESP32S3
@@ -299,8 +520,11 @@ void LapTimer::startCalibrationWizard() {
 }
 
 void LapTimer::stopCalibrationWizard() {
-    DEBUG("Calibration wizard stopped, recorded %u samples\n", calibrationRssiCount);
+    DEBUG("Calibration wizard stopped, recorded %u samples\n", getCalibrationRssiCount());
     state = STOPPED;
+    if (calibration) {
+        calibration->end();
+    }
     buz->beep(300);
     led->on(300);
 #ifdef ESP32S3
@@ -308,22 +532,17 @@ void LapTimer::stopCalibrationWizard() {
 #endif
 }
 
-uint16_t LapTimer::getCalibrationRssiCount() {
-    return calibrationRssiCount;
-}
-
-uint8_t LapTimer::getCalibrationRssi(uint16_t index) {
-    if (index < calibrationRssiCount) {
-        return calibrationRssi[index];
+void LapTimer::clearCalibration() {
+    if (state == CALIBRATION_WIZARD) {
+        state = STOPPED;
+    }
+    if (calibration) {
+        calibration->release();
     }
-    return 0;
 }
 
-uint32_t LapTimer::getCalibrationTimestamp(uint16_t index) {
-    if (index < calibrationRssiCount) {
-        return calibrationTimestamps[index];
-    }
-    return 0;
+uint32_t LapTimer::getCalibrationRssiCount() {
+    return calibration ? calibration->size() : 0;
 }
 
 void LapTimer::setTrack(Track* track) {
@@ -1,15 +1,28 @@
 #ifndef LAPTIMER_H
 #define LAPTIMER_H
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <atomic>
+
 #include "RX5808.h"
 #include "buzzer.h"
+#include "calibrationlog.h"
 #include "config.h"
-#include "kalman.h"
+#include "lapdetector.h"
+#include "laplog.h"
 #include "led.h"
+#include "passtrace.h"
+#include "rssipipeline.h"
+#include "rssirecorder.h"
 
 // Forward declarations to avoid circular dependency
 struct Track;
 class WebhookManager;
+class RaceJournal;
+class RaceRecorder;
 
 typedef enum {
     STOPPED,
@@ -18,26 +31,48 @@ typedef enum {
     CALIBRATION_WIZARD
 } laptimer_state_e;
 
-#define LAPTIMER_LAP_HISTORY 10
 #define LAPTIMER_RSSI_HISTORY 100
-#define LAPTIMER_CALIBRATION_HISTORY 5000  // Increased buffer for longer recordings
+#define LAPTIMER_CALIBRATION_INTERVAL_MS 20  // Wizard sample rate (50 Hz)
 
 class LapTimer {
    public:
-    void init(Config *config, RX5808 *rx5808, Buzzer *buzzer, Led *l, WebhookManager *webhook = nullptr);
+    void init(Config *config, RX5808 *rx5808, Buzzer *buzzer, Led *l, WebhookManager *webhook = nullptr, RaceJournal *raceJournal = nullptr, RaceRecorder *raceRecorder = nullptr, CalibrationLog *calibrationLog = nullptr, RssiRecorder *rssiRecorder = nullptr);
+    // Any task; run on the timing loop, which owns the lap log and traces.
+    // From another task they only post the request and return, the change
+    // shows up in getRaceStateSeq() once the timing loop has made it.
     void start();
     void stop();
+    uint32_t getRaceStateSeq() const { return raceStateSeq.load(); }
     void handleLapTimerUpdate(uint32_t currentTimeMs);
     uint8_t getRssi();
     uint32_t getLapTime();
     bool isLapAvailable();
+    bool isRaceActive() const { return state == WAITING || state == RUNNING; }
+    uint32_t getRaceStartMs() const { return raceStartTimeMs; }
+    void addManualLap(uint32_t lapTimeMs);
+    
+    // Every lap of the current race, gate 1 included
+    uint32_t getLapCount();
+    bool getLap(uint32_t index, lap_record_t &lap);
+    
+    // RSSI around every pass candidate of the current (or last) race
+    const PassTraceLog& getPassTraces() const { return passTraces; }
+    RssiRecorder* getRssiRecorder() { return rawRecorder; }
+    
+    // Shadow detector; settings can only change between races. Any task:
+    // the timing loop applies them, the getters give the requested ones.
+    bool setShadowDetector(bool enabled, const lap_detector_config_t &config);
+    bool isShadowEnabled() const { return shadowRequestEnabled; }
+    lap_detector_config_t getShadowConfig();
+    const LapLog& getShadowLaps() const { return shadow.getLaps(); }
+    bool getShadowReport(lap_compare_t &report);  // Current race, or the last one
     
     // Calibration wizard methods
     void startCalibrationWizard();
     void stopCalibrationWizard();
-    uint16_t getCalibrationRssiCount();
-    uint8_t getCalibrationRssi(uint16_t index);
-    uint32_t getCalibrationTimestamp(uint16_t index);
+    void clearCalibration();  // Frees the recording buffer
+    uint32_t getCalibrationRssiCount();
+    CalibrationLog* getCalibrationLog() { return calibration; }
     
     // Track/distance methods
     void setTrack(Track* track);
@@ -47,33 +82,52 @@ class LapTimer {
 
    private:
     laptimer_state_e state = STOPPED;
+    TaskHandle_t timingTask = NULL;  // Set on the first sample
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> startRequested{false};
+    std::atomic<uint32_t> raceStateSeq{0};  // Bumped by every start and stop
     RX5808 *rx;
     Config *conf;
+    timing_config_t timing;  // Snapshot of the thresholds for the current sample
     Buzzer *buz;
     Led *led;
     WebhookManager *webhooks;
-    KalmanFilter filter;
-    boolean lapCountWraparound;
+    RaceJournal *journal;
+    RaceRecorder *recorder;
+    CalibrationLog *calibration;
+    RssiRecorder *rawRecorder;
+    LapTimerPipeline pipeline;  // Selected per target, see rssipipeline.h
     uint32_t raceStartTimeMs;
     uint32_t startTimeMs;
-    uint8_t lapCount;
     uint8_t rssiCount;
-    uint32_t lapTimes[LAPTIMER_LAP_HISTORY];
+    LapLog laps;
+    PassTraceLog passTraces;
+    LapDetector shadow;
+    volatile bool shadowEnabled;
+    SemaphoreHandle_t shadowMutex;  // Guards the requested settings
+    lap_detector_config_t shadowRequestConfig;
+    volatile bool shadowRequestEnabled;
+    std::atomic<bool> shadowRequested{false};
+    bool shadowAllocated;
+    bool shadowReportValid;
+    lap_compare_t shadowReport;  // Of the last finished race
+    uint32_t lastLapTimeMs;
     uint8_t rssi[LAPTIMER_RSSI_HISTORY];
-    uint8_t rssi_window[5];  // Small window for moving average
-    uint8_t rssi_window_index;
 
     uint8_t rssiPeak;
     uint32_t rssiPeakTimeMs;
     bool gateExited;  // Track if drone has fully exited gate after lap
+    
+    // Pass candidate for traces: from crossing enter to dropping below exit
+    bool candidateActive;
+    bool candidateLapped;  // startLap() ran since the last resolved candidate
+    uint8_t candidatePeak;
+    uint32_t candidateStartMs;
 
     bool lapAvailable = false;
     
-    // Calibration wizard data
-    uint16_t calibrationRssiCount;
-    uint8_t calibrationRssi[LAPTIMER_CALIBRATION_HISTORY];
-    uint32_t calibrationTimestamps[LAPTIMER_CALIBRATION_HISTORY];
-    uint32_t lastCalibrationSampleMs;  // Track when last sample was taken
+    // Calibration wizard sample timing
+    uint32_t lastCalibrationSampleMs;
     
     // Track/distance tracking
     Track* selectedTrack;
@@ -83,9 +137,14 @@ class LapTimer {
     void lapPeakCapture();
     bool lapPeakCaptured();
     void lapPeakReset();
+    void trackPassCandidate(uint32_t currentTimeMs);
 
     void startLap();
     void finishLap();
+    void finishStart();
+    void finishStop();
+    void applyShadowRequest();
+    bool onTimingTask() const;
 };
 
 #endif
@@ -0,0 +1,292 @@
+#include "leaderboard.h"
+
+#include <algorithm>
+#include <math.h>
+#include <memory>
+
+#include "debug.h"
+#include "racehistory.h"
+
+Leaderboard::Leaderboard() : storage(nullptr), mutex(NULL) {
+}
+
+void Leaderboard::init(Storage* storageBackend) {
+    storage = storageBackend;
+    if (!mutex) {
+        mutex = xSemaphoreCreateMutex();
+    }
+}
+
+String Leaderboard::pilotKey(const RaceSession& race) {
+    if (race.pilotCallsign.length() > 0) return race.pilotCallsign;
+    if (race.pilotName.length() > 0) return race.pilotName;
+    return "Pilot";
+}
+
+uint8_t Leaderboard::bucketFor(uint32_t lapMs) {
+    if (lapMs < LEADERBOARD_BUCKET_BASE_MS) {
+        return 0;
+    }
+    int bucket = (int)(logf((float)lapMs / LEADERBOARD_BUCKET_BASE_MS) / logf(LEADERBOARD_BUCKET_RATIO));
+    // Anything longer than the log-scale range lands in the overflow bucket
+    return (uint8_t)std::min(bucket, LEADERBOARD_OVERFLOW_BUCKET);
+}
+
+float Leaderboard::bucketStart(uint8_t bucket) {
+    return LEADERBOARD_BUCKET_BASE_MS * powf(LEADERBOARD_BUCKET_RATIO, bucket);
+}
+
+void Leaderboard::load(const std::vector<RaceSession>& races) {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    entries.clear();
+
+    bool loaded = false;
+    File file = storage ? storage->openFile(LEADERBOARD_PATH, "r") : File();
+    if (file) {
+        uint32_t header[2];
+        if (file.read((uint8_t*)header, sizeof(header)) == sizeof(header) &&
+            header[0] == LEADERBOARD_MAGIC && header[1] <= LEADERBOARD_MAX_ENTRIES) {
+            entries.resize(header[1]);
+            size_t bytes = header[1] * sizeof(leaderboard_entry_t);
+            loaded = file.read((uint8_t*)entries.data(), bytes) == bytes;
+        }
+        file.close();
+    }
+
+    if (!loaded) {
+        // First run (or unreadable file) - start from the races in history
+        entries.clear();
+        for (const auto& race : races) {
+            applyRace(race);
+        }
+        persist();
+    }
+    DEBUG("Leaderboard: %u pilot/track entries%s\n", entries.size(), loaded ? "" : " (rebuilt)");
+    xSemaphoreGive(mutex);
+}
+
+leaderboard_entry_t* Leaderboard::findEntry(const String& pilot, uint32_t trackId, bool create) {
+    for (auto& entry : entries) {
+        if (entry.trackId == trackId && pilot.equalsIgnoreCase(entry.pilot)) {
+            return &entry;
+        }
+    }
+    if (!create) {
+        return nullptr;
+    }
+    if (entries.size() >= LEADERBOARD_MAX_ENTRIES) {
+        // Make room by dropping the entry raced least recently
+        auto oldest = std::min_element(entries.begin(), entries.end(),
+            [](const leaderboard_entry_t& a, const leaderboard_entry_t& b) { return a.lastRace < b.lastRace; });
+        entries.erase(oldest);
+    }
+    leaderboard_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    strlcpy(entry.pilot, pilot.c_str(), sizeof(entry.pilot));
+    entry.trackId = trackId;
+    entries.push_back(entry);
+    return &entries.back();
+}
+
+void Leaderboard::applyRace(const RaceSession& race) {
+    if (race.lapTimes.empty()) {
+        return;
+    }
+    leaderboard_entry_t* entry = findEntry(pilotKey(race), race.trackId, true);
+    strlcpy(entry->trackName, race.trackName.c_str(), sizeof(entry->trackName));
+    entry->races++;
+    entry->lastRace = std::max(entry->lastRace, race.timestamp);
+
+    for (uint32_t lap : race.lapTimes) {
+        entry->laps++;
+        double delta = lap - entry->mean;
+        entry->mean += delta / entry->laps;
+        entry->m2 += delta * (lap - entry->mean);
+        uint16_t& count = entry->histogram[bucketFor(lap)];
+        if (count < UINT16_MAX) count++;
+    }
+
+    if (race.fastestLap > 0 && (entry->bestLap == 0 || race.fastestLap < entry->bestLap)) {
+        entry->bestLap = race.fastestLap;
+        entry->bestLapRace = race.timestamp;
+    }
+    if (race.best3ConsecutiveTotal > 0 &&
+        (entry->best3Consecutive == 0 || race.best3ConsecutiveTotal < entry->best3Consecutive)) {
+        entry->best3Consecutive = race.best3ConsecutiveTotal;
+        entry->best3Race = race.timestamp;
+    }
+}
+
+void Leaderboard::addRace(const RaceSession& race) {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    applyRace(race);
+    persist();
+    xSemaphoreGive(mutex);
+}
+
+void Leaderboard::removeRace(const RaceSession& race, const std::vector<RaceSession>& remaining) {
+    if (!mutex || race.lapTimes.empty()) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    String pilot = pilotKey(race);
+    leaderboard_entry_t* entry = findEntry(pilot, race.trackId, false);
+    if (!entry) {
+        xSemaphoreGive(mutex);
+        return;
+    }
+
+    if (entry->races <= 1 || entry->laps <= race.lapTimes.size()) {
+        // Last race for this pilot and track
+        entries.erase(entries.begin() + (entry - entries.data()));
+        persist();
+        xSemaphoreGive(mutex);
+        return;
+    }
+
+    entry->races--;
+    // Welford in reverse, newest lap first
+    for (auto it = race.lapTimes.rbegin(); it != race.lapTimes.rend(); ++it) {
+        double lap = *it;
+        double meanBefore = (entry->mean * entry->laps - lap) / (entry->laps - 1);
+        entry->m2 -= (lap - meanBefore) * (lap - entry->mean);
+        entry->mean = meanBefore;
+        entry->laps--;
+        uint16_t& count = entry->histogram[bucketFor(*it)];
+        if (count > 0) count--;
+    }
+    if (entry->m2 < 0) {
+        entry->m2 = 0;  // Rounding
+    }
+
+    if (entry->bestLapRace == race.timestamp || entry->best3Race == race.timestamp) {
+        rescanBests(*entry, remaining);
+    }
+    persist();
+    xSemaphoreGive(mutex);
+}
+
+void Leaderboard::rescanBests(leaderboard_entry_t& entry, const std::vector<RaceSession>& races) {
+    entry.bestLap = 0;
+    entry.bestLapRace = 0;
+    entry.best3Consecutive = 0;
+    entry.best3Race = 0;
+    for (const auto& race : races) {
+        if (race.trackId != entry.trackId || !pilotKey(race).equalsIgnoreCase(entry.pilot)) {
+            continue;
+        }
+        if (race.fastestLap > 0 && (entry.bestLap == 0 || race.fastestLap < entry.bestLap)) {
+            entry.bestLap = race.fastestLap;
+            entry.bestLapRace = race.timestamp;
+        }
+        if (race.best3ConsecutiveTotal > 0 &&
+            (entry.best3Consecutive == 0 || race.best3ConsecutiveTotal < entry.best3Consecutive)) {
+            entry.best3Consecutive = race.best3ConsecutiveTotal;
+            entry.best3Race = race.timestamp;
+        }
+    }
+}
+
+void Leaderboard::clear() {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    entries.clear();
+    persist();
+    xSemaphoreGive(mutex);
+}
+
+uint32_t Leaderboard::percentile(const leaderboard_entry_t& entry, float p) {
+    if (entry.laps == 0) {
+        return 0;
+    }
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < LEADERBOARD_BUCKETS; i++) {
+        total += entry.histogram[i];
+    }
+    float target = p * total;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LEADERBOARD_BUCKETS; i++) {
+        uint16_t count = entry.histogram[i];
+        if (count > 0 && seen + count >= target) {
+            if (i == LEADERBOARD_OVERFLOW_BUCKET) {
+                // Open-ended, only the lower edge is known
+                return (uint32_t)bucketStart(i);
+            }
+            // Interpolate within the bucket on the log scale
+            float within = (target - seen) / count;
+            float start = i == 0 ? 0.0f : bucketStart(i);
+            float end = bucketStart(i + 1);
+            return (uint32_t)(start + (end - start) * within);
+        }
+        seen += count;
+    }
+    return (uint32_t)bucketStart(LEADERBOARD_OVERFLOW_BUCKET);
+}
+
+void Leaderboard::getEntries(std::vector<leaderboard_entry_t>& out, const String& pilot, uint32_t trackId) {
+    out.clear();
+    if (mutex) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        for (const auto& entry : entries) {
+            if ((pilot.length() > 0 && !pilot.equalsIgnoreCase(entry.pilot)) ||
+                (trackId != 0 && entry.trackId != trackId)) {
+                continue;
+            }
+            out.push_back(entry);
+        }
+        xSemaphoreGive(mutex);
+    }
+    // Fastest first, entries without a best lap last
+    std::sort(out.begin(), out.end(), [](const leaderboard_entry_t& a, const leaderboard_entry_t& b) {
+        return (a.bestLap ? a.bestLap : UINT32_MAX) < (b.bestLap ? b.bestLap : UINT32_MAX);
+    });
+}
+
+void Leaderboard::toJson(Print& out, const String& pilot, uint32_t trackId) {
+    std::vector<leaderboard_entry_t> snapshot;
+    getEntries(snapshot, pilot, trackId);
+    out.print("{\"entries\":[");
+    bool first = true;
+    for (const auto& entry : snapshot) {
+        if (!first) out.print(",");
+        entryToJson(entry, out);
+        first = false;
+    }
+    out.print("]}");
+}
+
+void Leaderboard::entryToJson(const leaderboard_entry_t& entry, Print& out) {
+    DynamicJsonDocument doc(1024);
+    doc["pilot"] = entry.pilot;
+    doc["trackId"] = entry.trackId;
+    doc["trackName"] = entry.trackName;
+    doc["races"] = entry.races;
+    doc["laps"] = entry.laps;
+    doc["bestLap"] = entry.bestLap;
+    doc["bestLapRace"] = entry.bestLapRace;
+    doc["best3Consecutive"] = entry.best3Consecutive;
+    doc["best3Race"] = entry.best3Race;
+    doc["lastRace"] = entry.lastRace;
+    doc["meanLap"] = (uint32_t)(entry.mean + 0.5);
+    doc["stdDev"] = entry.laps > 1 ? (uint32_t)(sqrt(entry.m2 / (entry.laps - 1)) + 0.5) : 0;
+    doc["p50"] = percentile(entry, 0.5f);
+    doc["p90"] = percentile(entry, 0.9f);
+    serializeJson(doc, out);
+}
+
+void Leaderboard::persist() {
+    if (!storage) {
+        return;
+    }
+    // Snapshot for the storage task; queued writes coalesce into one
+    std::shared_ptr<std::vector<uint8_t>> image =
+        std::make_shared<std::vector<uint8_t>>(2 * sizeof(uint32_t) + entries.size() * sizeof(leaderboard_entry_t));
+    uint32_t header[2] = {LEADERBOARD_MAGIC, (uint32_t)entries.size()};
+    memcpy(image->data(), header, sizeof(header));
+    if (!entries.empty()) {
+        memcpy(image->data() + sizeof(header), entries.data(), entries.size() * sizeof(leaderboard_entry_t));
+    }
+    storage->writeStreamAsync(LEADERBOARD_PATH, [image](Print& file) {
+        return file.write(image->data(), image->size()) == image->size();
+    });
+}
@@ -0,0 +1,92 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+/**
+ * Pilot/track leaderboard aggregates
+ *
+ * One entry per (pilot, track) with personal bests and lap statistics,
+ * updated as races are saved, edited and deleted, so leaderboards don't
+ * need every race transferred and walked on the client.
+ *
+ * - Mean and variance via Welford's algorithm, which also runs backwards
+ *   when a race is removed.
+ * - Percentiles from a log-scale lap histogram (each bucket 10% wider than
+ *   the last), accurate to within a bucket. Laps past the last regular
+ *   bucket land in an overflow bucket and report its lower edge.
+ * - Bests can't be undone incrementally; removing the race that held one
+ *   rescans the races still in history for that pilot and track.
+ * - Persisted next to the races so bests survive races dropping out of the
+ *   in-memory history.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <vector>
+
+#include "storage.h"
+
+struct RaceSession;
+
+#define LEADERBOARD_PATH "/races/leaderboard.dat"
+#define LEADERBOARD_MAGIC 0x3252424C  // "LBR2", bumped when the entry layout changes
+#define LEADERBOARD_MAX_ENTRIES 64
+#define LEADERBOARD_PILOT_LEN 32
+#define LEADERBOARD_TRACK_LEN 32
+#define LEADERBOARD_BUCKETS 64             // 63 log-scale buckets plus the overflow bucket
+#define LEADERBOARD_OVERFLOW_BUCKET (LEADERBOARD_BUCKETS - 1)
+#define LEADERBOARD_BUCKET_BASE_MS 1000   // Bucket 0 is everything below 1.1 s
+#define LEADERBOARD_BUCKET_RATIO 1.1f     // Overflow bucket starts around 405 s
+
+typedef struct {
+    char pilot[LEADERBOARD_PILOT_LEN];
+    char trackName[LEADERBOARD_TRACK_LEN];
+    uint32_t trackId;
+    uint32_t races;
+    uint32_t laps;
+    uint32_t bestLap;
+    uint32_t bestLapRace;       // Timestamp of the race that set it
+    uint32_t best3Consecutive;
+    uint32_t best3Race;
+    uint32_t lastRace;
+    double mean;                // Welford running mean of lap times (ms)
+    double m2;                  // Welford sum of squared deviations
+    uint16_t histogram[LEADERBOARD_BUCKETS];
+} leaderboard_entry_t;
+
+class Leaderboard {
+   public:
+    Leaderboard();
+    void init(Storage* storage);
+
+    // Persisted aggregates, or rebuilt from races if there are none
+    void load(const std::vector<RaceSession>& races);
+    void addRace(const RaceSession& race);
+    // remaining: races left in history, used to find the next best
+    void removeRace(const RaceSession& race, const std::vector<RaceSession>& remaining);
+    void clear();
+
+    // {"entries":[...]} fastest first; empty pilot / zero trackId match all
+    void toJson(Print& out, const String& pilot = "", uint32_t trackId = 0);
+    // Copy of the entries toJson() would list, for rendering one at a time
+    void getEntries(std::vector<leaderboard_entry_t>& out, const String& pilot = "", uint32_t trackId = 0);
+    static void entryToJson(const leaderboard_entry_t& entry, Print& out);
+
+    static String pilotKey(const RaceSession& race);
+
+   private:
+    Storage* storage;
+    SemaphoreHandle_t mutex;
+    std::vector<leaderboard_entry_t> entries;
+
+    leaderboard_entry_t* findEntry(const String& pilot, uint32_t trackId, bool create);
+    void applyRace(const RaceSession& race);
+    void rescanBests(leaderboard_entry_t& entry, const std::vector<RaceSession>& races);
+    static uint32_t percentile(const leaderboard_entry_t& entry, float p);
+    static uint8_t bucketFor(uint32_t lapMs);
+    static float bucketStart(uint8_t bucket);
+    void persist();  // Caller holds the mutex
+};
+
+#endif  // LEADERBOARD_H
@@ -0,0 +1,220 @@
+#include "multinode.h"
+
+#include <Arduino.h>
+
+#include "debug.h"
+#include "racerecorder.h"
+#include "rssipipeline.h"
+
+MultiNode::MultiNode()
+    : conf(nullptr), recorder(nullptr), rx(nullptr), count(0), hopNodes(0), hopAllocated(0), hopWindowStartMs(0),
+      running(false), runningStartMs(0), lapHead(0), lapTail(0) {
+    for (uint8_t i = 0; i < MULTINODE_EXTRA; i++) {
+        receivers[i] = nullptr;
+        reported[i] = 0;
+    }
+    for (uint8_t i = 0; i < RX5808_MAX_HOPS; i++) {
+        hopSamples[i] = 0;
+        hopRateHz[i] = 0;
+    }
+}
+
+void MultiNode::init(Config* config, RaceRecorder* raceRecorder, RX5808* rx5808) {
+    conf = config;
+    recorder = raceRecorder;
+    rx = rx5808;
+#if RX_NODE_COUNT > 1
+    static const uint8_t rssiPins[] = PIN_RX5808_NODE_RSSI;
+    static const uint8_t selectPins[] = PIN_RX5808_NODE_SELECT;
+    for (uint8_t i = 0; i < RX_NODE_COUNT - 1; i++) {
+        if (!detectors[i].init()) {
+            DEBUG("MultiNode: no memory for node %u laps\n", i + 1);
+            break;
+        }
+        receivers[i] = new RX5808(rssiPins[i], PIN_RX5808_DATA, selectPins[i], PIN_RX5808_CLOCK);
+        receivers[i]->init();
+        configureNode(i);
+        count++;
+    }
+    DEBUG("MultiNode: %u receivers\n", 1 + count);
+#endif
+}
+
+void MultiNode::configureNode(uint8_t index) {
+    // Same detection as node 0, with the node's own thresholds
+    lap_detector_config_t config;
+    config.enterRssi = conf->getNodeEnterRssi(index + 1);
+    config.exitRssi = conf->getNodeExitRssi(index + 1);
+    config.smoothing = 3;
+    config.peakMargin = 5;
+    config.minLapMs = conf->getMinLapMs();
+    config.filterQ = RSSI_FILTER_Q;
+    config.filterR = RSSI_FILTER_R;
+    detectors[index].configure(config);
+}
+
+void MultiNode::startRace(uint32_t raceStartMs, uint8_t active) {
+    for (uint8_t i = 0; i < active; i++) {
+        configureNode(i);
+        detectors[i].start(raceStartMs);
+        reported[i] = 0;
+    }
+    running = true;
+    runningStartMs = raceStartMs;
+}
+
+void MultiNode::scan(uint32_t currentTimeMs, bool raceActive, uint32_t raceStartMs) {
+    uint8_t active = count > 0 ? count : hopNodes;
+    if (active == 0) return;
+
+    // Follow the LapTimer; a restart between two scans shows up as a new start time
+    if (raceActive && (!running || raceStartMs != runningStartMs)) {
+        startRace(raceStartMs, active);
+    } else if (!raceActive && running) {
+        for (uint8_t i = 0; i < active; i++) {
+            detectors[i].stop();
+        }
+        running = false;
+    }
+
+    if (count > 0) {
+        // All ADC reads first, so the nodes are sampled as close together as possible
+        uint8_t raw[MULTINODE_EXTRA];
+        for (uint8_t i = 0; i < count; i++) {
+            raw[i] = receivers[i]->readRssi();
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            detectors[i].process(raw[i], currentTimeMs, running);
+        }
+    } else {
+        sampleHop(currentTimeMs, active);
+    }
+
+    for (uint8_t i = 0; i < active; i++) {
+        const LapLog& laps = detectors[i].getLaps();
+        while (running && reported[i] < laps.size()) {
+            uint32_t lapTimeMs = laps[reported[i]].lapTimeMs;
+            reported[i]++;
+            if (recorder) {
+                recorder->logNodeLap(i + 1, lapTimeMs);
+            }
+            uint8_t next = (lapHead + 1) % MULTINODE_LAP_QUEUE;
+            if (next == lapTail) {
+                DEBUG("MultiNode: lap queue full, node %u lap not broadcast\n", i + 1);
+                continue;
+            }
+            lapQueue[lapHead].node = i + 1;
+            lapQueue[lapHead].lapTimeMs = lapTimeMs;
+            lapHead = next;
+        }
+    }
+}
+
+void MultiNode::sampleHop(uint32_t currentTimeMs, uint8_t active) {
+    // Slot 0 is the LapTimer's; it takes its own samples
+    uint8_t slot;
+    uint8_t raw;
+    if (rx->isHopping() && rx->readHopSample(slot, raw) && slot < RX5808_MAX_HOPS) {
+        hopSamples[slot]++;
+        if (slot > 0 && slot <= active) {
+            detectors[slot - 1].process(raw, currentTimeMs, running);
+        }
+    }
+
+    uint32_t elapsed = currentTimeMs - hopWindowStartMs;
+    if (elapsed >= MULTINODE_RATE_WINDOW_MS) {
+        for (uint8_t i = 0; i < RX5808_MAX_HOPS; i++) {
+            hopRateHz[i] = hopSamples[i] * 1000 / elapsed;
+            hopSamples[i] = 0;
+        }
+        hopWindowStartMs = currentTimeMs;
+    }
+}
+
+bool MultiNode::popLap(uint8_t& node, uint32_t& lapTimeMs) {
+    if (lapTail == lapHead) {
+        return false;
+    }
+    node = lapQueue[lapTail].node;
+    lapTimeMs = lapQueue[lapTail].lapTimeMs;
+    lapTail = (lapTail + 1) % MULTINODE_LAP_QUEUE;
+    return true;
+}
+
+void MultiNode::handleFrequencyChange(uint32_t currentTimeMs, bool raceActive) {
+    if (count == 0) {
+        updateHopPlan(raceActive);
+        return;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        receivers[i]->handleFrequencyChange(currentTimeMs, conf->getNodeFrequency(i + 1));
+    }
+}
+
+void MultiNode::updateHopPlan(bool raceActive) {
+    // The LapTimer's state, not running: scan() leaves that alone while
+    // there are no extra pilots, so it is false in a single-pilot race
+    if (!rx || raceActive) {
+        return;  // The plan only changes between races
+    }
+
+    uint8_t pilots = conf->getHopPilots();
+    if (pilots > RX5808_MAX_HOPS) pilots = RX5808_MAX_HOPS;
+    if (pilots < 2) {
+        hopNodes = 0;
+        rx->setHopPlan(nullptr, 0, 0);
+        return;
+    }
+
+    // Lap logs for the virtual nodes on first use, so units that never hop spend no RAM on them
+    while (hopAllocated < pilots - 1) {
+        if (!detectors[hopAllocated].init()) {
+            DEBUG("MultiNode: no memory for hopping pilot %u\n", hopAllocated + 1);
+            break;
+        }
+        configureNode(hopAllocated);
+        hopAllocated++;
+    }
+    if (hopAllocated < pilots - 1) {
+        pilots = hopAllocated + 1;
+        if (pilots < 2) return;
+    }
+
+    uint16_t plan[RX5808_MAX_HOPS];
+    plan[0] = conf->getFrequency();
+    for (uint8_t i = 1; i < pilots; i++) {
+        plan[i] = conf->getNodeFrequency(i);
+    }
+    rx->setHopPlan(plan, pilots, conf->getHopDwellMs());
+    hopNodes = pilots - 1;
+}
+
+bool MultiNode::getHopStats(hop_stats_t& stats) const {
+    if (!rx || hopNodes == 0) {
+        return false;
+    }
+    stats.pilots = rx->getHopCount();
+    stats.dwellMs = rx->getHopDwellMs();
+    stats.cycleMs = rx->getHopCycleMs();
+    uint32_t perHop = stats.pilots > 0 ? stats.cycleMs / stats.pilots : 0;
+    stats.settleMs = perHop > stats.dwellMs ? perHop - stats.dwellMs : 0;
+    stats.uncertaintyMs = stats.cycleMs > stats.dwellMs ? stats.cycleMs - stats.dwellMs : 0;
+    stats.writeUs = rx->getHopWriteUs();
+    uint32_t busyPct = stats.cycleMs > 0 ? stats.writeUs * stats.pilots / (stats.cycleMs * 10) : 0;
+    stats.serviceBusyPct = busyPct > 100 ? 100 : busyPct;
+    stats.spiDriver = rx->usesSpi();
+    for (uint8_t i = 0; i < RX5808_MAX_HOPS; i++) {
+        stats.sampleRateHz[i] = i < stats.pilots ? hopRateHz[i] : 0;
+    }
+    return true;
+}
+
+uint8_t MultiNode::getRssi(uint8_t node) const {
+    if (node < 1 || node >= getNodeCount()) return 0;
+    return detectors[node - 1].getRssi();
+}
+
+const LapLog* MultiNode::getLaps(uint8_t node) const {
+    if (node < 1 || node >= getNodeCount()) return nullptr;
+    return &detectors[node - 1].getLaps();
+}
@@ -0,0 +1,117 @@
+#ifndef MULTINODE_H
+#define MULTINODE_H
+
+/**
+ * Extra receiver nodes
+ *
+ * Node 0 is the RX5808 the LapTimer owns, with everything that goes with
+ * it (buzzer, LEDs, webhooks, journal). Nodes 1 to RX_NODE_COUNT - 1 are
+ * further RX5808 modules on the same DATA and CLOCK lines with their own
+ * SELECT pin and ADC channel, one pilot each.
+ *
+ * scan() runs in the timing loop straight after the LapTimer sample and
+ * reads every extra node back to back, so all nodes are sampled at the
+ * same rate. Each node has its own filter and peak detector (a
+ * LapDetector), frequency and thresholds, and follows the LapTimer's race
+ * start and stop. Laps are posted to the RaceRecorder with their node
+ * index and queued for popLap(), which the loop broadcasts to the
+ * transports.
+ *
+ * Frequencies are programmed from the service core, like node 0.
+ *
+ * A unit with a single receiver can instead time up to RX5808_MAX_HOPS
+ * pilots by frequency hopping (config hopPilots): the receiver cycles
+ * through node 0's frequency and those of nodes 1 to hopPilots - 1, and
+ * every sample goes to the pilot whose frequency it was taken on - node 0
+ * to the LapTimer, the others to virtual nodes here that behave like
+ * extra receivers. Each pilot is only observed for dwell ms per cycle, so
+ * a peak can be missed by up to cycle - dwell; getHopStats() reports that
+ * together with the sample rate each pilot actually gets.
+ *
+ * Hopping is not free on the service core: with the bit-banged driver
+ * every hop is a blocking register write of about 25 ms, followed by the
+ * 35 ms tune time, so at short dwells the service core spends most of its
+ * time retuning. getHopStats() reports the measured write time and the
+ * share of the service core it takes; the SPI driver queues the write and
+ * costs next to nothing.
+ */
+
+#include <stdint.h>
+
+#include "RX5808.h"
+#include "config.h"
+#include "lapdetector.h"
+
+class RaceRecorder;
+
+#define MULTINODE_EXTRA CONFIG_EXTRA_NODES  // Receivers or hopping pilots beyond node 0
+#define MULTINODE_LAP_QUEUE 16  // Laps waiting to be broadcast
+#define MULTINODE_RATE_WINDOW_MS 1000
+
+typedef struct {
+    uint8_t pilots;
+    uint16_t dwellMs;
+    uint32_t cycleMs;        // One pass over every pilot
+    uint32_t settleMs;       // Retune overhead per hop, write plus tune time
+    uint32_t uncertaintyMs;  // Longest a pilot goes unobserved, cycle minus dwell
+    uint32_t writeUs;        // Service core blocked per hop by the register write
+    uint8_t serviceBusyPct;  // Share of the service core spent in hop writes
+    bool spiDriver;          // false: bit-banged, writes block
+    uint16_t sampleRateHz[RX5808_MAX_HOPS];
+} hop_stats_t;
+
+class MultiNode {
+   public:
+    MultiNode();
+    void init(Config* config, RaceRecorder* raceRecorder, RX5808* rx5808);
+
+    uint8_t getNodeCount() const { return 1 + (count > 0 ? count : hopNodes); }
+    bool isHopping() const { return hopNodes > 0; }
+    bool getHopStats(hop_stats_t& stats) const;
+
+    // Timing loop
+    void scan(uint32_t currentTimeMs, bool raceActive, uint32_t raceStartMs);
+    bool popLap(uint8_t& node, uint32_t& lapTimeMs);
+
+    // Service core. The hop plan only changes while no race is running.
+    void handleFrequencyChange(uint32_t currentTimeMs, bool raceActive);
+
+    // Node 1 to getNodeCount() - 1
+    uint8_t getRssi(uint8_t node) const;
+    const LapLog* getLaps(uint8_t node) const;
+
+   private:
+    typedef struct {
+        uint8_t node;
+        uint32_t lapTimeMs;
+    } node_lap_t;
+
+    Config* conf;
+    RaceRecorder* recorder;
+    RX5808* rx;  // Node 0, hopped when there are no extra receivers
+    RX5808* receivers[MULTINODE_EXTRA];
+    LapDetector detectors[MULTINODE_EXTRA];
+    uint32_t reported[MULTINODE_EXTRA];  // Laps already posted, per node
+    uint8_t count;
+
+    // Frequency hopping
+    volatile uint8_t hopNodes;  // Virtual nodes, hopPilots - 1
+    uint8_t hopAllocated;       // Detectors with a lap log
+    uint32_t hopSamples[RX5808_MAX_HOPS];
+    uint16_t hopRateHz[RX5808_MAX_HOPS];
+    uint32_t hopWindowStartMs;
+
+    volatile bool running;
+    uint32_t runningStartMs;
+
+    node_lap_t lapQueue[MULTINODE_LAP_QUEUE];
+    uint8_t lapHead;
+    uint8_t lapTail;
+
+    void startRace(uint32_t raceStartMs, uint8_t active);
+    void configureNode(uint8_t index);
+    void updateHopPlan(bool raceActive);
+    void sampleHop(uint32_t currentTimeMs, uint8_t active);
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "passtrace.h"
+
+#include "debug.h"
+#include "varint.h"
+
+PassTraceLog::PassTraceLog()
+    : arena(nullptr), traces(nullptr), arenaSize(0), maxTraces(0), used(0), count(0), dropped(0),
+      generation(0), ringHead(0), ringCount(0), lastSampleMs(0), pending(false), postRemaining(0) {
+}
+
+bool PassTraceLog::init() {
+    if (arena) return true;
+
+#ifdef BOARD_HAS_PSRAM
+    if (psramFound()) {
+        arena = (uint8_t*)ps_malloc(PASSTRACE_ARENA_PSRAM);
+        traces = (pass_trace_t*)ps_malloc(PASSTRACE_MAX_PSRAM * sizeof(pass_trace_t));
+        if (arena && traces) {
+            arenaSize = PASSTRACE_ARENA_PSRAM;
+            maxTraces = PASSTRACE_MAX_PSRAM;
+        } else {
+            free(arena);
+            free(traces);
+            arena = nullptr;
+            traces = nullptr;
+        }
+    }
+#endif
+    if (!arena) {
+        arena = (uint8_t*)malloc(PASSTRACE_ARENA);
+        traces = (pass_trace_t*)malloc(PASSTRACE_MAX * sizeof(pass_trace_t));
+        if (!arena || !traces) {
+            free(arena);
+            free(traces);
+            arena = nullptr;
+            traces = nullptr;
+            DEBUG("PassTraceLog: failed to allocate arena\n");
+            return false;
+        }
+        arenaSize = PASSTRACE_ARENA;
+        maxTraces = PASSTRACE_MAX;
+    }
+
+    DEBUG("PassTraceLog: %u traces, %u bytes\n", maxTraces, arenaSize);
+    clear();
+    return true;
+}
+
+void PassTraceLog::clear() {
+    generation.fetch_add(1);  // Before any slot can be reused
+    count = 0;
+    used = 0;
+    dropped = 0;
+    ringHead = 0;
+    ringCount = 0;
+    lastSampleMs = 0;
+    pending = false;
+}
+
+void PassTraceLog::sample(uint8_t raw, uint8_t filtered, uint32_t nowMs) {
+    if (ringCount > 0 && (nowMs - lastSampleMs) < PASSTRACE_INTERVAL_MS) {
+        return;
+    }
+    // Stay on the interval grid unless the loop stalled for longer
+    if (ringCount > 0 && (nowMs - lastSampleMs) < 2 * PASSTRACE_INTERVAL_MS) {
+        lastSampleMs += PASSTRACE_INTERVAL_MS;
+    } else {
+        lastSampleMs = nowMs;
+    }
+
+    ringRaw[ringHead] = raw;
+    ringFiltered[ringHead] = filtered;
+    ringHead = (ringHead + 1) % PASSTRACE_RING;
+    if (ringCount < PASSTRACE_RING) {
+        ringCount++;
+    }
+
+    if (pending && --postRemaining == 0) {
+        finalize();
+    }
+}
+
+void PassTraceLog::markPass(uint8_t outcome, uint16_t lap, uint8_t peak, uint8_t enterRssi, uint8_t exitRssi, uint32_t nowMs) {
+    if (!arena) return;
+
+    // Passes closer together than the post window share samples
+    if (pending) {
+        finalize();
+    }
+
+    pendingTrace.resolvedMs = nowMs;
+    pendingTrace.lap = lap;
+    pendingTrace.outcome = outcome;
+    pendingTrace.peak = peak;
+    pendingTrace.enterRssi = enterRssi;
+    pendingTrace.exitRssi = exitRssi;
+    pendingTrace.reserved = 0;
+    postRemaining = PASSTRACE_POST;
+    pending = true;
+}
+
+void PassTraceLog::flush() {
+    if (pending) {
+        finalize();
+    }
+}
+
+void PassTraceLog::finalize() {
+    pending = false;
+    if (ringCount == 0) return;
+
+    // Worst case is 5 bytes for each value
+    if (count >= maxTraces || used + ringCount * 10 > arenaSize) {
+        dropped++;
+        return;
+    }
+
+    pass_trace_t& trace = traces[count];
+    trace = pendingTrace;
+    trace.offset = used;
+    trace.samples = ringCount;
+    trace.firstMs = lastSampleMs - (ringCount - 1) * PASSTRACE_INTERVAL_MS;
+
+    uint8_t* out = arena + used;
+    size_t len = 0;
+    uint8_t previous = 0;
+    uint16_t slot = (ringHead + PASSTRACE_RING - ringCount) % PASSTRACE_RING;
+    for (uint16_t i = 0; i < ringCount; i++) {
+        uint8_t filtered = ringFiltered[slot];
+        len += writeVarint(out + len, zigzag((int32_t)filtered - previous));
+        len += writeVarint(out + len, zigzag((int32_t)ringRaw[slot] - filtered));
+        previous = filtered;
+        slot = (slot + 1) % PASSTRACE_RING;
+    }
+    trace.length = len;
+    used += len;
+    count = count + 1;  // Publish only after the trace is complete
+}
+
+bool PassTraceLog::copyTrace(uint32_t index, uint32_t expectedGeneration, pass_trace_t& trace,
+                             std::vector<uint8_t>& payload) const {
+    if (generation.load() != expectedGeneration || index >= count) {
+        return false;
+    }
+    trace = traces[index];
+    payload.assign(arena + trace.offset, arena + trace.offset + trace.length);
+    return generation.load() == expectedGeneration;
+}
+
+bool PassTraceLog::serialize(std::vector<uint8_t>& out) const {
+    uint32_t expectedGeneration = generation.load();
+    uint32_t n = count;
+    pass_trace_file_t header;
+    header.magic = PASSTRACE_FILE_MAGIC;
+    header.count = n;
+    header.intervalMs = PASSTRACE_INTERVAL_MS;
+    header.dropped = dropped;
+
+    // Payloads are contiguous in the arena, offsets carry over unchanged
+    uint32_t payloadBytes = n > 0 ? traces[n - 1].offset + traces[n - 1].length : 0;
+    out.resize(sizeof(header) + n * sizeof(pass_trace_t) + payloadBytes);
+    memcpy(out.data(), &header, sizeof(header));
+    if (n > 0) {
+        memcpy(out.data() + sizeof(header), traces, n * sizeof(pass_trace_t));
+        memcpy(out.data() + sizeof(header) + n * sizeof(pass_trace_t), arena, payloadBytes);
+    }
+    return generation.load() == expectedGeneration;
+}
+
+const char* PassTraceLog::outcomeName(uint8_t outcome) {
+    switch (outcome) {
+        case PASS_ACCEPTED:         return "accepted";
+        case PASS_REJECTED_MIN_LAP: return "minLap";
+        case PASS_REJECTED_WEAK:    return "weakPeak";
+        case PASS_REJECTED_TIMEOUT: return "noExit";
+        default:                    return "rejected";
+    }
+}
+
+void PassTraceLog::traceToJson(const pass_trace_t& trace, const uint8_t* payload, uint16_t intervalMs, Print& out) {
+    out.printf("{\"resolvedMs\":%u,\"firstMs\":%u,\"intervalMs\":%u,\"lap\":%u,\"outcome\":\"%s\","
+               "\"peak\":%u,\"enterRssi\":%u,\"exitRssi\":%u,",
+               trace.resolvedMs, trace.firstMs, intervalMs, trace.lap, outcomeName(trace.outcome),
+               trace.peak, trace.enterRssi, trace.exitRssi);
+
+    // Two passes over the payload, one per column
+    for (uint8_t column = 0; column < 2; column++) {
+        out.print(column == 0 ? "\"rssi\":[" : "],\"raw\":[");
+        uint16_t offset = 0;
+        int32_t filtered = 0;
+        for (uint16_t i = 0; i < trace.samples; i++) {
+            filtered += unzigzag(readVarint(payload, offset, trace.length));
+            int32_t raw = filtered + unzigzag(readVarint(payload, offset, trace.length));
+            if (i > 0) out.print(",");
+            out.print((int)(column == 0 ? filtered : raw));
+        }
+    }
+    out.print("]}");
+}
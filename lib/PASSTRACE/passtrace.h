@@ -0,0 +1,124 @@
+#ifndef PASSTRACE_H
+#define PASSTRACE_H
+
+/**
+ * RSSI traces around gate passes
+ *
+ * The timing loop feeds every sample in; one raw and one filtered value
+ * are kept every PASSTRACE_INTERVAL_MS in a short ring. When a pass
+ * candidate is resolved - accepted as a lap or rejected - the ring is
+ * left to run PASSTRACE_POST more samples and is then compressed into the
+ * arena: filtered values as zigzag varint deltas, raw values as their
+ * zigzag varint distance from the filtered one, timing implicit from the
+ * fixed interval.
+ *
+ * Like LapLog, the arena is allocated once at boot and cleared at race
+ * start; traces that don't fit are counted as dropped. The log is saved
+ * next to the race file (RaceHistory::saveTraces) in the layout below.
+ *
+ * Single writer (the timing loop); readers only access indices below
+ * size(), which is published after the trace is written. clear() bumps a
+ * generation counter first, so readers on other tasks copy a trace out
+ * with copyTrace() and find out if the log was reused under them.
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+#define PASSTRACE_INTERVAL_MS 10      // One sample per 10 ms (100 Hz)
+#define PASSTRACE_RING 200            // 2 s window around a pass
+#define PASSTRACE_POST 50             // Of which 0.5 s after it was resolved
+#define PASSTRACE_MAX_PASS_MS 5000    // Candidates above enter for longer are rejected
+#define PASSTRACE_ARENA 16384         // Compressed samples, internal RAM
+#define PASSTRACE_ARENA_PSRAM 262144  // Compressed samples with PSRAM
+#define PASSTRACE_MAX 64              // Traces per race, internal RAM
+#define PASSTRACE_MAX_PSRAM 1024      // Traces per race with PSRAM
+
+#define PASSTRACE_FILE_MAGIC 0x31525450  // "PTR1"
+
+typedef enum : uint8_t {
+    PASS_ACCEPTED,
+    PASS_REJECTED_MIN_LAP,  // Inside the minimum lap time
+    PASS_REJECTED_WEAK,     // Peak not far enough above the exit threshold
+    PASS_REJECTED_TIMEOUT,  // Never dropped below the exit threshold
+    PASS_REJECTED           // Anything else
+} pass_outcome_e;
+
+typedef struct {
+    uint32_t resolvedMs;  // millis() when the pass was accepted or rejected
+    uint32_t firstMs;     // millis() of the first sample
+    uint32_t offset;      // Payload offset in the arena (in files: after the table)
+    uint16_t samples;
+    uint16_t length;      // Payload bytes
+    uint16_t lap;         // Laps completed when the pass was resolved
+    uint8_t outcome;      // pass_outcome_e
+    uint8_t peak;
+    uint8_t enterRssi;    // Thresholds in effect
+    uint8_t exitRssi;
+    uint16_t reserved;
+} pass_trace_t;
+
+// Sidecar file: header, count x pass_trace_t, payloads
+typedef struct {
+    uint32_t magic;
+    uint16_t count;
+    uint16_t intervalMs;
+    uint32_t dropped;
+} pass_trace_file_t;
+
+class PassTraceLog {
+   public:
+    PassTraceLog();
+    bool init();
+    void clear();
+
+    // Timing loop only
+    void sample(uint8_t raw, uint8_t filtered, uint32_t nowMs);
+    void markPass(uint8_t outcome, uint16_t lap, uint8_t peak, uint8_t enterRssi, uint8_t exitRssi, uint32_t nowMs);
+    void flush();  // Stores a pending pass without waiting for its post window
+
+    uint32_t size() const { return count; }
+    uint32_t getDropped() const { return dropped; }
+    const pass_trace_t& operator[](uint32_t index) const { return traces[index]; }
+    const uint8_t* payload(const pass_trace_t& trace) const { return arena + trace.offset; }
+
+    // Other tasks: copy out trace index of the given generation; false once
+    // it is gone (past size(), or the log was cleared meanwhile)
+    uint32_t getGeneration() const { return generation.load(); }
+    bool copyTrace(uint32_t index, uint32_t expectedGeneration, pass_trace_t& trace, std::vector<uint8_t>& payload) const;
+
+    // Sidecar file contents for the traces recorded so far; false if the
+    // log was cleared while copying
+    bool serialize(std::vector<uint8_t>& out) const;
+
+    static void traceToJson(const pass_trace_t& trace, const uint8_t* payload, uint16_t intervalMs, Print& out);
+    static const char* outcomeName(uint8_t outcome);
+
+   private:
+    uint8_t* arena;
+    pass_trace_t* traces;
+    uint32_t arenaSize;
+    uint32_t maxTraces;
+    uint32_t used;
+    volatile uint32_t count;
+    uint32_t dropped;
+    std::atomic<uint32_t> generation;  // Bumped by clear()
+
+    uint8_t ringRaw[PASSTRACE_RING];
+    uint8_t ringFiltered[PASSTRACE_RING];
+    uint16_t ringHead;   // Next slot to write
+    uint16_t ringCount;
+    uint32_t lastSampleMs;
+
+    bool pending;        // A resolved pass waiting for its post window
+    uint16_t postRemaining;
+    pass_trace_t pendingTrace;
+
+    void finalize();
+};
+
+#endif
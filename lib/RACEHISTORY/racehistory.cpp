@@ -1,13 +1,34 @@
 #include "racehistory.h"
 #include <algorithm>
+#include <memory>
 #include <time.h>
 #include "debug.h"
+#include "rssirecorder.h"
 
-RaceHistory::RaceHistory() : storage(nullptr) {
+// Holds the history mutex for the rest of the scope
+class HistoryLock {
+   public:
+    explicit HistoryLock(SemaphoreHandle_t m) : mutex(m) {
+        if (mutex) xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    }
+    ~HistoryLock() {
+        if (mutex) xSemaphoreGiveRecursive(mutex);
+    }
+
+   private:
+    SemaphoreHandle_t mutex;
+};
+
+RaceHistory::RaceHistory() : storage(nullptr), changeLog(nullptr), mutex(NULL), editStatsRace(0) {
 }
 
-bool RaceHistory::init(Storage* storageBackend) {
+bool RaceHistory::init(Storage* storageBackend, ChangeLog* log) {
+    if (!mutex) {
+        mutex = xSemaphoreCreateRecursiveMutex();
+    }
+    HistoryLock lock(mutex);
     storage = storageBackend;
+    changeLog = log;
     if (!storage) {
         DEBUG("RaceHistory: Storage backend is null!\n");
         return false;
@@ -15,63 +36,71 @@ bool RaceHistory::init(Storage* storageBackend) {
     
     // Create races directory if it doesn't exist
     storage->mkdir("/races");
+    leaderboard.init(storage);
     
     return loadRaces();
 }
 
 bool RaceHistory::saveRace(const RaceSession& race) {
-    // Generate filename from timestamp: DDMMYY-HrMinSec.json
-    time_t timestamp = race.timestamp;
-    struct tm timeinfo;
-    localtime_r(&timestamp, &timeinfo);
-    
-    char filename[32];
-    strftime(filename, sizeof(filename), "%d%m%y-%H%M%S.json", &timeinfo);
-    String filepath = String(RACES_DIR) + "/" + String(filename);
-    
-    // Create JSON for single race
-    DynamicJsonDocument doc(16384);
-    JsonObject raceObj = doc.to<JsonObject>();
-    raceObj["timestamp"] = race.timestamp;
-    raceObj["fastestLap"] = race.fastestLap;
-    raceObj["medianLap"] = race.medianLap;
-    raceObj["best3LapsTotal"] = race.best3LapsTotal;
-    raceObj["name"] = race.name;
-    raceObj["tag"] = race.tag;
-    raceObj["pilotName"] = race.pilotName;
-    raceObj["pilotCallsign"] = race.pilotCallsign;
-    raceObj["frequency"] = race.frequency;
-    raceObj["band"] = race.band;
-    raceObj["channel"] = race.channel;
-    raceObj["trackId"] = race.trackId;
-    raceObj["trackName"] = race.trackName;
-    raceObj["totalDistance"] = race.totalDistance;
-    
-    JsonArray lapsArray = raceObj.createNestedArray("lapTimes");
-    for (uint32_t lap : race.lapTimes) {
-        lapsArray.add(lap);
+    HistoryLock lock(mutex);
+    addRace(race);
+    trimToMax();
+    return true;
+}
+
+void RaceHistory::addRace(const RaceSession& race) {
+    DEBUG("Saving race %u: totalDistance=%.2f\n", race.timestamp, race.totalDistance);
+    
+    // Written in the background; the in-memory list is updated right away
+    String filepath = racePath(race.timestamp);
+    writeRaceFile(race, [filepath](bool success) {
+        if (!success) {
+            DEBUG("Failed to save race to %s\n", filepath.c_str());
+        }
+    });
+    
+    // Saving a race again replaces it, in the list and the aggregates
+    if (hasRace(race.timestamp)) {
+        auto it = std::find_if(races.begin(), races.end(),
+            [&race](const RaceSession& r) { return r.timestamp == race.timestamp; });
+        if (it != races.end()) {
+            RaceSession previous = *it;
+            races.erase(it);
+            leaderboard.removeRace(previous, races);
+        }
+        if (editStatsRace == race.timestamp) {
+            editStatsRace = 0;
+        }
     }
     
-    String json;
-    serializeJson(doc, json);
-    
-    DEBUG("Saving race JSON: totalDistance=%.2f\n", race.totalDistance);
-    DEBUG("JSON content: %s\n", json.c_str());
-    
-    bool success = storage->writeFile(filepath, json);
-    if (success) {
-        DEBUG("Saved race to %s (%d bytes)\n", filepath.c_str(), json.length());
-        
-        // Add to in-memory list
-        races.insert(races.begin(), race);
-        if (races.size() > MAX_RACES) {
-            races.resize(MAX_RACES);
+    // Add to in-memory list
+    races.insert(races.begin(), race);
+    raceIndex.insert(race.timestamp);
+    leaderboard.addRace(race);
+    logChange(CHANGE_UPSERT, race.timestamp);
+}
+
+void RaceHistory::trimToMax() {
+    // Races past the limit are deleted, files included, so they don't come
+    // back on the next load; clients see them as deleted
+    while (races.size() > MAX_RACES) {
+        uint32_t timestamp = races.back().timestamp;
+        deleteRaceFiles(timestamp);
+        RaceSession removed = races.back();
+        races.pop_back();
+        raceIndex.erase(timestamp);
+        leaderboard.removeRace(removed, races);
+        if (editStatsRace == timestamp) {
+            editStatsRace = 0;
         }
-    } else {
-        DEBUG("Failed to save race to %s\n", filepath.c_str());
+        logChange(CHANGE_DELETE, timestamp);
+    }
+}
+
+void RaceHistory::logChange(uint8_t op, uint32_t timestamp) {
+    if (changeLog) {
+        changeLog->record(CHANGE_RACE, op, timestamp);
     }
-    
-    return success;
 }
 
 bool RaceHistory::loadRaces() {
@@ -80,14 +109,14 @@ bool RaceHistory::loadRaces() {
         return false;
     }
     
-    races.clear();
+    // Land queued writes first so the directory listing is current. Files
+    // are parsed without the lock and the list swapped in at the end.
+    storage->flush();
+    std::vector<RaceSession> loaded;
     
     // List all JSON files in races directory
     std::vector<String> files;
-    if (!storage->listDir(RACES_DIR, files)) {
-        DEBUG("Races directory does not exist or is empty\n");
-        return true;
-    }
+    storage->listDir(RACES_DIR, files);
     
     // Load each race file
     for (const String& filename : files) {
@@ -96,81 +125,82 @@ bool RaceHistory::loadRaces() {
         }
         
         String filepath = String(RACES_DIR) + "/" + filename;
-        String json;
-        if (!storage->readFile(filepath, json)) {
+        File file = storage->openFile(filepath, "r");
+        if (!file) {
             DEBUG("Failed to read %s\n", filepath.c_str());
             continue;
         }
         
+        // Parse straight from the file, a chunk at a time
         DynamicJsonDocument doc(16384);
-        DeserializationError error = deserializeJson(doc, json);
+        FileReadStream in(file);
+        DeserializationError error = deserializeJson(doc, in);
+        file.close();
         if (error) {
             DEBUG("Failed to parse %s: %s\n", filepath.c_str(), error.c_str());
             continue;
         }
         
         RaceSession race;
-        race.timestamp = doc["timestamp"];
-        race.fastestLap = doc["fastestLap"];
-        race.medianLap = doc["medianLap"];
-        race.best3LapsTotal = doc["best3LapsTotal"];
-        race.name = doc["name"] | "";
-        race.tag = doc["tag"] | "";
-        race.pilotName = doc["pilotName"] | "";
-        race.pilotCallsign = doc["pilotCallsign"] | "";
-        race.frequency = doc["frequency"] | 0;
-        race.band = doc["band"] | "";
-        race.channel = doc["channel"] | 0;
-        race.trackId = doc["trackId"] | 0;
-        race.trackName = doc["trackName"] | "";
-        race.totalDistance = doc["totalDistance"] | 0.0f;
-        
-        JsonArray lapsArray = doc["lapTimes"];
-        for (uint32_t lap : lapsArray) {
-            race.lapTimes.push_back(lap);
-        }
+        raceFromJson(doc.as<JsonObject>(), race);
         
-        races.push_back(race);
+        loaded.push_back(race);
     }
     
     // Sort by timestamp (newest first)
-    std::sort(races.begin(), races.end(), 
+    std::sort(loaded.begin(), loaded.end(), 
         [](const RaceSession& a, const RaceSession& b) { return a.timestamp > b.timestamp; });
     
     // Keep only MAX_RACES
-    if (races.size() > MAX_RACES) {
-        races.resize(MAX_RACES);
+    if (loaded.size() > MAX_RACES) {
+        loaded.resize(MAX_RACES);
     }
     
+    HistoryLock lock(mutex);
+    races.swap(loaded);
+    raceIndex.clear();
+    editStatsRace = 0;
+    for (const auto& race : races) {
+        raceIndex.insert(race.timestamp);
+    }
+    leaderboard.load(races);
+    
     DEBUG("Loaded %d races from individual files\n", races.size());
     return true;
 }
 
+void RaceHistory::deleteRaceFiles(uint32_t timestamp) {
+    // The race, its pass traces and its raw RSSI recording (SD only)
+    storage->deleteFileAsync(racePath(timestamp));
+    storage->deleteFileAsync(tracePath(timestamp));
+    storage->deleteFileAsync(RssiRecorder::recordingPath(timestamp));
+}
+
 bool RaceHistory::deleteRace(uint32_t timestamp) {
-    // Find and delete the file
-    time_t ts = timestamp;
-    struct tm timeinfo;
-    localtime_r(&ts, &timeinfo);
-    
-    char filename[32];
-    strftime(filename, sizeof(filename), "%d%m%y-%H%M%S.json", &timeinfo);
-    String filepath = String(RACES_DIR) + "/" + String(filename);
-    
-    bool fileDeleted = storage->deleteFile(filepath);
+    HistoryLock lock(mutex);
+    deleteRaceFiles(timestamp);
     
     // Remove from in-memory list
-    auto it = std::remove_if(races.begin(), races.end(),
+    auto it = std::find_if(races.begin(), races.end(),
         [timestamp](const RaceSession& r) { return r.timestamp == timestamp; });
     
     if (it != races.end()) {
-        races.erase(it, races.end());
-        return fileDeleted;
+        RaceSession removed = *it;
+        races.erase(it);
+        if (editStatsRace == timestamp) {
+            editStatsRace = 0;
+        }
+        raceIndex.erase(timestamp);
+        leaderboard.removeRace(removed, races);
+        logChange(CHANGE_DELETE, timestamp);
+        return true;
     }
     
     return false;
 }
 
 bool RaceHistory::updateRace(uint32_t timestamp, const String& name, const String& tag, float totalDistance) {
+    HistoryLock lock(mutex);
     // Update in-memory race
     RaceSession* targetRace = nullptr;
     for (auto& race : races) {
@@ -190,41 +220,9 @@ bool RaceHistory::updateRace(uint32_t timestamp, const String& name, const Strin
     }
     
     // Regenerate file with updated data
-    time_t ts = timestamp;
-    struct tm timeinfo;
-    localtime_r(&ts, &timeinfo);
-    
-    char filename[32];
-    strftime(filename, sizeof(filename), "%d%m%y-%H%M%S.json", &timeinfo);
-    String filepath = String(RACES_DIR) + "/" + String(filename);
-    
-    // Create JSON
-    DynamicJsonDocument doc(16384);
-    JsonObject raceObj = doc.to<JsonObject>();
-    raceObj["timestamp"] = targetRace->timestamp;
-    raceObj["fastestLap"] = targetRace->fastestLap;
-    raceObj["medianLap"] = targetRace->medianLap;
-    raceObj["best3LapsTotal"] = targetRace->best3LapsTotal;
-    raceObj["name"] = targetRace->name;
-    raceObj["tag"] = targetRace->tag;
-    raceObj["pilotName"] = targetRace->pilotName;
-    raceObj["pilotCallsign"] = targetRace->pilotCallsign;
-    raceObj["frequency"] = targetRace->frequency;
-    raceObj["band"] = targetRace->band;
-    raceObj["channel"] = targetRace->channel;
-    raceObj["trackId"] = targetRace->trackId;
-    raceObj["trackName"] = targetRace->trackName;
-    raceObj["totalDistance"] = targetRace->totalDistance;
-    
-    JsonArray lapsArray = raceObj.createNestedArray("lapTimes");
-    for (uint32_t lap : targetRace->lapTimes) {
-        lapsArray.add(lap);
-    }
-    
-    String json;
-    serializeJson(doc, json);
-    
-    return storage->writeFile(filepath, json);
+    writeRaceFile(*targetRace);
+    logChange(CHANGE_UPSERT, timestamp);
+    return true;
 }
 
 bool RaceHistory::updateLaps(uint32_t timestamp, const std::vector<uint32_t>& newLapTimes) {
@@ -235,6 +233,7 @@ bool RaceHistory::updateLaps(uint32_t timestamp, const std::vector<uint32_t>& ne
     }
     
     // Find the race in memory
+    HistoryLock lock(mutex);
     RaceSession* targetRace = nullptr;
     for (auto& race : races) {
         if (race.timestamp == timestamp) {
@@ -248,121 +247,472 @@ bool RaceHistory::updateLaps(uint32_t timestamp, const std::vector<uint32_t>& ne
         return false;
     }
     
-    // Update lap times
+    // Update lap times and recalculate statistics
+    RaceSession previous = *targetRace;
     targetRace->lapTimes = newLapTimes;
+    computeStats(*targetRace);
+    if (editStatsRace == timestamp) {
+        editStatsRace = 0;
+    }
+    leaderboard.removeRace(previous, races);
+    leaderboard.addRace(*targetRace);
+    
+    // Write updated race to file
+    writeRaceFile(*targetRace, [timestamp](bool success) {
+        if (success) {
+            DEBUG("Updated laps for race %u\n", timestamp);
+        }
+    });
+    logChange(CHANGE_UPSERT, timestamp);
+    return true;
+}
+
+bool RaceHistory::findRace(uint32_t timestamp, RaceSession& race) const {
+    HistoryLock lock(mutex);
+    for (const auto& existing : races) {
+        if (existing.timestamp == timestamp) {
+            race = existing;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RaceHistory::getRaceBefore(uint32_t before, RaceSession& race) const {
+    // The list is newest first, but a race saved again can be out of
+    // order, so look at all of them
+    HistoryLock lock(mutex);
+    const RaceSession* newest = nullptr;
+    for (const auto& existing : races) {
+        if (existing.timestamp < before && (!newest || existing.timestamp > newest->timestamp)) {
+            newest = &existing;
+        }
+    }
+    if (!newest) {
+        return false;
+    }
+    race = *newest;
+    return true;
+}
+
+size_t RaceHistory::getRaceCount() const {
+    HistoryLock lock(mutex);
+    return races.size();
+}
+
+bool RaceHistory::hasRace(uint32_t timestamp) const {
+    HistoryLock lock(mutex);
+    return raceIndex.count(timestamp) > 0;
+}
+
+bool RaceHistory::parseLapEditOp(const String& name, uint8_t& op) {
+    static const char* const names[] = {"set", "delete", "insert", "split", "merge"};
+    for (uint8_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (name == names[i]) {
+            op = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RaceHistory::lapEditsFromJson(JsonArray editsArray, std::vector<lap_edit_t>& edits) {
+    edits.clear();
+    if (editsArray.isNull() || editsArray.size() > RACEHISTORY_MAX_LAP_EDITS) {
+        return false;
+    }
+    for (JsonObject editObj : editsArray) {
+        lap_edit_t edit;
+        if (!editObj.containsKey("index") || !parseLapEditOp(editObj["op"] | "", edit.op)) {
+            return false;
+        }
+        edit.index = editObj["index"].as<uint32_t>();
+        edit.lapTime = editObj["lapTime"] | 0;
+        edits.push_back(edit);
+    }
+    return !edits.empty();
+}
+
+// Sum of the 3 laps starting at index start
+static uint32_t lapWindow(const std::vector<uint32_t>& laps, size_t start) {
+    return laps[start] + laps[start + 1] + laps[start + 2];
+}
+
+bool RaceHistory::editLap(uint32_t timestamp, uint8_t op, size_t index, uint32_t lapTime) {
+    lap_edit_t edit = {op, index, lapTime};
+    return editLaps(timestamp, std::vector<lap_edit_t>(1, edit));
+}
+
+bool RaceHistory::editLaps(uint32_t timestamp, const std::vector<lap_edit_t>& edits) {
+    HistoryLock lock(mutex);
+    RaceSession* targetRace = nullptr;
+    for (auto& race : races) {
+        if (race.timestamp == timestamp) {
+            targetRace = &race;
+            break;
+        }
+    }
+    
+    if (!targetRace) {
+        DEBUG("Race with timestamp %u not found\n", timestamp);
+        return false;
+    }
+    if (edits.empty() || edits.size() > RACEHISTORY_MAX_LAP_EDITS) {
+        return false;
+    }
+    
+    if (editStatsRace != timestamp) {
+        editStats.build(targetRace->lapTimes);
+        editStatsRace = timestamp;
+    }
+    
+    // All or nothing: the first edit that doesn't apply puts the race back
+    RaceSession previous = *targetRace;
+    LapOrderStats previousStats = editStats;
+    for (size_t i = 0; i < edits.size(); i++) {
+        if (!applyLapEdit(*targetRace, edits[i])) {
+            DEBUG("Lap edit %u of %u rejected, race %u unchanged\n", (unsigned)i + 1, (unsigned)edits.size(), timestamp);
+            *targetRace = previous;
+            editStats = previousStats;
+            return false;
+        }
+    }
+    
+    leaderboard.removeRace(previous, races);
+    leaderboard.addRace(*targetRace);
+    
+    writeRaceFile(*targetRace);
+    logChange(CHANGE_UPSERT, timestamp);
+    return true;
+}
+
+bool RaceHistory::applyLapEdit(RaceSession& race, const lap_edit_t& edit) {
+    uint8_t op = edit.op;
+    size_t index = edit.index;
+    uint32_t lapTime = edit.lapTime;
+    std::vector<uint32_t>& laps = race.lapTimes;
+    size_t count = laps.size();
+    
+    // Validate before touching anything
+    bool valid;
+    switch (op) {
+        case LAP_EDIT_SET:    valid = index < count && lapTime > 0; break;
+        case LAP_EDIT_DELETE: valid = index < count && count > 1; break;
+        case LAP_EDIT_INSERT: valid = index <= count && lapTime > 0; break;
+        case LAP_EDIT_SPLIT:  valid = index < count && lapTime > 0 && lapTime < laps[index]; break;
+        case LAP_EDIT_MERGE:  valid = index + 1 < count; break;
+        default:              valid = false; break;
+    }
+    if (!valid) {
+        DEBUG("Invalid lap edit %u at %u for race %u\n", op, (unsigned)index, race.timestamp);
+        return false;
+    }
+    
+    // Every edit only changes laps at index and index + 1, so only windows
+    // starting in [index - 2, index + 1] differ; the rest just shift
+    size_t firstWindow = index >= 2 ? index - 2 : 0;
+    bool bestWindowLost = race.best3ConsecutiveTotal == 0;
+    for (size_t s = firstWindow; s <= index + 1 && s + 2 < count; s++) {
+        if (lapWindow(laps, s) == race.best3ConsecutiveTotal) {
+            bestWindowLost = true;
+        }
+    }
+    
+    switch (op) {
+        case LAP_EDIT_SET:
+            editStats.erase(laps[index]);
+            editStats.insert(lapTime);
+            laps[index] = lapTime;
+            break;
+        case LAP_EDIT_DELETE:
+            editStats.erase(laps[index]);
+            laps.erase(laps.begin() + index);
+            break;
+        case LAP_EDIT_INSERT:
+            editStats.insert(lapTime);
+            laps.insert(laps.begin() + index, lapTime);
+            break;
+        case LAP_EDIT_SPLIT: {
+            uint32_t remainder = laps[index] - lapTime;
+            editStats.erase(laps[index]);
+            editStats.insert(lapTime);
+            editStats.insert(remainder);
+            laps[index] = lapTime;
+            laps.insert(laps.begin() + index + 1, remainder);
+            break;
+        }
+        case LAP_EDIT_MERGE:
+            editStats.erase(laps[index]);
+            editStats.erase(laps[index + 1]);
+            laps[index] += laps[index + 1];
+            editStats.insert(laps[index]);
+            laps.erase(laps.begin() + index + 1);
+            break;
+    }
+    
+    editStats.apply(race);
+    
+    if (bestWindowLost) {
+        race.best3ConsecutiveTotal = 0;
+        for (size_t s = 0; s + 2 < laps.size(); s++) {
+            uint32_t window = lapWindow(laps, s);
+            if (race.best3ConsecutiveTotal == 0 || window < race.best3ConsecutiveTotal) {
+                race.best3ConsecutiveTotal = window;
+            }
+        }
+    } else {
+        for (size_t s = firstWindow; s <= index + 1 && s + 2 < laps.size(); s++) {
+            race.best3ConsecutiveTotal = std::min(race.best3ConsecutiveTotal, lapWindow(laps, s));
+        }
+    }
+    return true;
+}
+
+void LapOrderStats::build(const std::vector<uint32_t>& laps) {
+    sorted = laps;
+    std::sort(sorted.begin(), sorted.end());
+}
+
+void LapOrderStats::insert(uint32_t lap) {
+    sorted.insert(std::upper_bound(sorted.begin(), sorted.end(), lap), lap);
+}
+
+void LapOrderStats::erase(uint32_t lap) {
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), lap);
+    if (it != sorted.end() && *it == lap) {
+        sorted.erase(it);
+    }
+}
+
+void LapOrderStats::apply(RaceSession& race) const {
+    if (sorted.empty()) {
+        race.fastestLap = 0;
+        race.medianLap = 0;
+        race.best3LapsTotal = 0;
+        return;
+    }
+    
+    race.fastestLap = sorted[0];
+    size_t mid = sorted.size() / 2;
+    if (sorted.size() % 2 == 0) {
+        race.medianLap = (sorted[mid - 1] + sorted[mid]) / 2;
+    } else {
+        race.medianLap = sorted[mid];
+    }
+    race.best3LapsTotal = 0;
+    for (size_t i = 0; i < sorted.size() && i < 3; i++) {
+        race.best3LapsTotal += sorted[i];
+    }
+}
+
+void RaceHistory::computeStats(RaceSession& race) {
+    if (race.lapTimes.empty()) {
+        race.fastestLap = 0;
+        race.medianLap = 0;
+        race.best3LapsTotal = 0;
+        race.best3ConsecutiveTotal = 0;
+        return;
+    }
     
-    // Recalculate statistics
     // Fastest lap
-    targetRace->fastestLap = *std::min_element(newLapTimes.begin(), newLapTimes.end());
+    race.fastestLap = *std::min_element(race.lapTimes.begin(), race.lapTimes.end());
     
     // Median lap
-    std::vector<uint32_t> sorted = newLapTimes;
+    std::vector<uint32_t> sorted = race.lapTimes;
     std::sort(sorted.begin(), sorted.end());
     size_t mid = sorted.size() / 2;
     if (sorted.size() % 2 == 0) {
-        targetRace->medianLap = (sorted[mid - 1] + sorted[mid]) / 2;
+        race.medianLap = (sorted[mid - 1] + sorted[mid]) / 2;
     } else {
-        targetRace->medianLap = sorted[mid];
+        race.medianLap = sorted[mid];
     }
     
     // Best 3 laps total
-    if (newLapTimes.size() >= 3) {
-        targetRace->best3LapsTotal = sorted[0] + sorted[1] + sorted[2];
-    } else {
-        targetRace->best3LapsTotal = 0;
-        for (uint32_t lap : sorted) {
-            targetRace->best3LapsTotal += lap;
-        }
+    race.best3LapsTotal = 0;
+    for (size_t i = 0; i < sorted.size() && i < 3; i++) {
+        race.best3LapsTotal += sorted[i];
     }
     
-    // Write updated race to file
-    time_t ts = timestamp;
-    struct tm timeinfo;
-    localtime_r(&ts, &timeinfo);
-    
-    char filename[32];
-    strftime(filename, sizeof(filename), "%d%m%y-%H%M%S.json", &timeinfo);
-    String filepath = String(RACES_DIR) + "/" + String(filename);
-    
-    // Create JSON
-    DynamicJsonDocument doc(16384);
-    JsonObject raceObj = doc.to<JsonObject>();
-    raceObj["timestamp"] = targetRace->timestamp;
-    raceObj["fastestLap"] = targetRace->fastestLap;
-    raceObj["medianLap"] = targetRace->medianLap;
-    raceObj["best3LapsTotal"] = targetRace->best3LapsTotal;
-    raceObj["name"] = targetRace->name;
-    raceObj["tag"] = targetRace->tag;
-    raceObj["pilotName"] = targetRace->pilotName;
-    raceObj["pilotCallsign"] = targetRace->pilotCallsign;
-    raceObj["frequency"] = targetRace->frequency;
-    raceObj["band"] = targetRace->band;
-    raceObj["channel"] = targetRace->channel;
-    raceObj["trackId"] = targetRace->trackId;
-    raceObj["trackName"] = targetRace->trackName;
-    raceObj["totalDistance"] = targetRace->totalDistance;
+    // Best 3 consecutive laps
+    race.best3ConsecutiveTotal = 0;
+    for (size_t i = 2; i < race.lapTimes.size(); i++) {
+        uint32_t window = race.lapTimes[i - 2] + race.lapTimes[i - 1] + race.lapTimes[i];
+        if (race.best3ConsecutiveTotal == 0 || window < race.best3ConsecutiveTotal) {
+            race.best3ConsecutiveTotal = window;
+        }
+    }
+}
+
+void RaceHistory::raceToJson(const RaceSession& race, JsonObject raceObj, bool includeLaps) {
+    raceObj["timestamp"] = race.timestamp;
+    raceObj["fastestLap"] = race.fastestLap;
+    raceObj["medianLap"] = race.medianLap;
+    raceObj["best3LapsTotal"] = race.best3LapsTotal;
+    raceObj["best3ConsecutiveTotal"] = race.best3ConsecutiveTotal;
+    raceObj["name"] = race.name;
+    raceObj["tag"] = race.tag;
+    raceObj["pilotName"] = race.pilotName;
+    raceObj["pilotCallsign"] = race.pilotCallsign;
+    raceObj["frequency"] = race.frequency;
+    raceObj["band"] = race.band;
+    raceObj["channel"] = race.channel;
+    raceObj["trackId"] = race.trackId;
+    raceObj["trackName"] = race.trackName;
+    raceObj["totalDistance"] = race.totalDistance;
     
+    if (!includeLaps) {
+        return;
+    }
     JsonArray lapsArray = raceObj.createNestedArray("lapTimes");
-    for (uint32_t lap : targetRace->lapTimes) {
+    for (uint32_t lap : race.lapTimes) {
         lapsArray.add(lap);
     }
+    if (race.nodeLaps.empty()) {
+        return;
+    }
+    JsonArray nodesArray = raceObj.createNestedArray("nodes");
+    for (const auto& nodeLaps : race.nodeLaps) {
+        JsonObject nodeObj = nodesArray.createNestedObject();
+        nodeObj["node"] = nodeLaps.node;
+        nodeObj["frequency"] = nodeLaps.frequency;
+        JsonArray nodeLapsArray = nodeObj.createNestedArray("lapTimes");
+        for (uint32_t lap : nodeLaps.lapTimes) {
+            nodeLapsArray.add(lap);
+        }
+    }
+}
+
+// Members raceToJson() sets without laps, and how many of them are strings
+#define RACE_JSON_FIELDS 15
+#define RACE_JSON_STRINGS 6
+
+void RaceHistory::writeRaceJson(const RaceSession& race, Print& out) {
+    // The document only holds the metadata, sized for its strings; the lap
+    // array is printed as it goes so long races don't need a document sized
+    // for every lap
+    size_t capacity = JSON_OBJECT_SIZE(RACE_JSON_FIELDS) + race.name.length() + race.tag.length() +
+                      race.pilotName.length() + race.pilotCallsign.length() + race.band.length() +
+                      race.trackName.length() + RACE_JSON_STRINGS;  // Terminators
+    DynamicJsonDocument doc(capacity);
+    raceToJson(race, doc.to<JsonObject>(), false);
+    String head;
+    serializeJson(doc, head);
+    if (doc.overflowed() || head.length() <= 2 || head[0] != '{') {
+        // Out of memory; the timestamp alone still makes a valid race
+        DEBUG("Race %u metadata did not fit in %u bytes\n", race.timestamp, (unsigned)capacity);
+        head = "{\"timestamp\":" + String(race.timestamp) + "}";
+    }
+    out.write((const uint8_t*)head.c_str(), head.length() - 1);  // Drop the closing brace
+    out.print(",\"lapTimes\":[");
+    for (size_t i = 0; i < race.lapTimes.size(); i++) {
+        if (i > 0) {
+            out.print(",");
+        }
+        out.print((unsigned long)race.lapTimes[i]);
+    }
+    out.print("]");
+    if (!race.nodeLaps.empty()) {
+        out.print(",\"nodes\":[");
+        for (size_t n = 0; n < race.nodeLaps.size(); n++) {
+            const RaceSession::NodeLaps& nodeLaps = race.nodeLaps[n];
+            out.printf("%s{\"node\":%u,\"frequency\":%u,\"lapTimes\":[", n > 0 ? "," : "",
+                       nodeLaps.node, nodeLaps.frequency);
+            for (size_t i = 0; i < nodeLaps.lapTimes.size(); i++) {
+                if (i > 0) {
+                    out.print(",");
+                }
+                out.print((unsigned long)nodeLaps.lapTimes[i]);
+            }
+            out.print("]}");
+        }
+        out.print("]");
+    }
+    out.print("}");
+}
+
+void RaceHistory::raceFromJson(JsonObject raceObj, RaceSession& race) {
+    race.timestamp = raceObj["timestamp"];
+    race.fastestLap = raceObj["fastestLap"];
+    race.medianLap = raceObj["medianLap"];
+    race.best3LapsTotal = raceObj["best3LapsTotal"];
+    race.best3ConsecutiveTotal = raceObj["best3ConsecutiveTotal"] | 0;
+    race.name = raceObj["name"] | "";
+    race.tag = raceObj["tag"] | "";
+    race.pilotName = raceObj["pilotName"] | "";
+    race.pilotCallsign = raceObj["pilotCallsign"] | "";
+    race.frequency = raceObj["frequency"] | 0;
+    race.band = raceObj["band"] | "";
+    race.channel = raceObj["channel"] | 0;
+    race.trackId = raceObj["trackId"] | 0;
+    race.trackName = raceObj["trackName"] | "";
+    race.totalDistance = raceObj["totalDistance"] | 0.0f;
+    
+    race.lapTimes.clear();
+    JsonArray lapsArray = raceObj["lapTimes"];
+    for (uint32_t lap : lapsArray) {
+        race.lapTimes.push_back(lap);
+    }
     
-    String json;
-    serializeJson(doc, json);
+    race.nodeLaps.clear();
+    JsonArray nodesArray = raceObj["nodes"];
+    for (JsonObject nodeObj : nodesArray) {
+        RaceSession::NodeLaps nodeLaps;
+        nodeLaps.node = nodeObj["node"] | 0;
+        nodeLaps.frequency = nodeObj["frequency"] | 0;
+        JsonArray nodeLapsArray = nodeObj["lapTimes"];
+        for (uint32_t lap : nodeLapsArray) {
+            nodeLaps.lapTimes.push_back(lap);
+        }
+        race.nodeLaps.push_back(nodeLaps);
+    }
     
-    bool success = storage->writeFile(filepath, json);
-    if (success) {
-        DEBUG("Updated laps for race %u\n", timestamp);
+    // Races saved before best 3 consecutive was tracked
+    if (!raceObj.containsKey("best3ConsecutiveTotal")) {
+        computeStats(race);
     }
-    return success;
 }
 
 bool RaceHistory::clearAll() {
     // Delete all race files
+    HistoryLock lock(mutex);
+    storage->flush();
     std::vector<String> files;
     if (storage->listDir(RACES_DIR, files)) {
         for (const String& filename : files) {
-            if (filename.endsWith(".json")) {
+            if (filename.endsWith(".json") || filename.endsWith(".trace")) {
                 String filepath = String(RACES_DIR) + "/" + filename;
-                storage->deleteFile(filepath);
+                storage->deleteFileAsync(filepath);
             }
         }
     }
     
+    for (const auto& race : races) {
+        storage->deleteFileAsync(RssiRecorder::recordingPath(race.timestamp));
+        logChange(CHANGE_DELETE, race.timestamp);
+    }
     races.clear();
+    raceIndex.clear();
+    leaderboard.clear();
+    editStatsRace = 0;
     return true;
 }
 
-String RaceHistory::toJsonString() {
-    DynamicJsonDocument doc(32768);
-    JsonArray racesArray = doc.createNestedArray("races");
-    
-    for (const auto& race : races) {
-        JsonObject raceObj = racesArray.createNestedObject();
-        raceObj["timestamp"] = race.timestamp;
-        raceObj["fastestLap"] = race.fastestLap;
-        raceObj["medianLap"] = race.medianLap;
-        raceObj["best3LapsTotal"] = race.best3LapsTotal;
-        raceObj["name"] = race.name;
-        raceObj["tag"] = race.tag;
-        raceObj["pilotName"] = race.pilotName;
-        raceObj["pilotCallsign"] = race.pilotCallsign;
-        raceObj["frequency"] = race.frequency;
-        raceObj["band"] = race.band;
-        raceObj["channel"] = race.channel;
-        raceObj["trackId"] = race.trackId;
-        raceObj["trackName"] = race.trackName;
-        raceObj["totalDistance"] = race.totalDistance;
-        
-        JsonArray lapsArray = raceObj.createNestedArray("lapTimes");
-        for (uint32_t lap : race.lapTimes) {
-            lapsArray.add(lap);
+void RaceHistory::toJson(Print& out) {
+    // One race at a time so memory use doesn't grow with the history, each
+    // a copy so the lock isn't held while the output blocks
+    out.print("{\"races\":[");
+    RaceSession race;
+    uint32_t cursor = UINT32_MAX;
+    bool first = true;
+    while (getRaceBefore(cursor, race)) {
+        if (!first) {
+            out.print(",");
         }
+        writeRaceJson(race, out);
+        cursor = race.timestamp;
+        first = false;
     }
-    
-    String output;
-    serializeJson(doc, output);
-    return output;
+    out.print("]}");
 }
 
 bool RaceHistory::fromJsonString(const String& json) {
@@ -375,50 +725,90 @@ bool RaceHistory::fromJsonString(const String& json) {
     }
     
     // Import races from JSON array
+    HistoryLock lock(mutex);
     JsonArray racesArray = doc["races"];
     int importedCount = 0;
     
     for (JsonObject raceObj : racesArray) {
         RaceSession race;
-        race.timestamp = raceObj["timestamp"];
-        race.fastestLap = raceObj["fastestLap"];
-        race.medianLap = raceObj["medianLap"];
-        race.best3LapsTotal = raceObj["best3LapsTotal"];
-        race.name = raceObj["name"] | "";
-        race.tag = raceObj["tag"] | "";
-        race.pilotName = raceObj["pilotName"] | "";
-        race.pilotCallsign = raceObj["pilotCallsign"] | "";
-        race.frequency = raceObj["frequency"] | 0;
-        race.band = raceObj["band"] | "";
-        race.channel = raceObj["channel"] | 0;
-        race.trackId = raceObj["trackId"] | 0;
-        race.trackName = raceObj["trackName"] | "";
-        race.totalDistance = raceObj["totalDistance"] | 0.0f;
-        
-        JsonArray lapsArray = raceObj["lapTimes"];
-        for (uint32_t lap : lapsArray) {
-            race.lapTimes.push_back(lap);
-        }
-        
-        // Check if race with this timestamp already exists
-        bool exists = false;
-        for (const auto& existingRace : races) {
-            if (existingRace.timestamp == race.timestamp) {
-                exists = true;
-                break;
-            }
-        }
+        raceFromJson(raceObj, race);
         
         // Save to individual file if it doesn't exist
-        if (!exists && saveRace(race)) {
+        if (!hasRace(race.timestamp)) {
+            addRace(race);
             importedCount++;
         }
     }
     
-    // Reload all races to update in-memory list
-    loadRaces();
+    // Imported races can be older than the ones already here; restore
+    // newest-first order in memory instead of reloading every file
+    if (importedCount > 0) {
+        std::sort(races.begin(), races.end(),
+            [](const RaceSession& a, const RaceSession& b) { return a.timestamp > b.timestamp; });
+        trimToMax();
+    }
     
     DEBUG("Imported %d races\n", importedCount);
     return true;
 }
 
+String RaceHistory::racePath(uint32_t timestamp) {
+    // Filename from timestamp: DDMMYY-HrMinSec.json
+    time_t ts = timestamp;
+    struct tm timeinfo;
+    localtime_r(&ts, &timeinfo);
+    
+    char filename[32];
+    strftime(filename, sizeof(filename), "%d%m%y-%H%M%S.json", &timeinfo);
+    return String(RACES_DIR) + "/" + String(filename);
+}
+
+String RaceHistory::tracePath(uint32_t timestamp) {
+    String path = racePath(timestamp);
+    path.replace(".json", ".trace");
+    return path;
+}
+
+void RaceHistory::saveTraces(uint32_t timestamp, const PassTraceLog& traces) {
+    if (traces.size() == 0) {
+        return;
+    }
+    // Copied now, the timer clears its log when the next race starts
+    std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>();
+    if (!traces.serialize(*data)) {
+        DEBUG("Traces of race %u were cleared before they were saved\n", timestamp);
+        return;
+    }
+    storage->writeStreamAsync(tracePath(timestamp), [data](Print& out) {
+        return out.write(data->data(), data->size()) == data->size();
+    });
+}
+
+bool RaceHistory::readTraceHeader(uint32_t timestamp, pass_trace_file_t& header) {
+    return storage->readChunk(tracePath(timestamp), 0, (uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+           header.magic == PASSTRACE_FILE_MAGIC;
+}
+
+bool RaceHistory::readTrace(uint32_t timestamp, const pass_trace_file_t& header, uint16_t index,
+                            pass_trace_t& trace, std::vector<uint8_t>& payload) {
+    if (index >= header.count) {
+        return false;
+    }
+    String path = tracePath(timestamp);
+    size_t tableOffset = sizeof(header) + index * sizeof(pass_trace_t);
+    if (storage->readChunk(path, tableOffset, (uint8_t*)&trace, sizeof(trace)) != sizeof(trace)) {
+        return false;
+    }
+    size_t payloadStart = sizeof(header) + header.count * sizeof(pass_trace_t);
+    payload.resize(trace.length);
+    return storage->readChunk(path, payloadStart + trace.offset, payload.data(), trace.length) == trace.length;
+}
+
+void RaceHistory::writeRaceFile(const RaceSession& race, StorageCallback done) {
+    // Serialized on the storage task straight into the file
+    RaceSession snapshot = race;
+    storage->writeStreamAsync(racePath(race.timestamp), [snapshot](Print& out) {
+        writeRaceJson(snapshot, out);
+        return true;
+    }, done);
+}
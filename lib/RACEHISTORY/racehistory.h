@@ -3,18 +3,26 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <unordered_set>
 #include <vector>
+#include "changelog.h"
+#include "leaderboard.h"
+#include "passtrace.h"
 #include "storage.h"
 
 #define MAX_RACES 50
 #define RACES_DIR "/races"
+#define RACEHISTORY_MAX_LAP_EDITS 256  // Per editLaps() call
 
 struct RaceSession {
     uint32_t timestamp;
     std::vector<uint32_t> lapTimes;
     uint32_t fastestLap;
     uint32_t medianLap;
-    uint32_t best3LapsTotal;
+    uint32_t best3LapsTotal;          // Sum of the 3 fastest laps
+    uint32_t best3ConsecutiveTotal;   // Fastest run of 3 consecutive laps
     String name;
     String tag;
     String pilotName;
@@ -25,26 +33,110 @@ struct RaceSession {
     uint32_t trackId;
     String trackName;
     float totalDistance;
+
+    // Laps of the extra receiver nodes, when more than one is fitted
+    struct NodeLaps {
+        uint8_t node;
+        uint16_t frequency;
+        std::vector<uint32_t> lapTimes;
+    };
+    std::vector<NodeLaps> nodeLaps;
 };
 
+// Lap corrections applied to a saved race in place
+typedef enum : uint8_t {
+    LAP_EDIT_SET,      // Replace lap index with lapTime
+    LAP_EDIT_DELETE,   // Remove lap index (false detection)
+    LAP_EDIT_INSERT,   // Insert lapTime before index (missed lap)
+    LAP_EDIT_SPLIT,    // Split lap index into lapTime and the remainder
+    LAP_EDIT_MERGE     // Merge lap index with the one after it
+} lap_edit_op_e;
+
+typedef struct {
+    uint8_t op;  // lap_edit_op_e
+    size_t index;
+    uint32_t lapTime;
+} lap_edit_t;
+
+// Sorted copy of a race's laps; fastest, median and best 3 in O(1) and
+// single-lap updates in O(log n) search plus a memmove
+class LapOrderStats {
+   public:
+    void build(const std::vector<uint32_t>& laps);
+    void insert(uint32_t lap);
+    void erase(uint32_t lap);
+    void apply(RaceSession& race) const;  // fastestLap, medianLap, best3LapsTotal
+
+   private:
+    std::vector<uint32_t> sorted;
+};
+
+// Shared by the web server, USB, the race recorder on the service core and
+// the loop. Every public call holds a recursive mutex for its duration,
+// and races are handed out as copies, never as references into the list.
 class RaceHistory {
    public:
     RaceHistory();
-    bool init(Storage* storage);
+    bool init(Storage* storage, ChangeLog* changeLog = nullptr);
+    
+    // Changes apply in memory and the files are written by the storage
+    // worker: true means accepted, not landed. A write that fails later is
+    // counted by Storage::getFailedJobs() and reported to clients.
     bool saveRace(const RaceSession& race);
     bool loadRaces();
     bool deleteRace(uint32_t timestamp);
     bool updateRace(uint32_t timestamp, const String& name, const String& tag, float totalDistance = -1.0f);
     bool updateLaps(uint32_t timestamp, const std::vector<uint32_t>& newLapTimes);
+    bool editLap(uint32_t timestamp, uint8_t op, size_t index, uint32_t lapTime = 0);
+    bool editLaps(uint32_t timestamp, const std::vector<lap_edit_t>& edits);  // In order, all or none
+    bool findRace(uint32_t timestamp, RaceSession& race) const;  // Copy
+    // Newest race older than before (UINT32_MAX for the newest), copied;
+    // a cursor that stays valid while races are added or removed
+    bool getRaceBefore(uint32_t before, RaceSession& race) const;
+    static bool parseLapEditOp(const String& name, uint8_t& op);
+    static bool lapEditsFromJson(JsonArray editsArray, std::vector<lap_edit_t>& edits);  // [{op, index, lapTime}]
     bool clearAll();
-    String toJsonString();
+    void toJson(Print& out);
+    
+    // RSSI traces around the passes of a race, kept next to its file
+    void saveTraces(uint32_t timestamp, const PassTraceLog& traces);
+    bool readTraceHeader(uint32_t timestamp, pass_trace_file_t& header);
+    bool readTrace(uint32_t timestamp, const pass_trace_file_t& header, uint16_t index,
+                   pass_trace_t& trace, std::vector<uint8_t>& payload);  // One at a time
     bool fromJsonString(const String& json);
-    const std::vector<RaceSession>& getRaces() const { return races; }
-    size_t getRaceCount() const { return races.size(); }
+    size_t getRaceCount() const;
+    bool hasRace(uint32_t timestamp) const;
+    Leaderboard& getLeaderboard() { return leaderboard; }
+    
+    // Recalculate fastest, median and best 3 laps from race.lapTimes
+    static void computeStats(RaceSession& race);
+    
+    // Shared race (de)serialization for files, API responses and imports
+    static void raceToJson(const RaceSession& race, JsonObject raceObj, bool includeLaps = true);
+    static void writeRaceJson(const RaceSession& race, Print& out);  // Same output, laps streamed
+    static void raceFromJson(JsonObject raceObj, RaceSession& race);
 
    private:
     std::vector<RaceSession> races;
+    std::unordered_set<uint32_t> raceIndex;  // Timestamps of races, for duplicate checks
     Storage* storage;
+    ChangeLog* changeLog;
+    Leaderboard leaderboard;
+    SemaphoreHandle_t mutex;  // Recursive, public calls nest
+    
+    // Order statistics of the race being corrected, built on its first edit
+    uint32_t editStatsRace;
+    LapOrderStats editStats;
+    
+    void addRace(const RaceSession& race);  // Newest first, without trimming
+    bool applyLapEdit(RaceSession& race, const lap_edit_t& edit);  // Laps and stats only
+    void logChange(uint8_t op, uint32_t timestamp);
+    void trimToMax();
+    void deleteRaceFiles(uint32_t timestamp);
+
+    static String racePath(uint32_t timestamp);
+    static String tracePath(uint32_t timestamp);
+    void writeRaceFile(const RaceSession& race, StorageCallback done = nullptr);
 };
 
 #endif
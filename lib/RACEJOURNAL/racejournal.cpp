@@ -0,0 +1,212 @@
+#include "racejournal.h"
+
+#include <esp_rom_crc.h>
+
+#include "debug.h"
+
+RaceJournal::RaceJournal()
+    : storage(nullptr), queue(NULL), fileMutex(NULL), raceOpen(false),
+      unsyncedRecords(0), lastSyncMs(0), droppedRecords(0) {
+}
+
+void RaceJournal::init(Storage* stor) {
+    storage = stor;
+    if (!queue) {
+        queue = xQueueCreate(RACE_JOURNAL_QUEUE_LEN, sizeof(journal_record_t));
+    }
+    if (!fileMutex) {
+        fileMutex = xSemaphoreCreateMutex();
+    }
+
+    // Park what the last boot left behind until recover() runs
+    if (LittleFS.exists(RACE_JOURNAL_PATH)) {
+        LittleFS.remove(RACE_JOURNAL_PENDING_PATH);
+        if (!LittleFS.rename(RACE_JOURNAL_PATH, RACE_JOURNAL_PENDING_PATH)) {
+            DEBUG("Race journal: failed to move leftover journal aside\n");
+        }
+    }
+    DEBUG("Race journal initialized (%u byte records)\n", sizeof(journal_record_t));
+}
+
+void RaceJournal::logRaceStart(uint32_t unixTime, uint16_t frequency) {
+    journal_record_t record = {};
+    record.type = JOURNAL_RECORD_START;
+    record.frequency = frequency;
+    record.value = unixTime;
+    enqueue(record);
+}
+
+void RaceJournal::logLap(uint32_t lapTimeMs, uint8_t peakRssi) {
+    journal_record_t record = {};
+    record.type = JOURNAL_RECORD_LAP;
+    record.peakRssi = peakRssi;
+    record.value = lapTimeMs;
+    enqueue(record);
+}
+
+void RaceJournal::logRaceStop() {
+    journal_record_t record = {};
+    record.type = JOURNAL_RECORD_STOP;
+    enqueue(record);
+}
+
+void RaceJournal::enqueue(journal_record_t& record) {
+    if (!queue) return;
+    record.timeMs = millis();
+    // Zero timeout: the timing loop must never block on the journal
+    if (xQueueSend(queue, &record, 0) != pdTRUE) {
+        droppedRecords++;
+    }
+}
+
+void RaceJournal::handleJournal(uint32_t currentTimeMs) {
+    if (!queue || !storage) return;
+
+    bool syncDue = unsyncedRecords > 0 &&
+                   (unsyncedRecords >= RACE_JOURNAL_SYNC_RECORDS ||
+                    (currentTimeMs - lastSyncMs) > RACE_JOURNAL_SYNC_MS);
+    if (uxQueueMessagesWaiting(queue) == 0 && !syncDue) return;
+
+    if (xSemaphoreTake(fileMutex, 0) != pdTRUE) return;  // recovery in progress, try next tick
+
+    journal_record_t record;
+    while (xQueueReceive(queue, &record, 0) == pdTRUE) {
+        writeRecord(record, currentTimeMs);
+    }
+
+    if (unsyncedRecords >= RACE_JOURNAL_SYNC_RECORDS ||
+        (unsyncedRecords > 0 && (currentTimeMs - lastSyncMs) > RACE_JOURNAL_SYNC_MS)) {
+        sync(currentTimeMs);
+    }
+
+    if (droppedRecords > 0) {
+        DEBUG("Race journal: queue full, %u records dropped\n", droppedRecords);
+        droppedRecords = 0;
+    }
+
+    xSemaphoreGive(fileMutex);
+}
+
+void RaceJournal::writeRecord(journal_record_t& record, uint32_t currentTimeMs) {
+    switch (record.type) {
+        case JOURNAL_RECORD_START:
+            if (journalFile) {
+                journalFile.close();
+            }
+            // Truncate: a new race replaces whatever the previous one left behind
+            journalFile = LittleFS.open(RACE_JOURNAL_PATH, "w");
+            if (!journalFile) {
+                DEBUG("Race journal: failed to open %s\n", RACE_JOURNAL_PATH);
+                raceOpen = false;
+                return;
+            }
+            raceOpen = true;
+            lastSyncMs = currentTimeMs;
+            break;
+        case JOURNAL_RECORD_LAP:
+        case JOURNAL_RECORD_STOP:
+            if (!raceOpen || !journalFile) return;
+            break;
+        default:
+            return;
+    }
+
+    record.crc = recordCrc(record);
+    if (journalFile.write((const uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+        DEBUG("Race journal: short write\n");
+    }
+    unsyncedRecords++;
+
+    // Start and stop are synced immediately, laps are batched
+    if (record.type != JOURNAL_RECORD_LAP) {
+        sync(currentTimeMs);
+    }
+    if (record.type == JOURNAL_RECORD_STOP) {
+        journalFile.close();
+        raceOpen = false;
+    }
+}
+
+void RaceJournal::sync(uint32_t currentTimeMs) {
+    if (journalFile) {
+        journalFile.flush();  // fflush + fsync on the VFS layer
+    }
+    unsyncedRecords = 0;
+    lastSyncMs = currentTimeMs;
+}
+
+uint32_t RaceJournal::recordCrc(const journal_record_t& record) {
+    return esp_rom_crc32_le(0, (const uint8_t*)&record, offsetof(journal_record_t, crc));
+}
+
+bool RaceJournal::recover(RaceHistory* history, const char* pilotName) {
+    if (!storage || !history || !fileMutex) return false;
+
+    if (xSemaphoreTake(fileMutex, portMAX_DELAY) != pdTRUE) return false;
+
+    if (!LittleFS.exists(RACE_JOURNAL_PENDING_PATH)) {
+        xSemaphoreGive(fileMutex);
+        return false;
+    }
+
+    File file = LittleFS.open(RACE_JOURNAL_PENDING_PATH, "r");
+    if (!file) {
+        xSemaphoreGive(fileMutex);
+        return false;
+    }
+
+    RaceSession race = {};
+    bool started = false;
+    bool finished = false;
+    uint32_t corrupt = 0;
+    journal_record_t record;
+
+    while (file.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+        if (record.crc != recordCrc(record)) {
+            // Torn or partial write - everything before it is still good
+            corrupt++;
+            break;
+        }
+        if (record.type == JOURNAL_RECORD_START) {
+            started = true;
+            race.timestamp = record.value;
+            race.frequency = record.frequency;
+            race.lapTimes.clear();
+        } else if (record.type == JOURNAL_RECORD_LAP && started) {
+            if (race.lapTimes.size() < RACE_JOURNAL_MAX_LAPS) {
+                race.lapTimes.push_back(record.value);
+            }
+        } else if (record.type == JOURNAL_RECORD_STOP) {
+            finished = true;
+        }
+    }
+    file.close();
+
+    bool recovered = false;
+    bool discard = true;
+    if (!started || finished) {
+        DEBUG("Race journal: nothing to recover\n");
+    } else if (race.lapTimes.empty()) {
+        DEBUG("Race journal: unfinished race had no laps\n");
+    } else {
+        if (history->hasRace(race.timestamp)) {
+            DEBUG("Race journal: race %u already in history\n", race.timestamp);
+        } else {
+            discard = false;
+            race.name = "Recovered race";
+            race.pilotName = pilotName ? pilotName : "";
+            RaceHistory::computeStats(race);
+            recovered = history->saveRace(race);
+            DEBUG("Race journal: recovered race %u with %u laps%s\n", race.timestamp,
+                  race.lapTimes.size(), corrupt ? " (truncated at corrupt record)" : "");
+        }
+    }
+
+    // Only drop the journal once its contents are safely in history
+    if (recovered || discard) {
+        LittleFS.remove(RACE_JOURNAL_PENDING_PATH);
+    }
+
+    xSemaphoreGive(fileMutex);
+    return recovered;
+}
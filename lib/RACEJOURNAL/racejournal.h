@@ -0,0 +1,88 @@
+#ifndef RACEJOURNAL_H
+#define RACEJOURNAL_H
+
+/**
+ * Crash-safe race journal
+ *
+ * Every race is mirrored into an append-only binary file as it happens so
+ * that laps survive a closed browser tab, a dead phone or a brown-out.
+ *
+ * - The timing loop only posts fixed-size records to a FreeRTOS queue
+ *   (never blocks); handleJournal() on the service core writes them out.
+ * - Each record carries a CRC32, so a torn write at power loss is detected
+ *   and everything before it is still recovered.
+ * - The file is flushed (fsync) every few records or seconds.
+ * - A race that ended normally gets a STOP record. On the next boot a
+ *   journal without one is turned into a RaceSession in RaceHistory.
+ * - The journal always lives on LittleFS, whichever backend Storage is
+ *   using, so an SD card mounted after boot can't hide it. init() moves a
+ *   leftover journal aside so a race started before recover() runs can't
+ *   truncate it.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include <LittleFS.h>
+
+#include "racehistory.h"
+#include "storage.h"
+
+#define RACE_JOURNAL_PATH "/race_journal.bin"
+#define RACE_JOURNAL_PENDING_PATH "/race_journal.old"  // Leftover journal awaiting recover()
+#define RACE_JOURNAL_QUEUE_LEN 32
+#define RACE_JOURNAL_SYNC_RECORDS 4     // fsync after this many unsynced records
+#define RACE_JOURNAL_SYNC_MS 2000       // ...or after this long with unsynced records
+#define RACE_JOURNAL_MAX_LAPS 1000      // Upper bound on laps recovered from one journal
+
+typedef enum : uint8_t {
+    JOURNAL_RECORD_START = 0x53,  // 'S'
+    JOURNAL_RECORD_LAP = 0x4C,    // 'L'
+    JOURNAL_RECORD_STOP = 0x45    // 'E'
+} journal_record_type_e;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;        // journal_record_type_e
+    uint8_t peakRssi;    // LAP: peak RSSI of the pass
+    uint16_t frequency;  // START: receiver frequency in MHz
+    uint32_t value;      // START: unix time (s), LAP: lap time (ms)
+    uint32_t timeMs;     // millis() when the record was produced
+    uint32_t crc;        // CRC32 over all preceding bytes
+} journal_record_t;
+
+class RaceJournal {
+   public:
+    RaceJournal();
+    void init(Storage* stor);
+
+    // Producer side - safe to call from the timing loop, never waits for flash
+    void logRaceStart(uint32_t unixTime, uint16_t frequency);
+    void logLap(uint32_t lapTimeMs, uint8_t peakRssi);
+    void logRaceStop();
+
+    // Consumer side - called from the service core task
+    void handleJournal(uint32_t currentTimeMs);
+
+    // Turn an unfinished journal into a saved race. Call once race history is on
+    // its final backend (after the deferred SD mount attempt).
+    bool recover(RaceHistory* history, const char* pilotName = "");
+
+   private:
+    Storage* storage;
+    QueueHandle_t queue;
+    SemaphoreHandle_t fileMutex;
+    File journalFile;
+    bool raceOpen;
+    uint8_t unsyncedRecords;
+    uint32_t lastSyncMs;
+    uint32_t droppedRecords;
+
+    void enqueue(journal_record_t& record);
+    void writeRecord(journal_record_t& record, uint32_t currentTimeMs);
+    void sync(uint32_t currentTimeMs);
+    static uint32_t recordCrc(const journal_record_t& record);
+};
+
+#endif  // RACEJOURNAL_H
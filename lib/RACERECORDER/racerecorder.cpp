@@ -0,0 +1,249 @@
+#include "racerecorder.h"
+
+#include "debug.h"
+#include "laptimer.h"
+#include "trackmanager.h"
+
+RaceRecorder::RaceRecorder()
+    : conf(nullptr), history(nullptr), timer(nullptr), queue(NULL), raceMutex(NULL),
+      droppedEvents(0), race(), recording(false), saved(false), pendingChannel(0),
+      trackDistance(0.0f), fastest3Count(0) {
+}
+
+void RaceRecorder::init(Config* config, RaceHistory* raceHistory, LapTimer* lapTimer) {
+    conf = config;
+    history = raceHistory;
+    timer = lapTimer;
+    if (!queue) {
+        queue = xQueueCreate(RACE_RECORDER_QUEUE_LEN, sizeof(recorder_event_t));
+    }
+    if (!raceMutex) {
+        raceMutex = xSemaphoreCreateMutex();
+    }
+    DEBUG("Race recorder initialized\n");
+}
+
+void RaceRecorder::setRaceInfo(const String& callsign, const String& band, uint8_t channel) {
+    if (!raceMutex) return;
+    xSemaphoreTake(raceMutex, portMAX_DELAY);
+    pendingCallsign = callsign;
+    pendingBand = band;
+    pendingChannel = channel;
+    xSemaphoreGive(raceMutex);
+}
+
+void RaceRecorder::logRaceStart(uint32_t unixTime) {
+    enqueue(RECORDER_EVENT_START, unixTime);
+}
+
+void RaceRecorder::logLap(uint32_t lapTimeMs) {
+    enqueue(RECORDER_EVENT_LAP, lapTimeMs);
+}
+
+void RaceRecorder::logNodeLap(uint8_t node, uint32_t lapTimeMs) {
+    enqueue(RECORDER_EVENT_LAP, lapTimeMs, node);
+}
+
+void RaceRecorder::logRaceStop() {
+    enqueue(RECORDER_EVENT_STOP, 0);
+}
+
+void RaceRecorder::enqueue(uint8_t type, uint32_t value, uint8_t node) {
+    if (!queue) return;
+    recorder_event_t event = {type, node, value};
+    // Zero timeout: the timing loop must never block on the recorder
+    if (xQueueSend(queue, &event, 0) != pdTRUE) {
+        droppedEvents++;
+    }
+}
+
+void RaceRecorder::handleRecorder(uint32_t currentTimeMs) {
+    if (!queue || !history) return;
+
+    recorder_event_t event;
+    while (xQueueReceive(queue, &event, 0) == pdTRUE) {
+        switch (event.type) {
+            case RECORDER_EVENT_START:
+                if (recording) {
+                    finishRace();  // Restarted without a stop
+                }
+                beginRace(event.value);
+                break;
+            case RECORDER_EVENT_LAP:
+                if (recording && event.node == 0) {
+                    addLap(event.value);
+                } else if (recording) {
+                    addNodeLap(event.node, event.value);
+                }
+                break;
+            case RECORDER_EVENT_STOP:
+                if (recording) {
+                    finishRace();
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (droppedEvents > 0) {
+        DEBUG("Race recorder: queue full, %u events dropped\n", droppedEvents);
+        droppedEvents = 0;
+    }
+}
+
+void RaceRecorder::beginRace(uint32_t unixTime) {
+    xSemaphoreTake(raceMutex, portMAX_DELAY);
+    race = RaceSession();
+    race.timestamp = unixTime;
+    race.frequency = conf->getFrequency();
+    race.pilotName = conf->getPilotName();
+    race.pilotCallsign = pendingCallsign;
+    race.band = pendingBand;
+    race.channel = pendingChannel;
+    trackDistance = 0.0f;
+    Track* track = timer ? timer->getSelectedTrack() : nullptr;
+    if (track) {
+        race.trackId = track->trackId;
+        race.trackName = track->name;
+        trackDistance = track->distance;
+    }
+
+    lowerLaps = std::priority_queue<uint32_t>();
+    upperLaps = std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>>();
+    fastest3Count = 0;
+    recording = true;
+    saved = false;
+    xSemaphoreGive(raceMutex);
+    DEBUG("Race recorder: recording race %u\n", unixTime);
+}
+
+void RaceRecorder::addLap(uint32_t lapTimeMs) {
+    xSemaphoreTake(raceMutex, portMAX_DELAY);
+    if (race.lapTimes.size() >= RACE_RECORDER_MAX_LAPS) {
+        xSemaphoreGive(raceMutex);
+        return;
+    }
+    race.lapTimes.push_back(lapTimeMs);
+    size_t lapCount = race.lapTimes.size();
+
+    // Fastest lap
+    if (lapCount == 1 || lapTimeMs < race.fastestLap) {
+        race.fastestLap = lapTimeMs;
+    }
+
+    // Running median - keep lowerLaps the same size as upperLaps or one larger
+    if (lowerLaps.empty() || lapTimeMs <= lowerLaps.top()) {
+        lowerLaps.push(lapTimeMs);
+    } else {
+        upperLaps.push(lapTimeMs);
+    }
+    if (lowerLaps.size() > upperLaps.size() + 1) {
+        upperLaps.push(lowerLaps.top());
+        lowerLaps.pop();
+    } else if (upperLaps.size() > lowerLaps.size()) {
+        lowerLaps.push(upperLaps.top());
+        upperLaps.pop();
+    }
+    if (lowerLaps.size() == upperLaps.size()) {
+        race.medianLap = (lowerLaps.top() + upperLaps.top()) / 2;
+    } else {
+        race.medianLap = lowerLaps.top();
+    }
+
+    // Best 3 laps total - insertion into the 3 fastest
+    if (fastest3Count < 3 || lapTimeMs < fastest3[fastest3Count - 1]) {
+        uint8_t i = (fastest3Count < 3) ? fastest3Count++ : 2;
+        while (i > 0 && fastest3[i - 1] > lapTimeMs) {
+            fastest3[i] = fastest3[i - 1];
+            i--;
+        }
+        fastest3[i] = lapTimeMs;
+        race.best3LapsTotal = 0;
+        for (uint8_t j = 0; j < fastest3Count; j++) {
+            race.best3LapsTotal += fastest3[j];
+        }
+    }
+
+    // Best 3 consecutive - sliding window over the last 3 laps
+    if (lapCount >= 3) {
+        uint32_t window = race.lapTimes[lapCount - 3] + race.lapTimes[lapCount - 2] + lapTimeMs;
+        if (race.best3ConsecutiveTotal == 0 || window < race.best3ConsecutiveTotal) {
+            race.best3ConsecutiveTotal = window;
+        }
+    }
+
+    race.totalDistance = trackDistance * lapCount;
+    xSemaphoreGive(raceMutex);
+
+    // Max laps counts laps after gate 1, which is the first entry
+    uint8_t maxLaps = conf->getMaxLaps();
+    if (maxLaps > 0 && lapCount >= (size_t)maxLaps + 1) {
+        DEBUG("Race recorder: max laps (%u) reached\n", maxLaps);
+        finishRace();
+    }
+}
+
+void RaceRecorder::addNodeLap(uint8_t node, uint32_t lapTimeMs) {
+    xSemaphoreTake(raceMutex, portMAX_DELAY);
+    RaceSession::NodeLaps* entry = nullptr;
+    for (auto& nodeLaps : race.nodeLaps) {
+        if (nodeLaps.node == node) {
+            entry = &nodeLaps;
+            break;
+        }
+    }
+    if (!entry) {
+        RaceSession::NodeLaps nodeLaps;
+        nodeLaps.node = node;
+        nodeLaps.frequency = conf->getNodeFrequency(node);
+        race.nodeLaps.push_back(nodeLaps);
+        entry = &race.nodeLaps.back();
+    }
+    if (entry->lapTimes.size() < RACE_RECORDER_MAX_LAPS) {
+        entry->lapTimes.push_back(lapTimeMs);
+    }
+    xSemaphoreGive(raceMutex);
+}
+
+void RaceRecorder::finishRace() {
+    xSemaphoreTake(raceMutex, portMAX_DELAY);
+    recording = false;
+    if (saved || (race.lapTimes.empty() && race.nodeLaps.empty())) {
+        xSemaphoreGive(raceMutex);
+        return;
+    }
+    RaceSession finished = race;
+    xSemaphoreGive(raceMutex);
+
+    // Save outside the lock so API readers never wait on flash
+    bool success = history->saveRace(finished);
+    if (success && timer) {
+        history->saveTraces(finished.timestamp, timer->getPassTraces());
+    }
+    xSemaphoreTake(raceMutex, portMAX_DELAY);
+    saved = success;
+    xSemaphoreGive(raceMutex);
+    DEBUG("Race recorder: race %u with %u laps %s\n", finished.timestamp,
+          finished.lapTimes.size(), success ? "saved" : "could not be saved");
+}
+
+String RaceRecorder::toJsonString() {
+    DynamicJsonDocument doc(16384);
+    JsonObject raceObj = doc.to<JsonObject>();
+    if (raceMutex) {
+        xSemaphoreTake(raceMutex, portMAX_DELAY);
+        RaceHistory::raceToJson(race, raceObj);
+        raceObj["recording"] = recording;
+        raceObj["saved"] = saved;
+        xSemaphoreGive(raceMutex);
+    }
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+bool RaceRecorder::isRecording() {
+    return recording;
+}
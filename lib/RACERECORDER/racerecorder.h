@@ -0,0 +1,100 @@
+#ifndef RACERECORDER_H
+#define RACERECORDER_H
+
+/**
+ * On-device race recorder
+ *
+ * Turns LapTimer events into a RaceSession without any client attached, so
+ * races run with only the OSD or USB connected still end up in history with
+ * correct statistics.
+ *
+ * - The timing loop posts start/lap/stop events to a FreeRTOS queue (never
+ *   blocks); handleRecorder() on the service core consumes them.
+ * - Statistics are maintained incrementally per lap: running median from
+ *   two heaps, best 3 consecutive from a sliding window, fastest lap and the
+ *   sum of the 3 fastest laps.
+ * - The race is saved to RaceHistory when the timer stops or when max laps
+ *   (laps after gate 1) have been completed.
+ * - Laps from extra receiver nodes are kept per node in RaceSession::nodeLaps;
+ *   statistics and max laps only follow node 0.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "config.h"
+#include "racehistory.h"
+
+class LapTimer;
+
+#define RACE_RECORDER_QUEUE_LEN 16
+#define RACE_RECORDER_MAX_LAPS 1000  // Laps beyond this are not recorded
+
+typedef enum : uint8_t {
+    RECORDER_EVENT_START,
+    RECORDER_EVENT_LAP,
+    RECORDER_EVENT_STOP
+} recorder_event_type_e;
+
+typedef struct {
+    uint8_t type;    // recorder_event_type_e
+    uint8_t node;    // LAP: receiver node, 0 is the LapTimer's
+    uint32_t value;  // START: unix time (s), LAP: lap time (ms)
+} recorder_event_t;
+
+class RaceRecorder {
+   public:
+    RaceRecorder();
+    void init(Config* config, RaceHistory* raceHistory, LapTimer* lapTimer);
+
+    // Race metadata the device can't know itself, applied to the next race
+    void setRaceInfo(const String& callsign, const String& band, uint8_t channel);
+
+    // Producer side - safe to call from the timing loop
+    void logRaceStart(uint32_t unixTime);
+    void logLap(uint32_t lapTimeMs);
+    void logNodeLap(uint8_t node, uint32_t lapTimeMs);  // Extra receivers, node 1 and up
+    void logRaceStop();
+
+    // Consumer side - called from the service core task
+    void handleRecorder(uint32_t currentTimeMs);
+
+    // Current (or last finished) race with live statistics
+    String toJsonString();
+    bool isRecording();
+
+   private:
+    Config* conf;
+    RaceHistory* history;
+    LapTimer* timer;
+    QueueHandle_t queue;
+    SemaphoreHandle_t raceMutex;
+    uint32_t droppedEvents;
+
+    RaceSession race;
+    bool recording;
+    bool saved;
+    String pendingCallsign;
+    String pendingBand;
+    uint8_t pendingChannel;
+    float trackDistance;
+
+    // Running median: lower half in a max-heap, upper half in a min-heap
+    std::priority_queue<uint32_t> lowerLaps;
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> upperLaps;
+    uint32_t fastest3[3];  // 3 fastest laps, ascending
+    uint8_t fastest3Count;
+
+    void enqueue(uint8_t type, uint32_t value, uint8_t node = 0);
+    void beginRace(uint32_t unixTime);
+    void addLap(uint32_t lapTimeMs);
+    void addNodeLap(uint8_t node, uint32_t lapTimeMs);
+    void finishRace();
+};
+
+#endif  // RACERECORDER_H
@@ -0,0 +1,258 @@
+#ifndef RSSIPIPELINE_H
+#define RSSIPIPELINE_H
+
+/**
+ * Compile-time RSSI filter pipeline
+ *
+ * A pipeline is a list of stage types, chained at compile time so the
+ * whole chain inlines into the timing loop:
+ *
+ *   RssiPipeline<KalmanStage<500, 50>, MovingAverageStage<3>> pipeline;
+ *   uint8_t filtered = pipeline.filter(raw);
+ *
+ * A stage has `bool step(uint8_t& value)`: it filters value in place, or
+ * returns false to drop the sample (decimation), in which case the rest
+ * of the chain is skipped and the pipeline repeats its previous output.
+ *
+ * The Tunable stages and validator take their parameters at runtime
+ * instead, for detectors configured from the UI (LapDetector); the fixed
+ * ones are built on them.
+ *
+ * The pipeline and the peak validator used by LapTimer are picked per
+ * target with build flags in the targets/ ini files, e.g.
+ *
+ *   -DRSSI_PIPELINE=RSSI_PIPELINE_KALMAN_MEDIAN5
+ *   -DRSSI_PEAK_VALIDATOR=RSSI_PEAK_HYSTERESIS
+ *
+ * Nothing here depends on Arduino, so chains also build on the host.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "kalman.h"
+
+// Light Kalman filtering since hardware cap does most of the work
+// Lower Q = less filtering (hardware cap already smooths noise)
+// Lower R = faster response to real signal changes
+#define RSSI_FILTER_Q 500  // Light filtering with hardware cap
+#define RSSI_FILTER_R 50   // Fast response
+
+// Kalman filter; q is the measurement noise x 100, r the process noise x 10000
+class TunableKalmanStage {
+   public:
+    TunableKalmanStage() { setNoise(RSSI_FILTER_Q, RSSI_FILTER_R); }
+    void setNoise(uint16_t q, uint16_t r) {
+        kalman.setMeasurementNoise(q * 0.01f);
+        kalman.setProcessNoise(r * 0.0001f);
+    }
+    inline bool step(uint8_t& value) {
+        value = round(kalman.filter(value, 0));
+        return true;
+    }
+
+   private:
+    KalmanFilter kalman;
+};
+
+template <uint16_t Q, uint16_t R>
+class KalmanStage : public TunableKalmanStage {
+   public:
+    KalmanStage() { setNoise(Q, R); }
+};
+
+// Mean of the last length samples, 1 to MaxN; starts from zeros
+template <uint8_t MaxN>
+class TunableAverageStage {
+   public:
+    TunableAverageStage() : length(MaxN), index(0) { memset(window, 0, sizeof(window)); }
+    void setLength(uint8_t n) {
+        length = n < 1 ? 1 : (n > MaxN ? MaxN : n);
+        index = 0;
+    }
+    inline bool step(uint8_t& value) {
+        window[index] = value;
+        index = (index + 1) % length;
+        uint16_t sum = 0;
+        for (uint8_t i = 0; i < length; i++) {
+            sum += window[i];
+        }
+        value = sum / length;
+        return true;
+    }
+
+   private:
+    uint8_t window[MaxN];
+    uint8_t length;
+    uint8_t index;
+};
+
+// Mean of the last N samples
+template <uint8_t N>
+class MovingAverageStage : public TunableAverageStage<N> {};
+
+// Median of the last N samples (N odd, small); removes single-sample spikes
+template <uint8_t N>
+class MedianStage {
+   public:
+    MedianStage() : index(0), filled(0) {}
+    inline bool step(uint8_t& value) {
+        window[index] = value;
+        index = (index + 1) % N;
+        if (filled < N) filled++;
+
+        uint8_t sorted[N];
+        for (uint8_t i = 0; i < filled; i++) {
+            uint8_t v = window[i];
+            uint8_t j = i;
+            while (j > 0 && sorted[j - 1] > v) {
+                sorted[j] = sorted[j - 1];
+                j--;
+            }
+            sorted[j] = v;
+        }
+        value = sorted[filled / 2];
+        return true;
+    }
+
+   private:
+    uint8_t window[N];
+    uint8_t index;
+    uint8_t filled;
+};
+
+// Exponential moving average with alpha = 1 / 2^Shift, 8.8 fixed point
+template <uint8_t Shift>
+class EmaStage {
+   public:
+    EmaStage() : state(0), seeded(false) {}
+    inline bool step(uint8_t& value) {
+        int32_t in = (int32_t)value << 8;
+        if (!seeded) {
+            state = in;
+            seeded = true;
+        } else {
+            state += (in - state) >> Shift;
+        }
+        value = (state + 128) >> 8;
+        return true;
+    }
+
+   private:
+    int32_t state;
+    bool seeded;
+};
+
+// Passes every Nth sample
+template <uint8_t N>
+class DecimatorStage {
+   public:
+    DecimatorStage() : count(0) {}
+    inline bool step(uint8_t&) {
+        if (++count < N) return false;
+        count = 0;
+        return true;
+    }
+
+   private:
+    uint8_t count;
+};
+
+template <typename... Stages>
+class RssiChain;
+
+template <>
+class RssiChain<> {
+   public:
+    inline bool step(uint8_t&) { return true; }
+};
+
+template <typename First, typename... Rest>
+class RssiChain<First, Rest...> {
+   public:
+    inline bool step(uint8_t& value) { return first.step(value) && rest.step(value); }
+
+   private:
+    First first;
+    RssiChain<Rest...> rest;
+};
+
+template <typename... Stages>
+class RssiPipeline {
+   public:
+    RssiPipeline() : output(0) {}
+    inline uint8_t filter(uint8_t raw) {
+        uint8_t value = raw;
+        if (chain.step(value)) {
+            output = value;
+        }
+        return output;
+    }
+
+   private:
+    RssiChain<Stages...> chain;
+    uint8_t output;
+};
+
+// Peak validators: whether a captured peak, once the signal is back below
+// exit, is a lap
+
+// Peak above enter and at least margin above exit
+struct TunablePeakMarginValidator {
+    static inline bool valid(uint8_t peak, uint8_t enterRssi, uint8_t exitRssi, uint8_t margin) {
+        return peak > 0 && peak >= enterRssi && peak > exitRssi + margin;
+    }
+};
+
+template <uint8_t Margin>
+struct PeakMarginValidator {
+    static inline bool valid(uint8_t peak, uint8_t enterRssi, uint8_t exitRssi) {
+        return TunablePeakMarginValidator::valid(peak, enterRssi, exitRssi, Margin);
+    }
+};
+
+// Plain dual-threshold hysteresis: crossing enter arms, dropping below exit fires
+struct HysteresisValidator {
+    static inline bool valid(uint8_t peak, uint8_t enterRssi, uint8_t) {
+        return peak > 0 && peak >= enterRssi;
+    }
+};
+
+// Selectable chains
+#define RSSI_PIPELINE_KALMAN_AVG3 0     // Kalman, 3-sample average (original)
+#define RSSI_PIPELINE_KALMAN_MEDIAN5 1  // Kalman, 5-sample median
+#define RSSI_PIPELINE_KALMAN_EMA 2      // Kalman, EMA alpha 1/4
+#define RSSI_PIPELINE_MEDIAN3_AVG3 3    // 3-sample median, 3-sample average, no Kalman
+
+#define RSSI_PEAK_MARGIN 0      // Peak at least 5 above exit (original)
+#define RSSI_PEAK_HYSTERESIS 1  // Enter/exit only
+
+#ifndef RSSI_PIPELINE
+#define RSSI_PIPELINE RSSI_PIPELINE_KALMAN_AVG3
+#endif
+#ifndef RSSI_PEAK_VALIDATOR
+#define RSSI_PEAK_VALIDATOR RSSI_PEAK_MARGIN
+#endif
+
+#if RSSI_PIPELINE == RSSI_PIPELINE_KALMAN_AVG3
+typedef RssiPipeline<KalmanStage<RSSI_FILTER_Q, RSSI_FILTER_R>, MovingAverageStage<3>> LapTimerPipeline;
+#elif RSSI_PIPELINE == RSSI_PIPELINE_KALMAN_MEDIAN5
+typedef RssiPipeline<KalmanStage<RSSI_FILTER_Q, RSSI_FILTER_R>, MedianStage<5>> LapTimerPipeline;
+#elif RSSI_PIPELINE == RSSI_PIPELINE_KALMAN_EMA
+typedef RssiPipeline<KalmanStage<RSSI_FILTER_Q, RSSI_FILTER_R>, EmaStage<2>> LapTimerPipeline;
+#elif RSSI_PIPELINE == RSSI_PIPELINE_MEDIAN3_AVG3
+typedef RssiPipeline<MedianStage<3>, MovingAverageStage<3>> LapTimerPipeline;
+#else
+#error "Unknown RSSI_PIPELINE"
+#endif
+
+#if RSSI_PEAK_VALIDATOR == RSSI_PEAK_MARGIN
+typedef PeakMarginValidator<5> LapTimerPeakValidator;
+#elif RSSI_PEAK_VALIDATOR == RSSI_PEAK_HYSTERESIS
+typedef HysteresisValidator LapTimerPeakValidator;
+#else
+#error "Unknown RSSI_PEAK_VALIDATOR"
+#endif
+
+#endif
@@ -0,0 +1,270 @@
+#include "rssirecorder.h"
+
+#include "debug.h"
+
+RssiRecorder::RssiRecorder()
+    : storage(nullptr), writerTask(NULL), queue(NULL), bufferSize(0), active(0), fill(0),
+      header(), samples(0), overruns(0), recording(false), appending(false) {
+    buffers[0] = nullptr;
+    buffers[1] = nullptr;
+    bufferBusy[0].store(false);
+    bufferBusy[1].store(false);
+}
+
+void RssiRecorder::init(Storage* storageBackend) {
+    storage = storageBackend;
+}
+
+bool RssiRecorder::allocate() {
+    // On the first recording, so units that never record spend no RAM on it
+    if (buffers[0]) return true;
+
+#ifdef BOARD_HAS_PSRAM
+    if (psramFound()) {
+        buffers[0] = (uint8_t*)ps_malloc(RSSIREC_BUFFER_PSRAM);
+        buffers[1] = (uint8_t*)ps_malloc(RSSIREC_BUFFER_PSRAM);
+        if (buffers[0] && buffers[1]) {
+            bufferSize = RSSIREC_BUFFER_PSRAM;
+        } else {
+            free(buffers[0]);
+            free(buffers[1]);
+            buffers[0] = nullptr;
+            buffers[1] = nullptr;
+        }
+    }
+#endif
+    if (!buffers[0]) {
+        buffers[0] = (uint8_t*)malloc(RSSIREC_BUFFER);
+        buffers[1] = (uint8_t*)malloc(RSSIREC_BUFFER);
+        if (!buffers[0] || !buffers[1]) {
+            free(buffers[0]);
+            free(buffers[1]);
+            buffers[0] = nullptr;
+            buffers[1] = nullptr;
+            DEBUG("RssiRecorder: failed to allocate buffers\n");
+            return false;
+        }
+        bufferSize = RSSIREC_BUFFER;
+    }
+
+    queue = xQueueCreate(RSSIREC_QUEUE_LEN, sizeof(job_t));
+    // Core 0 with the other services, away from the timing loop
+    if (!queue || xTaskCreatePinnedToCore(writerLoop, "rssiRecTask", RSSIREC_TASK_STACK, this,
+                                          RSSIREC_TASK_PRIORITY, &writerTask, 0) != pdPASS) {
+        DEBUG("RssiRecorder: failed to start writer task\n");
+        if (queue) {
+            vQueueDelete(queue);
+            queue = NULL;
+        }
+        free(buffers[0]);
+        free(buffers[1]);
+        buffers[0] = nullptr;
+        buffers[1] = nullptr;
+        return false;
+    }
+
+    DEBUG("RssiRecorder: 2 x %u byte buffers\n", bufferSize);
+    return true;
+}
+
+bool RssiRecorder::begin(uint32_t raceTimestamp, uint16_t frequency, uint8_t enterRssi, uint8_t exitRssi) {
+    end();
+    if (!storage || !storage->isSDAvailable() || !allocate()) {
+        return false;
+    }
+
+    header.magic = RSSIREC_MAGIC;
+    header.version = RSSIREC_VERSION;
+    header.sampleSize = sizeof(rssirec_sample_t);
+    header.raceTimestamp = raceTimestamp;
+    header.startMs = millis();
+    header.samples = 0;
+    header.overruns = 0;
+    header.frequency = frequency;
+    header.enterRssi = enterRssi;
+    header.exitRssi = exitRssi;
+    header.reserved = 0;
+
+    job_t job;
+    job.type = RSSIREC_JOB_OPEN;
+    job.header = header;
+    if (!post(job, pdMS_TO_TICKS(100))) {
+        return false;
+    }
+
+    samples = 0;
+    overruns = 0;
+    fill = 0;
+    // The previous race may still be landing from one buffer
+    active = bufferBusy[0].load() ? 1 : 0;
+    recording.store(true);
+    DEBUG("RssiRecorder: recording race %u\n", raceTimestamp);
+    return true;
+}
+
+void RssiRecorder::end() {
+    if (!recording.exchange(false)) {
+        return;
+    }
+    while (appending.load()) {
+        delay(1);
+    }
+
+    if (fill > 0) {
+        submit(active, fill);
+        fill = 0;
+    }
+
+    header.samples = samples;
+    header.overruns = overruns;
+    job_t job;
+    job.type = RSSIREC_JOB_CLOSE;
+    job.header = header;
+    post(job, pdMS_TO_TICKS(100));
+    DEBUG("RssiRecorder: race %u, %u samples, %u overruns\n", header.raceTimestamp, samples, overruns);
+}
+
+void RssiRecorder::append(uint32_t timeUs, uint8_t raw, uint8_t filtered, uint8_t state, uint8_t lap) {
+    appending.store(true);
+    if (!recording.load()) {
+        appending.store(false);
+        return;
+    }
+
+    if (bufferBusy[active].load()) {
+        // The writer is behind; drop rather than wait for the card
+        overruns = overruns + 1;
+    } else {
+        rssirec_sample_t* sample = (rssirec_sample_t*)(buffers[active] + fill);
+        sample->timeUs = timeUs;
+        sample->raw = raw;
+        sample->filtered = filtered;
+        sample->state = state;
+        sample->lap = lap;
+        fill += sizeof(rssirec_sample_t);
+        samples = samples + 1;
+
+        if (fill + sizeof(rssirec_sample_t) > bufferSize) {
+            submit(active, fill);
+            active ^= 1;
+            fill = 0;
+        }
+    }
+
+    appending.store(false);
+}
+
+bool RssiRecorder::post(job_t& job, TickType_t wait) {
+    if (xQueueSend(queue, &job, wait) != pdTRUE) {
+        DEBUG("RssiRecorder: writer queue full\n");
+        return false;
+    }
+    return true;
+}
+
+void RssiRecorder::submit(uint8_t buffer, uint32_t length) {
+    bufferBusy[buffer].store(true);
+    job_t job;
+    job.type = RSSIREC_JOB_WRITE;
+    job.buffer = buffer;
+    job.length = length;
+    if (!post(job, 0)) {
+        uint32_t lost = length / sizeof(rssirec_sample_t);
+        samples = samples - lost;
+        overruns = overruns + lost;
+        bufferBusy[buffer].store(false);
+    }
+}
+
+void RssiRecorder::runJob(const job_t& job) {
+    switch (job.type) {
+        case RSSIREC_JOB_OPEN:
+            if (file) {
+                file.close();
+            }
+            storage->mkdir(RSSIREC_DIR);
+            file = storage->openFile(recordingPath(job.header.raceTimestamp), "w");
+            if (!file) {
+                DEBUG("RssiRecorder: failed to create %s\n", recordingPath(job.header.raceTimestamp).c_str());
+                break;
+            }
+            file.write((const uint8_t*)&job.header, sizeof(job.header));
+            break;
+        case RSSIREC_JOB_WRITE:
+            if (file && file.write(buffers[job.buffer], job.length) != job.length) {
+                DEBUG("RssiRecorder: write failed\n");
+            }
+            bufferBusy[job.buffer].store(false);
+            break;
+        case RSSIREC_JOB_CLOSE:
+            if (file) {
+                // Final counts into the header written at the start
+                file.seek(0);
+                file.write((const uint8_t*)&job.header, sizeof(job.header));
+                file.close();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void RssiRecorder::writerLoop(void* arg) {
+    RssiRecorder* recorder = static_cast<RssiRecorder*>(arg);
+    job_t job;
+    for (;;) {
+        if (xQueueReceive(recorder->queue, &job, portMAX_DELAY) == pdTRUE) {
+            recorder->runJob(job);
+        }
+    }
+}
+
+void RssiRecorder::listToJson(Print& out) {
+    out.printf("{\"recording\":%s,\"raceTimestamp\":%u,\"samples\":%u,\"overruns\":%u,\"recordings\":[",
+               recording.load() ? "true" : "false", header.raceTimestamp, samples, overruns);
+
+    std::vector<String> files;
+    if (storage && storage->isSDAvailable() && storage->listDir(RSSIREC_DIR, files)) {
+        bool first = true;
+        for (const String& name : files) {
+            if (!name.endsWith(".bin")) {
+                continue;
+            }
+            String path = String(RSSIREC_DIR) + "/" + name;
+            File f = storage->openFile(path, "r");
+            if (!f) {
+                continue;
+            }
+            size_t size = f.size();
+            rssirec_header_t fileHeader;
+            bool valid = f.read((uint8_t*)&fileHeader, sizeof(fileHeader)) == sizeof(fileHeader) &&
+                         fileHeader.magic == RSSIREC_MAGIC;
+            f.close();
+            if (!valid) {
+                continue;
+            }
+            if (!first) {
+                out.print(",");
+            }
+            out.printf("{\"timestamp\":%u,\"size\":%u,\"samples\":%u,\"overruns\":%u,\"frequency\":%u}",
+                       fileHeader.raceTimestamp, (unsigned)size, fileHeader.samples,
+                       fileHeader.overruns, fileHeader.frequency);
+            first = false;
+        }
+    }
+    out.print("]}");
+}
+
+bool RssiRecorder::deleteRecording(uint32_t raceTimestamp) {
+    if (!storage || (recording.load() && header.raceTimestamp == raceTimestamp)) {
+        return false;
+    }
+    storage->deleteFileAsync(recordingPath(raceTimestamp));
+    return true;
+}
+
+String RssiRecorder::recordingPath(uint32_t raceTimestamp) {
+    char path[32];
+    snprintf(path, sizeof(path), RSSIREC_DIR "/%u.bin", (unsigned)raceTimestamp);
+    return String(path);
+}
@@ -0,0 +1,130 @@
+#ifndef RSSIRECORDER_H
+#define RSSIRECORDER_H
+
+/**
+ * Raw RSSI race recording to SD
+ *
+ * Every sample the timing loop takes during a race - raw ADC value,
+ * filtered value, timer state and lap count - goes into one of two RAM
+ * buffers. A full buffer is handed to a writer task and the loop carries
+ * on in the other one, so it never waits for the card. If the writer
+ * still holds the other buffer when the current one fills, samples are
+ * dropped and counted as overruns rather than blocking timing.
+ *
+ * One file per race, RSSIREC_DIR/<race timestamp>.bin: an rssirec_header_t
+ * (rewritten with the final counts when the race stops) followed by
+ * rssirec_sample_t records.
+ *
+ * Needs an SD card; without one begin() does nothing.
+ *
+ * This is the one writer that doesn't go through the Storage worker. The
+ * worker's jobs replace whole files and coalesce by path. A recording is
+ * one file held open for the whole race and appended to every buffer, and
+ * it must never queue behind race saves or image uploads. Opening,
+ * appending and closing stay on this writer task. Deleting a recording
+ * (deleteRecording(), and RaceHistory when its race is deleted) goes
+ * through the worker like any other delete.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <atomic>
+
+#include "storage.h"
+
+#define RSSIREC_DIR "/rawrssi"
+#define RSSIREC_BUFFER 16384        // Bytes per buffer, internal RAM
+#define RSSIREC_BUFFER_PSRAM 65536  // Bytes per buffer with PSRAM
+#define RSSIREC_QUEUE_LEN 4
+#define RSSIREC_TASK_STACK 4096
+#define RSSIREC_TASK_PRIORITY 2     // Above the storage task, the card is shared
+
+#define RSSIREC_MAGIC 0x31535252  // "RRS1"
+#define RSSIREC_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sampleSize;     // sizeof(rssirec_sample_t)
+    uint32_t raceTimestamp;  // Unix time, same as the race in RaceHistory
+    uint32_t startMs;        // millis() at race start
+    uint32_t samples;        // Written at the end of the race
+    uint32_t overruns;       // Samples dropped because the writer fell behind
+    uint16_t frequency;
+    uint8_t enterRssi;
+    uint8_t exitRssi;
+    uint32_t reserved;
+} rssirec_header_t;
+
+typedef struct {
+    uint32_t timeUs;   // micros()
+    uint8_t raw;
+    uint8_t filtered;  // As used for lap detection
+    uint8_t state;     // laptimer_state_e
+    uint8_t lap;       // Laps completed, low byte
+} rssirec_sample_t;
+
+class RssiRecorder {
+   public:
+    RssiRecorder();
+    void init(Storage* storage);
+
+    // Race start/stop, any task
+    bool begin(uint32_t raceTimestamp, uint16_t frequency, uint8_t enterRssi, uint8_t exitRssi);
+    void end();
+
+    // Timing loop only, never waits
+    void append(uint32_t timeUs, uint8_t raw, uint8_t filtered, uint8_t state, uint8_t lap);
+
+    bool isRecording() const { return recording.load(); }
+    uint32_t getSamples() const { return samples; }
+    uint32_t getOverruns() const { return overruns; }
+    uint32_t getRaceTimestamp() const { return header.raceTimestamp; }
+
+    // Recordings on the card, with their race timestamps and sizes
+    void listToJson(Print& out);
+    bool deleteRecording(uint32_t raceTimestamp);
+    static String recordingPath(uint32_t raceTimestamp);
+
+   private:
+    typedef enum : uint8_t {
+        RSSIREC_JOB_OPEN,
+        RSSIREC_JOB_WRITE,
+        RSSIREC_JOB_CLOSE
+    } job_type_e;
+
+    typedef struct {
+        job_type_e type;
+        uint8_t buffer;
+        uint32_t length;
+        rssirec_header_t header;  // OPEN and CLOSE, as of when they were queued
+    } job_t;
+
+    Storage* storage;
+    TaskHandle_t writerTask;
+    QueueHandle_t queue;
+    File file;
+
+    uint8_t* buffers[2];
+    uint32_t bufferSize;
+    std::atomic<bool> bufferBusy[2];  // Owned by the writer until written
+    uint8_t active;
+    uint32_t fill;
+
+    rssirec_header_t header;
+    volatile uint32_t samples;
+    volatile uint32_t overruns;
+    std::atomic<bool> recording;
+    std::atomic<bool> appending;  // Lets end() wait out an append in progress
+
+    bool allocate();
+    bool post(job_t& job, TickType_t wait);
+    void submit(uint8_t buffer, uint32_t length);
+    void runJob(const job_t& job);
+    static void writerLoop(void* arg);
+};
+
+#endif
@@ -2,8 +2,16 @@
 
 #include <Arduino.h>
 
+#include "bands.h"
 #include "debug.h"
 
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+// SPI2 (FSPI) everywhere: the S3 SD card uses SPIClass(HSPI), which the
+// Arduino core maps to SPI3_HOST there, the C3 has no SPI3, and on the
+// original ESP32 the default SPI object is on SPI3 (VSPI)
+#define RX5808_SPI_HOST SPI2_HOST
+#endif
+
 RX5808::RX5808(uint8_t _rssiInputPin, uint8_t _rx5808DataPin, uint8_t _rx5808SelPin, uint8_t _rx5808ClkPin) {
     rssiInputPin = _rssiInputPin;
     rx5808DataPin = _rx5808DataPin;
@@ -14,13 +22,26 @@ RX5808::RX5808(uint8_t _rssiInputPin, uint8_t _rx5808DataPin, uint8_t _rx5808Sel
 
 void RX5808::init() {
     pinMode(rssiInputPin, INPUT);
-    pinMode(rx5808DataPin, OUTPUT);
-    pinMode(rx5808SelPin, OUTPUT);
-    pinMode(rx5808ClkPin, OUTPUT);
-    digitalWrite(rx5808SelPin, HIGH);
-    digitalWrite(rx5808ClkPin, LOW);
-    digitalWrite(rx5808DataPin, LOW);
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+    useSpi = initSpi();
+    if (!useSpi) {
+        DEBUG("RX5808 SPI driver unavailable, falling back to bit-banging\n");
+    }
+#endif
+    if (!useSpi) {
+        pinMode(rx5808DataPin, OUTPUT);
+        pinMode(rx5808SelPin, OUTPUT);
+        pinMode(rx5808ClkPin, OUTPUT);
+        digitalWrite(rx5808SelPin, HIGH);
+        digitalWrite(rx5808ClkPin, LOW);
+        digitalWrite(rx5808DataPin, LOW);
+    }
     resetRxModule();
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+    if (useSpi) {
+        collectSpi(portMAX_DELAY);  // Boot only: reset and setup written before going on
+    }
+#endif
     // Don't power down on init - leave module powered up and ready
     // Set currentFrequency to 0 to force initial frequency programming
     currentFrequency = 0;
@@ -30,6 +51,16 @@ void RX5808::init() {
 }
 
 void RX5808::handleFrequencyChange(uint32_t currentTimeMs, uint16_t potentiallyNewFreq) {
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+    if (useSpi) {
+        collectSpi(0);
+    }
+#endif
+    if (hopCount > 1) {
+        handleHop(currentTimeMs);
+        return;
+    }
+
     if ((currentFrequency != potentiallyNewFreq) && ((currentTimeMs - lastSetFreqTimeMs) > RX5808_MIN_BUSTIME)) {
         lastSetFreqTimeMs = currentTimeMs;
         setFrequency(potentiallyNewFreq);
@@ -43,7 +74,105 @@ void RX5808::handleFrequencyChange(uint32_t currentTimeMs, uint16_t potentiallyN
     }
 }
 
+void RX5808::setHopPlan(const uint16_t *frequencies, uint8_t count, uint16_t dwellMs) {
+    if (count > RX5808_MAX_HOPS) count = RX5808_MAX_HOPS;
+    if (dwellMs < RX5808_MIN_DWELL) dwellMs = RX5808_MIN_DWELL;
+
+    if (count < 2) {
+        if (hopCount > 1) {
+            hopCount = 0;
+            if (hopSeq & 1) hopSeq = hopSeq + 1;
+            currentFrequency = 0;  // Back to the caller's frequency on the next call
+            DEBUG("RX5808 hopping stopped\n");
+        }
+        return;
+    }
+    if (hopCount == count && hopDwellMs == dwellMs && memcmp(hopPlan, frequencies, count * sizeof(uint16_t)) == 0) {
+        return;
+    }
+
+    if (!(hopSeq & 1)) hopSeq = hopSeq + 1;
+    memcpy(hopPlan, frequencies, count * sizeof(uint16_t));
+    hopDwellMs = dwellMs;
+    hopSlot = 0;
+    hopCount = count;
+    hopCycleMs = 0;
+    DEBUG("RX5808 hopping between %u frequencies, %u ms dwell\n", count, dwellMs);
+    writeFrequency(hopPlan[0]);
+    lastSetFreqTimeMs = millis();
+    hopCycleStartMs = lastSetFreqTimeMs;
+}
+
+void RX5808::handleHop(uint32_t currentTimeMs) {
+    if (hopSeq & 1) {
+        // Tune time counts from the end of the write; the frequency is not
+        // read back while hopping, every hop would pay for it
+        if ((currentTimeMs - lastSetFreqTimeMs) > RX5808_MIN_TUNETIME) {
+            recentSetFreqFlag = false;
+            hopDwellStartMs = currentTimeMs;
+            hopSeq = hopSeq + 1;
+        }
+        return;
+    }
+    if ((currentTimeMs - hopDwellStartMs) < hopDwellMs) {
+        return;
+    }
+
+    // Dwell plus tune time is always longer than RX5808_MIN_BUSTIME
+    uint8_t next = (hopSlot + 1) % hopCount;
+    if (next == 0) {
+        hopCycleMs = currentTimeMs - hopCycleStartMs;
+        hopCycleStartMs = currentTimeMs;
+    }
+    hopSeq = hopSeq + 1;  // Samples from here on belong to no slot
+    hopSlot = next;
+    // Bit-banged, the write holds the service core for about 25 ms per hop
+    uint32_t writeStartUs = micros();
+    writeFrequency(hopPlan[next]);
+    hopWriteUs = micros() - writeStartUs;
+    lastSetFreqTimeMs = millis();
+}
+
+bool RX5808::readHopSample(uint8_t &slot, uint8_t &rssi) {
+    uint32_t seq = hopSeq;
+    if (seq & 1) {
+        return false;
+    }
+    slot = hopSlot;
+    rssi = readRssi();
+    // A hop started meanwhile: the reading may be from either frequency
+    return hopSeq == seq;
+}
+
 bool RX5808::verifyFrequency() {
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+    if (useSpi) {
+#if RX5808_SPI_DMA && CONFIG_IDF_TARGET_ESP32
+        // The original ESP32 can't do a write then read transaction with DMA
+        return true;
+#else
+        // Queued here, checked by collectSpi()
+        if (verifyPending) {
+            return false;
+        }
+        memset(&spiRead, 0, sizeof(spiRead));
+        spiRead.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+        spiRead.length = 5;     // Register 0x1, read
+        spiRead.rxlength = 20;  // D0-D19
+        spiRead.tx_data[0] = 0x1;
+        if (spi_device_queue_trans(spiDevice, &spiRead, 0) != ESP_OK) {
+            DEBUG("RX5808 SPI queue full, frequency not verified\n");
+            return false;
+        }
+        spiPending++;
+        verifyPending = true;
+        // Queue order: the read sees the last write before it, not
+        // whatever a hop has tuned by the time it completes
+        verifyExpected = currentRegister;
+        return true;
+#endif
+    }
+#endif
     // Start of Read Reg code :
     // Verify read HEX value in RX5808 module Frequency Register 0x01
     uint16_t vtxRegisterHex = 0;
@@ -90,7 +219,7 @@ bool RX5808::verifyFrequency() {
     digitalWrite(rx5808ClkPin, LOW);
     digitalWrite(rx5808DataPin, LOW);
 
-    if (vtxRegisterHex != freqMhzToRegVal(currentFrequency)) {
+    if (vtxRegisterHex != currentRegister) {
         DEBUG("RX5808 frequency not matching, register = %u, currentFreq = %u\n", vtxRegisterHex, currentFrequency);
         return false;
     }
@@ -101,7 +230,10 @@ bool RX5808::verifyFrequency() {
 // Set frequency on RX5808 module to given value
 void RX5808::setFrequency(uint16_t vtxFreq) {
     DEBUG("Setting frequency to %u\n", vtxFreq);
+    writeFrequency(vtxFreq);
+}
 
+void RX5808::writeFrequency(uint16_t vtxFreq) {
     currentFrequency = vtxFreq;
 
     if (vtxFreq == POWER_DOWN_FREQ_MHZ)  // frequency value to power down rx module
@@ -115,49 +247,27 @@ void RX5808::setFrequency(uint16_t vtxFreq) {
         rxPoweredDown = false;
     }
 
-    // Get the hex value to send to the rx module
-    uint16_t vtxHex = freqMhzToRegVal(vtxFreq);
-
-    // Channel data from the lookup table, 20 bytes of register data are sent, but the
-    // MSB 4 bits are zeros register address = 0x1, write, data0-15=vtxHex data15-19=0x0
-    rx5808SerialEnableHigh();
-    rx5808SerialEnableLow();
-
-    rx5808SerialSendBit1();  // Register 0x1
-    rx5808SerialSendBit0();
-    rx5808SerialSendBit0();
-    rx5808SerialSendBit0();
-
-    rx5808SerialSendBit1();  // Write to register
-
-    // D0-D15, note: loop runs backwards as more efficent on AVR
-    uint8_t i;
-    for (i = 16; i > 0; i--) {
-        if (vtxHex & 0x1) {  // Is bit high or low?
-            rx5808SerialSendBit1();
-        } else {
-            rx5808SerialSendBit0();
-        }
-        vtxHex >>= 1;  // Shift bits along to check the next one
+    // 20 bits of register data are sent, but the MSB 4 bits are zeros
+    // register address = 0x1, write, data0-15=vtxHex data15-19=0x0
+    currentRegister = freqMhzToRegVal(vtxFreq);
+    writeRegister(0x1, currentRegister);
+    if (!useSpi) {
+        delay(2);
+        digitalWrite(rx5808ClkPin, LOW);
+        digitalWrite(rx5808DataPin, LOW);
     }
 
-    for (i = 4; i > 0; i--)  // Remaining D16-D19
-        rx5808SerialSendBit0();
-
-    rx5808SerialEnableHigh();  // Finished clocking data in
-    delay(2);
-
-    digitalWrite(rx5808ClkPin, LOW);
-    digitalWrite(rx5808DataPin, LOW);
-
     recentSetFreqFlag = true;  // indicate need to wait RX5808_MIN_TUNETIME before reading RSSI
 }
 
 // Read the RSSI value
 uint8_t RX5808::readRssi() {
-    volatile uint16_t rssi = 0;
+    if (recentSetFreqFlag) return 0;  // RSSI is unstable
+    return sampleRssi();
+}
 
-    if (recentSetFreqFlag) return rssi;  // RSSI is unstable
+uint8_t RX5808::sampleRssi() {
+    volatile uint16_t rssi = 0;
 
     // for (uint8_t i = 0; i < RSSI_READS; i++) {
     //   rssi += map(analogRead(rssiInputPin), 0, analogRead(vbatPin), 0, 4095);
@@ -201,50 +311,121 @@ void RX5808::rx5808SerialEnableHigh() {
     delayMicroseconds(200);
 }
 
-// Reset rx5808 module to wake up from power down
-void RX5808::resetRxModule() {
+// Write a register: address (LSB first), write bit, 20 data bits (LSB first)
+void RX5808::writeRegister(uint8_t address, uint32_t data) {
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+    if (useSpi) {
+        collectSpi(0);
+        if (spiPending >= RX5808_SPI_QUEUE) {
+            collectSpi(portMAX_DELAY);  // Only if the bus has stalled
+        }
+        spi_transaction_t &t = spiWrites[spiNextWrite];
+        spiNextWrite = (spiNextWrite + 1) % RX5808_SPI_QUEUE;
+
+        uint32_t word = (address & 0xF) | (1UL << 4) | ((data & 0xFFFFF) << 5);
+        memset(&t, 0, sizeof(t));
+        t.flags = SPI_TRANS_USE_TXDATA;
+        t.length = 25;
+        t.tx_data[0] = word & 0xFF;
+        t.tx_data[1] = (word >> 8) & 0xFF;
+        t.tx_data[2] = (word >> 16) & 0xFF;
+        t.tx_data[3] = (word >> 24) & 0xFF;
+        if (spi_device_queue_trans(spiDevice, &t, 0) == ESP_OK) {
+            spiPending++;
+        } else {
+            DEBUG("RX5808 SPI queue full, register %u not written\n", address);
+        }
+        return;
+    }
+#endif
     rx5808SerialEnableHigh();
     rx5808SerialEnableLow();
 
-    rx5808SerialSendBit1();  // Register 0xF
-    rx5808SerialSendBit1();
-    rx5808SerialSendBit1();
-    rx5808SerialSendBit1();
+    for (uint8_t i = 0; i < 4; i++) {
+        if ((address >> i) & 0x1) {
+            rx5808SerialSendBit1();
+        } else {
+            rx5808SerialSendBit0();
+        }
+    }
 
     rx5808SerialSendBit1();  // Write to register
 
-    for (uint8_t i = 20; i > 0; i--)
-        rx5808SerialSendBit0();
+    for (uint8_t i = 20; i > 0; i--) {
+        if (data & 0x1) {  // Is bit high or low?
+            rx5808SerialSendBit1();
+        } else {
+            rx5808SerialSendBit0();
+        }
+        data >>= 1;  // Shift bits along to check the next one
+    }
 
     rx5808SerialEnableHigh();  // Finished clocking data in
-
-    setupRxModule();
 }
 
-// Set power options on the rx5808 module
-void RX5808::setRxModulePower(uint32_t options) {
-    rx5808SerialEnableHigh();
-    rx5808SerialEnableLow();
-
-    rx5808SerialSendBit0();  // Register 0xA
-    rx5808SerialSendBit1();
-    rx5808SerialSendBit0();
-    rx5808SerialSendBit1();
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+bool RX5808::initSpi() {
+    // Extra receivers share DATA and CLOCK: one bus, a device per SELECT pin
+    static bool busReady = false;
+    if (!busReady) {
+        spi_bus_config_t bus = {};
+        bus.mosi_io_num = rx5808DataPin;  // Both ways, the module has a single data line
+        bus.miso_io_num = -1;
+        bus.sclk_io_num = rx5808ClkPin;
+        bus.quadwp_io_num = -1;
+        bus.quadhd_io_num = -1;
+        bus.max_transfer_sz = 0;
+        if (spi_bus_initialize(RX5808_SPI_HOST, &bus, RX5808_SPI_DMA ? SPI_DMA_CH_AUTO : SPI_DMA_DISABLED) != ESP_OK) {
+            return false;
+        }
+        busReady = true;
+    }
 
-    rx5808SerialSendBit1();  // Write to register
+    spi_device_interface_config_t device = {};
+    device.mode = 0;
+    device.clock_speed_hz = RX5808_SPI_HZ;
+    device.spics_io_num = rx5808SelPin;
+    device.flags = SPI_DEVICE_3WIRE | SPI_DEVICE_HALFDUPLEX | SPI_DEVICE_BIT_LSBFIRST;
+    device.queue_size = RX5808_SPI_QUEUE + 1;  // Writes plus one read-back
+    device.cs_ena_pretrans = 2;
+    device.cs_ena_posttrans = 2;
+    return spi_bus_add_device(RX5808_SPI_HOST, &device, &spiDevice) == ESP_OK;
+}
 
-    for (uint8_t i = 20; i > 0; i--) {
-        if (options & 0x1) {  // Is bit high or low?
-            rx5808SerialSendBit1();
+// Reclaims finished transactions and checks a read-back when it lands
+void RX5808::collectSpi(TickType_t wait) {
+    while (spiPending > 0) {
+        spi_transaction_t *done;
+        if (spi_device_get_trans_result(spiDevice, &done, wait) != ESP_OK) {
+            return;
+        }
+        spiPending--;
+        if (done != &spiRead) {
+            continue;
+        }
+        verifyPending = false;
+        uint16_t vtxRegisterHex = spiRead.rx_data[0] | (spiRead.rx_data[1] << 8);
+        if (vtxRegisterHex != verifyExpected) {
+            DEBUG("RX5808 frequency not matching, register = %u, expected = %u\n", vtxRegisterHex, verifyExpected);
         } else {
-            rx5808SerialSendBit0();
+            DEBUG("RX5808 frequency verified properly\n");
         }
-        options >>= 1;  // Shift bits along to check the next one
     }
+}
+#endif
 
-    rx5808SerialEnableHigh();  // Finished clocking data in
+// Reset rx5808 module to wake up from power down
+void RX5808::resetRxModule() {
+    writeRegister(0xF, 0);  // Register 0xF, all zeros
+    setupRxModule();
+}
 
-    digitalWrite(rx5808DataPin, LOW);
+// Set power options on the rx5808 module
+void RX5808::setRxModulePower(uint32_t options) {
+    writeRegister(0xA, options);  // Register 0xA
+    if (!useSpi) {
+        digitalWrite(rx5808DataPin, LOW);
+    }
 }
 
 // Power down rx5808 module
@@ -257,11 +438,8 @@ void RX5808::setupRxModule() {
     setRxModulePower(0b11010000110111110011);
 }
 
-// Calculate rx5808 register hex value for given frequency in MHz
+// rx5808 register value for a frequency in MHz: the band table's entry
+// for band plan frequencies, computed for the rest (see bands.h)
 uint16_t RX5808::freqMhzToRegVal(uint16_t freqInMhz) {
-    uint16_t tf, N, A;
-    tf = (freqInMhz - 479) / 2;
-    N = tf / 32;
-    A = tf % 32;
-    return (N << (uint16_t)7) + A;
+    return Bands::registerValue(freqInMhz);
 }
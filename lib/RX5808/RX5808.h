@@ -3,10 +3,28 @@
 
 #include <stdint.h>
 
+// Register interface, chosen per build with -DRX5808_DRIVER=...
+#define RX5808_DRIVER_BITBANG 0  // GPIO, blocks for ~25 ms per register write
+#define RX5808_DRIVER_SPI 1      // SPI peripheral, transactions queued and collected later
+#ifndef RX5808_DRIVER
+#define RX5808_DRIVER RX5808_DRIVER_BITBANG
+#endif
+#ifndef RX5808_SPI_DMA
+#define RX5808_SPI_DMA 0  // -DRX5808_SPI_DMA=1 to run the bus on a DMA channel
+#endif
+#define RX5808_SPI_HZ 100000
+#define RX5808_SPI_QUEUE 4  // Register writes in flight per receiver
+
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+#include <driver/spi_master.h>
+#endif
+
 #define RX5808_MIN_TUNETIME 35    // after set freq need to wait this long before read RSSI
 #define RX5808_MIN_BUSTIME 30     // after set freq need to wait this long before setting again
 #define POWER_DOWN_FREQ_MHZ 1111  // signal to power down the module
 #define RSSI_READS 5              // number of analog RSSI reads per tick
+#define RX5808_MAX_HOPS 4         // pilots one receiver can hop between
+#define RX5808_MIN_DWELL 10       // shortest time on a frequency once tuned, ms
 
 class RX5808 {
    public:
@@ -14,8 +32,24 @@ class RX5808 {
     void init();
     void setFrequency(uint16_t frequency);
     uint8_t readRssi();
+    uint8_t sampleRssi();  // Reads even right after a retune, for callers doing their own settling
+    void writeFrequency(uint16_t frequency);  // setFrequency() without logging
+    void forceRetune() { currentFrequency = 0; }  // Next handleFrequencyChange() reprograms
     void handleFrequencyChange(uint32_t currentTimeMs, uint16_t potentiallyNewFreq);
 
+    // Frequency hopping: handleFrequencyChange() cycles through the plan,
+    // staying dwellMs on each frequency once it has settled, and ignores
+    // its frequency argument. A count below 2 stops hopping. Service core.
+    void setHopPlan(const uint16_t *frequencies, uint8_t count, uint16_t dwellMs);
+    bool isHopping() const { return hopCount > 1; }
+    // Any task; false while retuning, else the RSSI and the plan slot it belongs to
+    bool readHopSample(uint8_t &slot, uint8_t &rssi);
+    uint8_t getHopCount() const { return hopCount; }
+    uint16_t getHopDwellMs() const { return hopDwellMs; }
+    uint32_t getHopCycleMs() const { return hopCycleMs; }  // Last full pass over the plan
+    uint32_t getHopWriteUs() const { return hopWriteUs; }  // Last hop's register write, blocking
+    bool usesSpi() const { return useSpi; }
+
    private:
     uint8_t rx5808DataPin = 0;  // DATA (CH1) output line to RX5808 module
     uint8_t rx5808ClkPin = 0;   // CLK (CH3) output line to RX5808 module
@@ -23,23 +57,50 @@ class RX5808 {
     uint8_t rssiInputPin = 0;   // RSSI input from RX5808
 
     uint16_t currentFrequency = 0;
+    uint16_t currentRegister = 0;  // Written for currentFrequency, what verify expects
+    bool useSpi = false;  // SPI driver built in and its bus came up
 
     bool rxPoweredDown = false;
     bool recentSetFreqFlag = false;
     uint32_t lastSetFreqTimeMs = 0;
 
+    uint16_t hopPlan[RX5808_MAX_HOPS] = {};
+    volatile uint8_t hopCount = 0;
+    volatile uint8_t hopSlot = 0;
+    volatile uint32_t hopSeq = 0;  // Odd from the start of a retune until it has settled
+    uint16_t hopDwellMs = 0;
+    uint32_t hopDwellStartMs = 0;
+    uint32_t hopCycleStartMs = 0;
+    volatile uint32_t hopCycleMs = 0;
+    volatile uint32_t hopWriteUs = 0;
+
     void rx5808SerialSendBit1();
     void rx5808SerialSendBit0();
     void rx5808SerialEnableLow();
     void rx5808SerialEnableHigh();
 
+    void writeRegister(uint8_t address, uint32_t data);  // 4-bit address, 20 data bits
     void setRxModulePower(uint32_t options);
     void resetRxModule();
     void setupRxModule();
     void powerDownRxModule();
     bool verifyFrequency();
+    void handleHop(uint32_t currentTimeMs);
 
     static uint16_t freqMhzToRegVal(uint16_t freqInMhz);
+
+#if RX5808_DRIVER == RX5808_DRIVER_SPI
+    spi_device_handle_t spiDevice = NULL;
+    spi_transaction_t spiWrites[RX5808_SPI_QUEUE];
+    spi_transaction_t spiRead;
+    uint8_t spiNextWrite = 0;
+    uint8_t spiPending = 0;
+    bool verifyPending = false;
+    uint16_t verifyExpected = 0;  // Register value written when the read was queued
+
+    bool initSpi();
+    void collectSpi(TickType_t wait);
+#endif
 };
 
 #endif
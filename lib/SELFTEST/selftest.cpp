@@ -8,8 +8,9 @@
 #include "racehistory.h"
 #include "trackmanager.h"
 #include "webhook.h"
-#include <EEPROM.h>
 #include <LittleFS.h>
+#include <Preferences.h>
+#include <nvs.h>
 #include <WiFi.h>
 #include <Update.h>
 
@@ -48,7 +49,7 @@ bool SelfTest::runAllTests() {
     // SD card failure is not critical - don't fail overall test
 #endif
     
-    // Test EEPROM
+    // Test config storage (NVS)
     TestResult eepromTest = testEEPROM();
     results.push_back(eepromTest);
     if (!eepromTest.passed) allPassed = false;
@@ -81,9 +82,15 @@ TestResult SelfTest::testStorage() {
         return result;
     }
     
-    // Test write and read
-    String testData = "{\"test\":\"data\"}";
-    bool writeSuccess = storage->writeFile("/test_selftest.txt", testData);
+    // Test streamed write and chunked read back. The pattern spans several
+    // stream buffers so chunk boundaries are exercised too.
+    const size_t testSize = STORAGE_STREAM_BUFFER * 2 + 37;
+    bool writeSuccess = storage->writeStream("/test_selftest.txt", [testSize](Print& out) {
+        for (size_t i = 0; i < testSize; i++) {
+            out.write((uint8_t)(i * 7));
+        }
+        return true;
+    });
     
     if (!writeSuccess) {
         result.passed = false;
@@ -92,10 +99,25 @@ TestResult SelfTest::testStorage() {
         return result;
     }
     
-    String readData;
-    bool readSuccess = storage->readFile("/test_selftest.txt", readData);
+    uint8_t chunk[64];
+    size_t offset = 0;
+    bool readSuccess = true;
+    while (offset < testSize && readSuccess) {
+        size_t bytesRead = storage->readChunk("/test_selftest.txt", offset, chunk, sizeof(chunk));
+        if (bytesRead == 0) {
+            readSuccess = false;
+            break;
+        }
+        for (size_t i = 0; i < bytesRead; i++) {
+            if (chunk[i] != (uint8_t)((offset + i) * 7)) {
+                readSuccess = false;
+                break;
+            }
+        }
+        offset += bytesRead;
+    }
     
-    if (!readSuccess || readData != testData) {
+    if (!readSuccess || offset != testSize) {
         result.passed = false;
         result.details = "Read failed or data mismatch";
         result.duration_ms = millis() - start;
@@ -204,22 +226,23 @@ TestResult SelfTest::testLittleFS() {
 
 TestResult SelfTest::testEEPROM() {
     TestResult result;
-    result.name = "EEPROM";
+    result.name = "Config (NVS)";
     uint32_t start = millis();
     
-    // Write test pattern
-    uint8_t testValue = 0xAA;
-    uint8_t testAddr = EEPROM_RESERVED_SIZE - 1; // Use last byte
-    uint8_t originalValue = EEPROM.read(testAddr);
-    
-    EEPROM.write(testAddr, testValue);
-    EEPROM.commit();
-    
-    uint8_t readValue = EEPROM.read(testAddr);
+    // Round-trip a probe key in its own namespace, away from the config
+    Preferences probe;
+    if (!probe.begin("selftest", false)) {
+        result.passed = false;
+        result.details = "NVS namespace open failed";
+        result.duration_ms = millis() - start;
+        return result;
+    }
     
-    // Restore original value
-    EEPROM.write(testAddr, originalValue);
-    EEPROM.commit();
+    uint8_t testValue = 0xAA;
+    probe.putUChar("probe", testValue);
+    uint8_t readValue = probe.getUChar("probe", 0);
+    probe.remove("probe");
+    probe.end();
     
     if (readValue != testValue) {
         result.passed = false;
@@ -228,8 +251,14 @@ TestResult SelfTest::testEEPROM() {
         return result;
     }
     
+    nvs_stats_t stats;
     result.passed = true;
-    result.details = String("Size: ") + String(EEPROM_RESERVED_SIZE) + " bytes";
+    if (nvs_get_stats(NULL, &stats) == ESP_OK) {
+        result.details = String("Entries: ") + String(stats.used_entries) + " used, " +
+                        String(stats.free_entries) + " free";
+    } else {
+        result.details = "Read/write OK";
+    }
     result.duration_ms = millis() - start;
     return result;
 }
@@ -345,7 +374,7 @@ TestResult SelfTest::testAudio(Buzzer* buzzer) {
     delay(150);
     
     // Check if audio announcer JavaScript exists
-    bool audioJsExists = LittleFS.exists("/audio-announcer.js");
+    bool audioJsExists = webFileExists("audio-announcer.js");
     
     if (!audioJsExists) {
         result.passed = false;
@@ -417,15 +446,36 @@ TestResult SelfTest::testRaceHistory(RaceHistory* history) {
     return result;
 }
 
+bool SelfTest::webFileExists(const char* name) {
+    String path = String("/") + name;
+    if (LittleFS.exists(path) || LittleFS.exists(path + ".gz")) {
+        return true;
+    }
+    
+    // Fingerprinted by tools/build_web_assets.py
+    File file = LittleFS.open("/assets/manifest.json", "r");
+    if (!file) {
+        return false;
+    }
+    DynamicJsonDocument doc(1024);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error || !doc.containsKey(name)) {
+        return false;
+    }
+    String hashed = String("/") + doc[name].as<String>();
+    return LittleFS.exists(hashed + ".gz") || LittleFS.exists(hashed);
+}
+
 TestResult SelfTest::testWebServer() {
     TestResult result;
     result.name = "Web Server";
     uint32_t start = millis();
     
     // Check if index.html exists
-    bool indexExists = LittleFS.exists("/index.html");
-    bool scriptExists = LittleFS.exists("/script.js");
-    bool styleExists = LittleFS.exists("/style.css");
+    bool indexExists = webFileExists("index.html");
+    bool scriptExists = webFileExists("script.js");
+    bool styleExists = webFileExists("style.css");
     
     if (!indexExists || !scriptExists || !styleExists) {
         result.passed = false;
@@ -510,7 +560,7 @@ TestResult SelfTest::testUSB() {
     bool connected = (bool)Serial;
     
     // Check USB transport files
-    bool transportFileExists = LittleFS.exists("/usb-transport.js");
+    bool transportFileExists = webFileExists("usb-transport.js");
     
     result.passed = true;
     result.details = String("CDC ") + (connected ? "connected" : "disconnected") + 
@@ -577,7 +627,7 @@ TestResult SelfTest::testTransport() {
     uint32_t start = millis();
     
     // Check transport files
-    bool usbTransportExists = LittleFS.exists("/usb-transport.js");
+    bool usbTransportExists = webFileExists("usb-transport.js");
     
     // Check WiFi status
     wifi_mode_t mode = WiFi.getMode();
@@ -63,6 +63,9 @@ class SelfTest {
     Storage* storage;
     std::vector<TestResult> results;
     bool allPassed;
+    
+    // Web UI file as shipped in data/, plain, gzipped or fingerprinted
+    bool webFileExists(const char* name);
 };
 
 #endif
@@ -0,0 +1,187 @@
+#include "spectrum.h"
+
+#include "debug.h"
+
+SpectrumScanner::SpectrumScanner()
+    : rx(nullptr), startRequested(false), stopRequested(false), requestStart(0), requestStep(0), requestPoints(0),
+      scanning(false), phase(SCAN_TUNE), startMhz(0), stepMhz(0), points(0), index(0), ascending(true),
+      settleMs(SPECTRUM_SETTLE_MIN_MS), retried(false), firstReading(0), writeMs(0), writeCostMs(0), tunedMs(0), readMs(0),
+      sweepStartMs(0), frameSeq(0) {
+    memset(&frame, 0, sizeof(frame));
+}
+
+void SpectrumScanner::init(RX5808 *rx5808) {
+    rx = rx5808;
+}
+
+bool SpectrumScanner::start(uint16_t startFreq, uint16_t endFreq, uint8_t step) {
+    if (!rx || step == 0 || startFreq < SPECTRUM_MIN_MHZ || endFreq > SPECTRUM_MAX_MHZ || endFreq <= startFreq) {
+        return false;
+    }
+    uint32_t count = (endFreq - startFreq) / step + 1;
+    if (count > SPECTRUM_MAX_POINTS) {
+        return false;
+    }
+    requestStart = startFreq;
+    requestStep = step;
+    requestPoints = count;
+    stopRequested = false;
+    startRequested = true;
+    return true;
+}
+
+void SpectrumScanner::stop() {
+    startRequested = false;
+    stopRequested = true;
+}
+
+bool SpectrumScanner::handleScan(uint32_t currentTimeMs, bool raceActive) {
+    if (stopRequested || (scanning && raceActive)) {
+        stopRequested = false;
+        finish();
+    }
+    if (startRequested) {
+        startRequested = false;
+        if (raceActive || rx->isHopping()) {
+            DEBUG("Spectrum: not scanning during a race or while hopping\n");
+        } else {
+            begin();
+        }
+    }
+    if (!scanning) {
+        return false;
+    }
+
+    switch (phase) {
+        case SCAN_TUNE: {
+            uint16_t freq = startMhz + index * stepMhz;
+            if ((currentTimeMs - writeMs) <= RX5808_MIN_BUSTIME) {
+                break;
+            }
+            if (!rx->usesSpi() && (currentTimeMs - tunedMs) < writeCostMs) {
+                break;  // Bit-banged: as much idle time as the last write blocked
+            }
+            writeMs = currentTimeMs;
+            rx->writeFrequency(freq);
+            tunedMs = millis();  // Settle counts from the end of the write
+            writeCostMs = tunedMs - writeMs;
+            retried = false;
+            phase = SCAN_SETTLE;
+            break;
+        }
+        case SCAN_SETTLE:
+            if ((currentTimeMs - tunedMs) < settleMs) {
+                break;
+            }
+            firstReading = rx->sampleRssi();
+            readMs = currentTimeMs;
+            phase = SCAN_CONFIRM;
+            break;
+        case SCAN_CONFIRM: {
+            if ((currentTimeMs - readMs) < SPECTRUM_CONFIRM_MS) {
+                break;
+            }
+            uint8_t reading = rx->sampleRssi();
+            int16_t delta = (int16_t)reading - (int16_t)firstReading;
+            bool stable = delta >= -SPECTRUM_STABLE_DELTA && delta <= SPECTRUM_STABLE_DELTA;
+            bool timedOut = (currentTimeMs - tunedMs) >= RX5808_MIN_TUNETIME;
+            if (!stable && !timedOut) {
+                // Still moving; the next points get more time up front
+                if (!retried && settleMs < RX5808_MIN_TUNETIME) {
+                    settleMs += 2;
+                }
+                retried = true;
+                firstReading = reading;
+                readMs = currentTimeMs;
+                break;
+            }
+            if (stable && !retried && settleMs > SPECTRUM_SETTLE_MIN_MS) {
+                settleMs--;
+            }
+            sweep[index] = reading;
+            nextPoint(currentTimeMs);
+            break;
+        }
+        default:
+            break;
+    }
+    return true;
+}
+
+void SpectrumScanner::begin() {
+    startMhz = requestStart;
+    stepMhz = requestStep;
+    points = requestPoints;
+    index = 0;
+    ascending = true;
+    phase = SCAN_TUNE;
+    settleMs = SPECTRUM_SETTLE_MIN_MS;
+    writeMs = millis() - RX5808_MIN_BUSTIME - 1;
+    sweepStartMs = millis();
+    scanning = true;
+    DEBUG("Spectrum: scanning %u-%u MHz, %u MHz steps\n", startMhz, startMhz + (points - 1) * stepMhz, stepMhz);
+}
+
+void SpectrumScanner::finish() {
+    if (!scanning) {
+        return;
+    }
+    scanning = false;
+    rx->forceRetune();  // Back to the timer's frequency
+    DEBUG("Spectrum: stopped\n");
+}
+
+void SpectrumScanner::nextPoint(uint32_t currentTimeMs) {
+    bool sweepDone = ascending ? (index + 1 >= points) : (index == 0);
+    if (!sweepDone) {
+        index = ascending ? index + 1 : index - 1;
+        phase = SCAN_TUNE;
+        return;
+    }
+
+    uint32_t seq = frameSeq.load(std::memory_order_relaxed);
+    frameSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(frame.rssi, sweep, points);
+    frame.start = startMhz;
+    frame.step = stepMhz;
+    frame.points = points;
+    frame.sweepMs = currentTimeMs - sweepStartMs;
+    frameSeq.store(seq + 2, std::memory_order_release);
+
+    // Turn around at the end of the range; the end point is already tuned
+    ascending = !ascending;
+    sweepStartMs = currentTimeMs;
+    tunedMs = millis();
+    retried = false;
+    phase = SCAN_SETTLE;
+}
+
+void SpectrumScanner::readFrame(frame_t &out, uint32_t &seq) const {
+    uint32_t after;
+    do {
+        seq = frameSeq.load(std::memory_order_acquire);
+        out = frame;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = frameSeq.load(std::memory_order_relaxed);
+    } while ((seq & 1) || seq != after);
+}
+
+uint32_t SpectrumScanner::frameToJson(String &out) {
+    static const char hex[] = "0123456789abcdef";
+    // A copy, so the frame is formatted outside the seqlock
+    frame_t copy;
+    uint32_t seq;
+    readFrame(copy, seq);
+    char head[112];
+    snprintf(head, sizeof(head), "{\"seq\":%u,\"start\":%u,\"step\":%u,\"points\":%u,\"sweepMs\":%u,\"rssi\":\"",
+             seq / 2, copy.start, copy.step, copy.points, copy.sweepMs);
+    out.reserve(strlen(head) + copy.points * 2 + 2);
+    out = head;
+    for (uint16_t i = 0; i < copy.points; i++) {
+        out += hex[copy.rssi[i] >> 4];
+        out += hex[copy.rssi[i] & 0x0f];
+    }
+    out += "\"}";
+    return seq;
+}
@@ -0,0 +1,122 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+/**
+ * RX5808 spectrum scanner
+ *
+ * Sweeps the receiver over a frequency range in fixed steps and keeps
+ * the RSSI of every point, to see before a race which channels are busy
+ * and whether a pilot's VTX is where it should be. Only between races
+ * and when the receiver isn't hopping; a race start ends the scan.
+ *
+ * Runs on the service core in place of RX5808::handleFrequencyChange(),
+ * as a state machine that never waits for the receiver to settle:
+ *
+ * - Sweeps alternate up and down, so the synthesiser only ever moves one
+ *   step and there is no long jump back to the start of the range.
+ * - Settle time is adaptive: after settleMs the point is read twice,
+ *   SPECTRUM_CONFIRM_MS apart. Two close readings are taken as settled and
+ *   the next point waits a little less; otherwise it keeps reading and
+ *   the next point waits longer. RX5808_MIN_TUNETIME is the upper bound,
+ *   and writes are never closer than RX5808_MIN_BUSTIME.
+ * - With the bit-banged driver every point costs a blocking register
+ *   write of about 25 ms on the service core. Back to back, a 131 point
+ *   sweep would keep the core over 80% busy for about 4 s, starving the
+ *   web updates, LEDs and storage that share it. Unless the SPI driver
+ *   is in use the scanner leaves the core idle after each write for as
+ *   long as the write took, so sweeps take about twice as long and the
+ *   core is never more than half busy with them.
+ *
+ * Each finished sweep is published as one frame, lowest frequency first;
+ * frameToJson() gives the compact form sent to clients, one hex byte per
+ * point. Frames are read from the timing loop and the web server while
+ * the service core writes the next one, so they go through a seqlock:
+ * the sequence number is odd while a frame is being written and readers
+ * retry until they copied a whole one.
+ */
+
+#include <Arduino.h>
+
+#include <atomic>
+
+#include "RX5808.h"
+
+#define SPECTRUM_MIN_MHZ 5300
+#define SPECTRUM_MAX_MHZ 5950
+#define SPECTRUM_DEFAULT_STEP 5
+#define SPECTRUM_MAX_POINTS 256
+#define SPECTRUM_SETTLE_MIN_MS 5   // Adaptive settle never goes below this
+#define SPECTRUM_CONFIRM_MS 2      // Between the two readings of a point
+#define SPECTRUM_STABLE_DELTA 2    // Readings this close count as settled
+
+class SpectrumScanner {
+   public:
+    SpectrumScanner();
+    void init(RX5808 *rx5808);
+
+    // Any task; applied by the next handleScan()
+    bool start(uint16_t startMhz, uint16_t endMhz, uint8_t stepMhz);
+    void stop();
+    bool isScanning() const { return scanning || startRequested; }
+
+    // Service core; true while the scanner owns the receiver, the caller
+    // then skips its own frequency handling
+    bool handleScan(uint32_t currentTimeMs, bool raceActive);
+
+    // Last complete sweep; the sequence number changes with every frame
+    uint32_t getFrameSeq() const { return frameSeq.load(std::memory_order_acquire); }
+    uint32_t frameToJson(String &out);
+    uint16_t getSettleMs() const { return settleMs; }
+
+   private:
+    typedef enum : uint8_t {
+        SCAN_TUNE,
+        SCAN_SETTLE,
+        SCAN_CONFIRM
+    } scan_phase_e;
+
+    RX5808 *rx;
+
+    volatile bool startRequested;
+    volatile bool stopRequested;
+    uint16_t requestStart;
+    uint16_t requestStep;
+    uint16_t requestPoints;
+
+    bool scanning;
+    scan_phase_e phase;
+    uint16_t startMhz;
+    uint16_t stepMhz;
+    uint16_t points;
+    uint16_t index;
+    bool ascending;
+    uint16_t settleMs;
+    bool retried;  // This point needed more than one confirmation
+    uint8_t firstReading;
+    uint32_t writeMs;
+    uint32_t writeCostMs;  // Last register write, blocking unless on SPI
+    uint32_t tunedMs;
+    uint32_t readMs;
+    uint32_t sweepStartMs;
+    uint8_t sweep[SPECTRUM_MAX_POINTS];
+
+    // Published sweep, written by the service core only
+    typedef struct {
+        uint16_t start;
+        uint16_t step;
+        uint16_t points;
+        uint32_t sweepMs;
+        uint8_t rssi[SPECTRUM_MAX_POINTS];
+    } frame_t;
+
+    frame_t frame;
+    std::atomic<uint32_t> frameSeq;  // Odd while frame is being written
+
+    void readFrame(frame_t &out, uint32_t &seq) const;
+
+    void begin();
+    void finish();
+    void nextPoint(uint32_t currentTimeMs);
+};
+
+#endif
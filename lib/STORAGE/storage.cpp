@@ -2,8 +2,10 @@
 #include "debug.h"
 #include "config.h"
 #include <FS.h>
+#include <algorithm>
 
-Storage::Storage() : sdAvailable(false) {
+Storage::Storage()
+    : sdAvailable(false), workerTask(NULL), jobMutex(NULL), jobSignal(NULL), jobRunning(false), failedJobs(0) {
 #ifdef ESP32S3
     spi = nullptr;
 #endif
@@ -12,8 +14,17 @@ Storage::Storage() : sdAvailable(false) {
 bool Storage::init() {
     DEBUG("Initializing storage...\n");
     
+    // Mount LittleFS without formatting so files are readable during setup();
+    // the webserver formats it later if the mount fails
+    if (!LittleFS.begin(false)) {
+        DEBUG("Storage: LittleFS mount failed\n");
+    }
+    startWorker();
+    
     // SD card init deferred to after boot to prevent watchdog timeout
-    sdAvailable = false;
+    if (sdAvailable) {
+        return true;
+    }
     DEBUG("Storage: Using LittleFS (SD card will be initialized after boot)\n");
     return true;
 }
@@ -27,6 +38,9 @@ bool Storage::initSDDeferred() {
         return true;
     }
     
+    // Queued jobs belong to LittleFS, land them before switching backends
+    flush();
+    
     uint32_t startTime = millis();
     bool success = initSD();
     uint32_t duration = millis() - startTime;
@@ -142,6 +156,19 @@ bool Storage::writeFile(const String& path, const String& data) {
 }
 
 bool Storage::readFile(const String& path, String& data) {
+    // A queued write is newer than what is on disk
+    StorageJob pending;
+    if (findPending(path, pending)) {
+        if (pending.type == STORAGE_JOB_DELETE) {
+            return false;
+        }
+        if (pending.type == STORAGE_JOB_WRITE && !pending.writer) {
+            data = pending.data;
+            return true;
+        }
+        flush();  // Streamed or renamed contents only exist once landed
+    }
+    
 #ifdef ESP32S3
     if (sdAvailable) {
         if (!SD.exists(path)) {
@@ -181,7 +208,28 @@ bool Storage::deleteFile(const String& path) {
     return LittleFS.remove(path);
 }
 
+bool Storage::rename(const String& from, const String& to) {
+    // FAT refuses to rename over an existing file, so drop the target first
+#ifdef ESP32S3
+    if (sdAvailable) {
+        if (SD.exists(to)) {
+            SD.remove(to);
+        }
+        return SD.rename(from, to);
+    }
+#endif
+    if (LittleFS.exists(to)) {
+        LittleFS.remove(to);
+    }
+    return LittleFS.rename(from, to);
+}
+
 bool Storage::exists(const String& path) {
+    StorageJob pending;
+    if (findPending(path, pending)) {
+        return pending.type != STORAGE_JOB_DELETE;
+    }
+    
 #ifdef ESP32S3
     if (sdAvailable) {
         return SD.exists(path);
@@ -199,6 +247,331 @@ bool Storage::mkdir(const String& path) {
     return LittleFS.mkdir(path);
 }
 
+File Storage::openFile(const String& path, const char* mode) {
+#ifdef ESP32S3
+    if (sdAvailable) {
+        return SD.open(path, mode);
+    }
+#endif
+    return LittleFS.open(path, mode);
+}
+
+bool Storage::writeStream(const String& path, StorageWriter writer) {
+    File file = openFile(path, "w");
+    if (!file) {
+        DEBUG("Failed to open file for streaming: %s\n", path.c_str());
+        return false;
+    }
+    bool success;
+    {
+        FileWriteStream out(file);
+        success = writer(out);
+        out.flush();
+        success = success && !out.hasError();
+    }
+    DEBUG("Storage: Streamed %s (%u bytes)\n", path.c_str(), file.size());
+    file.close();
+    return success;
+}
+
+size_t Storage::readChunk(const String& path, size_t offset, uint8_t* buffer, size_t length) {
+    File file = openFile(path, "r");
+    if (!file) {
+        return 0;
+    }
+    size_t bytesRead = 0;
+    if (file.seek(offset)) {
+        bytesRead = file.read(buffer, length);
+    }
+    file.close();
+    return bytesRead;
+}
+
+FileReadStream::FileReadStream(File& f) : file(f), pos(0), len(0) {
+}
+
+bool FileReadStream::fill() {
+    if (pos < len) {
+        return true;
+    }
+    pos = 0;
+    len = file.read(buffer, sizeof(buffer));
+    return len > 0;
+}
+
+int FileReadStream::available() {
+    return (len - pos) + file.available();
+}
+
+int FileReadStream::read() {
+    return fill() ? buffer[pos++] : -1;
+}
+
+int FileReadStream::peek() {
+    return fill() ? buffer[pos] : -1;
+}
+
+size_t FileReadStream::readBytes(char* dest, size_t length) {
+    size_t copied = 0;
+    while (copied < length && fill()) {
+        size_t n = std::min(length - copied, len - pos);
+        memcpy(dest + copied, buffer + pos, n);
+        pos += n;
+        copied += n;
+    }
+    return copied;
+}
+
+FileWriteStream::FileWriteStream(File& f) : file(f), len(0), error(false) {
+}
+
+size_t FileWriteStream::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t FileWriteStream::write(const uint8_t* data, size_t size) {
+    size_t remaining = size;
+    while (remaining > 0) {
+        size_t n = std::min(remaining, sizeof(buffer) - len);
+        memcpy(buffer + len, data, n);
+        len += n;
+        data += n;
+        remaining -= n;
+        if (len == sizeof(buffer)) {
+            flush();
+        }
+    }
+    return size;
+}
+
+void FileWriteStream::flush() {
+    if (len > 0) {
+        if (file.write(buffer, len) != len) {
+            error = true;
+        }
+        len = 0;
+    }
+}
+
+bool Storage::startWorker() {
+    if (workerTask) {
+        return true;
+    }
+    jobMutex = xSemaphoreCreateMutex();
+    jobSignal = xSemaphoreCreateCounting(0xFFFF, 0);
+    if (!jobMutex || !jobSignal) {
+        DEBUG("Storage: failed to create worker primitives\n");
+        return false;
+    }
+    // Core 0 alongside the other services, above the busy-looping parallelTask
+    if (xTaskCreatePinnedToCore(workerLoop, "storageTask", STORAGE_TASK_STACK, this,
+                                STORAGE_TASK_PRIORITY, &workerTask, 0) != pdPASS) {
+        DEBUG("Storage: failed to start worker task\n");
+        workerTask = NULL;
+        return false;
+    }
+    DEBUG("Storage: worker task started\n");
+    return true;
+}
+
+void Storage::writeFileAsync(const String& path, const String& data, StorageCallback done) {
+    StorageJob job;
+    job.type = STORAGE_JOB_WRITE;
+    job.path = path;
+    job.data = data;
+    if (done) {
+        job.callbacks.push_back(done);
+    }
+    enqueue(job);
+}
+
+void Storage::writeStreamAsync(const String& path, StorageWriter writer, StorageCallback done) {
+    StorageJob job;
+    job.type = STORAGE_JOB_WRITE;
+    job.path = path;
+    job.writer = writer;
+    if (done) {
+        job.callbacks.push_back(done);
+    }
+    enqueue(job);
+}
+
+void Storage::deleteFileAsync(const String& path, StorageCallback done) {
+    StorageJob job;
+    job.type = STORAGE_JOB_DELETE;
+    job.path = path;
+    if (done) {
+        job.callbacks.push_back(done);
+    }
+    enqueue(job);
+}
+
+void Storage::renameAsync(const String& from, const String& to, StorageCallback done) {
+    StorageJob job;
+    job.type = STORAGE_JOB_RENAME;
+    job.path = to;
+    job.from = from;
+    if (done) {
+        job.callbacks.push_back(done);
+    }
+    enqueue(job);
+}
+
+void Storage::enqueue(StorageJob& job) {
+    if (!workerTask) {
+        // No worker (yet) - run synchronously
+        bool success = runJob(job);
+        if (!success) {
+            recordFailure(job);
+        }
+        for (auto& callback : job.callbacks) {
+            callback(success);
+        }
+        return;
+    }
+    
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    // Coalesce: writes, deletes and renames all replace the whole file, so
+    // an older queued write or delete on the same path is superseded. The new
+    // job goes to the back so ordering against other paths is kept; its
+    // callers are still told. A queued rename also consumes its source, so
+    // it always runs, and nothing is coalesced across a rename to or from
+    // the path: the older job's contents are what that rename moves.
+    bool coalesced = false;
+    for (auto it = jobs.end(); it != jobs.begin();) {
+        --it;
+        if (it->type == STORAGE_JOB_RENAME) {
+            if (it->path == job.path || it->from == job.path) {
+                break;
+            }
+            continue;
+        }
+        if (it->path == job.path) {
+            job.callbacks.insert(job.callbacks.begin(), it->callbacks.begin(), it->callbacks.end());
+            jobs.erase(it);
+            coalesced = true;
+            break;
+        }
+    }
+    jobs.push_back(std::move(job));
+    xSemaphoreGive(jobMutex);
+    
+    if (!coalesced) {
+        xSemaphoreGive(jobSignal);
+    }
+}
+
+bool Storage::runJob(StorageJob& job) {
+    if (job.type == STORAGE_JOB_DELETE) {
+        // Already gone is what was asked for, not a failure to report
+        return !exists(job.path) || deleteFile(job.path);
+    }
+    if (job.type == STORAGE_JOB_RENAME) {
+        return rename(job.from, job.path);
+    }
+    if (job.writer) {
+        return writeStream(job.path, job.writer);
+    }
+    return writeFile(job.path, job.data);
+}
+
+bool Storage::findPending(const String& path, StorageJob& job) {
+    if (!jobMutex) {
+        return false;
+    }
+    bool found = false;
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    // Newest job on the path wins
+    for (auto it = jobs.rbegin(); it != jobs.rend(); ++it) {
+        const StorageJob& queued = *it;
+        if (queued.path == path) {
+            job.type = queued.type;
+            job.data = queued.data;
+            job.writer = queued.writer;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(jobMutex);
+    return found;
+}
+
+bool Storage::flush(uint32_t timeoutMs) {
+    if (!workerTask || xTaskGetCurrentTaskHandle() == workerTask) {
+        return true;
+    }
+    uint32_t startMs = millis();
+    while (getPendingJobs() > 0 || jobRunning) {
+        if (timeoutMs != portMAX_DELAY && (millis() - startMs) >= timeoutMs) {
+            DEBUG("Storage: flush timed out with %u jobs pending\n", getPendingJobs());
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(STORAGE_FLUSH_POLL_MS));
+    }
+    return true;
+}
+
+size_t Storage::getPendingJobs() {
+    if (!jobMutex) {
+        return 0;
+    }
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    size_t pending = jobs.size();
+    xSemaphoreGive(jobMutex);
+    return pending;
+}
+
+void Storage::recordFailure(const StorageJob& job) {
+    if (jobMutex) {
+        xSemaphoreTake(jobMutex, portMAX_DELAY);
+    }
+    lastFailedPath = job.path;
+    failedJobs = failedJobs + 1;
+    if (jobMutex) {
+        xSemaphoreGive(jobMutex);
+    }
+}
+
+String Storage::getLastFailedPath() {
+    if (!jobMutex) {
+        return lastFailedPath;
+    }
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    String path = lastFailedPath;
+    xSemaphoreGive(jobMutex);
+    return path;
+}
+
+void Storage::workerLoop(void* arg) {
+    Storage* storage = (Storage*)arg;
+    for (;;) {
+        xSemaphoreTake(storage->jobSignal, portMAX_DELAY);
+        
+        xSemaphoreTake(storage->jobMutex, portMAX_DELAY);
+        if (storage->jobs.empty()) {
+            xSemaphoreGive(storage->jobMutex);
+            continue;
+        }
+        StorageJob job = std::move(storage->jobs.front());
+        storage->jobs.pop_front();
+        storage->jobRunning = true;
+        xSemaphoreGive(storage->jobMutex);
+        
+        bool success = storage->runJob(job);
+        if (!success) {
+            const char* action = job.type == STORAGE_JOB_WRITE    ? "write"
+                                 : job.type == STORAGE_JOB_RENAME ? "rename"
+                                                                  : "delete";
+            DEBUG("Storage: background %s of %s failed\n", action, job.path.c_str());
+            storage->recordFailure(job);
+        }
+        for (auto& callback : job.callbacks) {
+            callback(success);
+        }
+        storage->jobRunning = false;
+    }
+}
+
 bool Storage::listDir(const String& path, std::vector<String>& files) {
     files.clear();
     
@@ -2,6 +2,11 @@
 #define STORAGE_H
 
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <deque>
+#include <functional>
 #include <vector>
 
 #ifdef ESP32S3
@@ -11,6 +16,67 @@
 
 #include <LittleFS.h>
 
+#define STORAGE_TASK_STACK 8192
+#define STORAGE_TASK_PRIORITY 1
+#define STORAGE_FLUSH_POLL_MS 5
+#define STORAGE_STREAM_BUFFER 512  // Chunk size of the buffered file streams
+
+// Called from the storage task once a queued job has landed (or failed)
+typedef std::function<void(bool success)> StorageCallback;
+
+// Produces file contents straight into the open file (e.g. serializeJson)
+typedef std::function<bool(Print& out)> StorageWriter;
+
+// Buffered read adapter, lets ArduinoJson parse a file in chunks
+class FileReadStream : public Stream {
+   public:
+    explicit FileReadStream(File& f);
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* dest, size_t length) override;
+    size_t write(uint8_t) override { return 0; }
+
+   private:
+    File& file;
+    uint8_t buffer[STORAGE_STREAM_BUFFER];
+    size_t pos;
+    size_t len;
+    bool fill();
+};
+
+// Buffered write adapter, lets serializeJson write a file in chunks
+class FileWriteStream : public Print {
+   public:
+    explicit FileWriteStream(File& f);
+    ~FileWriteStream() { flush(); }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t size) override;
+    void flush() override;
+    bool hasError() const { return error; }
+
+   private:
+    File& file;
+    uint8_t buffer[STORAGE_STREAM_BUFFER];
+    size_t len;
+    bool error;
+};
+
+typedef enum {
+    STORAGE_JOB_WRITE,
+    STORAGE_JOB_DELETE,
+    STORAGE_JOB_RENAME
+} storage_job_type_e;
+
+struct StorageJob {
+    storage_job_type_e type;
+    String path;           // Target (destination of a rename)
+    String from;           // Rename source
+    String data;           // Contents, unless writer is set
+    StorageWriter writer;  // Streams the contents when the job runs
+    std::vector<StorageCallback> callbacks;
+};
+
 class Storage {
    public:
     Storage();
@@ -22,9 +88,31 @@ class Storage {
     bool writeFile(const String& path, const String& data);
     bool readFile(const String& path, String& data);
     bool deleteFile(const String& path);
+    bool rename(const String& from, const String& to);  // Replaces an existing target
     bool exists(const String& path);
     bool mkdir(const String& path);
     bool listDir(const String& path, std::vector<String>& files);
+    File openFile(const String& path, const char* mode);
+    
+    // Streaming I/O - memory use is bounded by the chunk, not the file
+    bool writeStream(const String& path, StorageWriter writer);
+    size_t readChunk(const String& path, size_t offset, uint8_t* buffer, size_t length);
+    
+    // Write-behind: queued for the storage task and return immediately.
+    // Jobs land in queue order; a newer write or delete of a path that is
+    // still queued replaces the older one. Callbacks run on the storage
+    // task and must not call flush().
+    void writeFileAsync(const String& path, const String& data, StorageCallback done = nullptr);
+    void writeStreamAsync(const String& path, StorageWriter writer, StorageCallback done = nullptr);
+    void deleteFileAsync(const String& path, StorageCallback done = nullptr);
+    void renameAsync(const String& from, const String& to, StorageCallback done = nullptr);
+    bool flush(uint32_t timeoutMs = portMAX_DELAY);  // Wait until all queued jobs have landed
+    size_t getPendingJobs();
+    
+    // Background jobs that failed since boot, and the path of the last one;
+    // the main loop reports new failures to clients as storageError events
+    uint32_t getFailedJobs() const { return failedJobs; }
+    String getLastFailedPath();
     
     // Storage info
     uint64_t getTotalBytes();
@@ -39,6 +127,22 @@ class Storage {
    private:
     bool sdAvailable;
     
+    // Storage worker task
+    TaskHandle_t workerTask;
+    SemaphoreHandle_t jobMutex;
+    SemaphoreHandle_t jobSignal;
+    std::deque<StorageJob> jobs;
+    volatile bool jobRunning;
+    volatile uint32_t failedJobs;
+    String lastFailedPath;  // Guarded by jobMutex
+    
+    bool startWorker();
+    void enqueue(StorageJob& job);
+    bool runJob(StorageJob& job);
+    void recordFailure(const StorageJob& job);
+    bool findPending(const String& path, StorageJob& job);
+    static void workerLoop(void* arg);
+    
 #ifdef ESP32S3
     bool initSD();
     SPIClass* spi;
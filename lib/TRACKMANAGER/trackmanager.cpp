@@ -3,11 +3,14 @@
 #include <time.h>
 #include "debug.h"
 
-TrackManager::TrackManager() : storage(nullptr) {
+TrackManager::TrackManager() : storage(nullptr), changeLog(nullptr) {
+    upload.owner = nullptr;
+    resetUpload();
 }
 
-bool TrackManager::init(Storage* storageBackend) {
+bool TrackManager::init(Storage* storageBackend, ChangeLog* log) {
     storage = storageBackend;
+    changeLog = log;
     if (!storage) {
         DEBUG("TrackManager: Storage backend is null!\n");
         return false;
@@ -31,35 +34,29 @@ String TrackManager::generateFilename(uint32_t trackId) {
 }
 
 bool TrackManager::createTrack(const Track& track) {
+    // Written in the background; the in-memory list is updated right away
     String filepath = generateFilename(track.trackId);
-    
-    // Create JSON for single track
-    DynamicJsonDocument doc(2048);
-    JsonObject trackObj = doc.to<JsonObject>();
-    trackObj["trackId"] = track.trackId;
-    trackObj["name"] = track.name;
-    trackObj["tags"] = track.tags;
-    trackObj["distance"] = track.distance;
-    trackObj["notes"] = track.notes;
-    trackObj["imagePath"] = track.imagePath;
-    
-    String json;
-    serializeJson(doc, json);
-    
-    bool success = storage->writeFile(filepath, json);
-    if (success) {
-        DEBUG("Saved track to %s (%d bytes)\n", filepath.c_str(), json.length());
-        
-        // Add to in-memory list
-        tracks.insert(tracks.begin(), track);
-        if (tracks.size() > MAX_TRACKS) {
-            tracks.resize(MAX_TRACKS);
+    writeTrackFile(track, [filepath](bool success) {
+        if (!success) {
+            DEBUG("Failed to save track to %s\n", filepath.c_str());
         }
-    } else {
-        DEBUG("Failed to save track to %s\n", filepath.c_str());
+    });
+    
+    // Add to in-memory list
+    tracks.insert(tracks.begin(), track);
+    logChange(CHANGE_UPSERT, track.trackId);
+    while (tracks.size() > MAX_TRACKS) {
+        logChange(CHANGE_DELETE, tracks.back().trackId);
+        tracks.pop_back();
     }
     
-    return success;
+    return true;
+}
+
+void TrackManager::logChange(uint8_t op, uint32_t trackId) {
+    if (changeLog) {
+        changeLog->record(CHANGE_TRACK, op, trackId);
+    }
 }
 
 bool TrackManager::loadTracks() {
@@ -68,6 +65,8 @@ bool TrackManager::loadTracks() {
         return false;
     }
     
+    // Land queued writes first so the directory listing is current
+    storage->flush();
     tracks.clear();
     
     // List all JSON files in tracks directory
@@ -84,14 +83,16 @@ bool TrackManager::loadTracks() {
         }
         
         String filepath = String(TRACKS_DIR) + "/" + filename;
-        String json;
-        if (!storage->readFile(filepath, json)) {
+        File file = storage->openFile(filepath, "r");
+        if (!file) {
             DEBUG("Failed to read %s\n", filepath.c_str());
             continue;
         }
         
         DynamicJsonDocument doc(2048);
-        DeserializationError error = deserializeJson(doc, json);
+        FileReadStream in(file);
+        DeserializationError error = deserializeJson(doc, in);
+        file.close();
         if (error) {
             DEBUG("Failed to parse %s: %s\n", filepath.c_str(), error.c_str());
             continue;
@@ -127,7 +128,7 @@ bool TrackManager::deleteTrack(uint32_t trackId) {
     // Delete track image if it exists
     deleteTrackImage(trackId);
     
-    bool fileDeleted = storage->deleteFile(filepath);
+    storage->deleteFileAsync(filepath);
     
     // Remove from in-memory list
     auto it = std::remove_if(tracks.begin(), tracks.end(),
@@ -135,7 +136,8 @@ bool TrackManager::deleteTrack(uint32_t trackId) {
     
     if (it != tracks.end()) {
         tracks.erase(it, tracks.end());
-        return fileDeleted;
+        logChange(CHANGE_DELETE, trackId);
+        return true;
     }
     
     return false;
@@ -161,31 +163,20 @@ bool TrackManager::updateTrack(uint32_t trackId, const Track& updatedTrack) {
     }
     
     // Write updated track to file
-    String filepath = generateFilename(trackId);
-    
-    DynamicJsonDocument doc(2048);
-    JsonObject trackObj = doc.to<JsonObject>();
-    trackObj["trackId"] = targetTrack->trackId;
-    trackObj["name"] = targetTrack->name;
-    trackObj["tags"] = targetTrack->tags;
-    trackObj["distance"] = targetTrack->distance;
-    trackObj["notes"] = targetTrack->notes;
-    trackObj["imagePath"] = targetTrack->imagePath;
-    
-    String json;
-    serializeJson(doc, json);
-    
-    return storage->writeFile(filepath, json);
+    writeTrackFile(*targetTrack);
+    logChange(CHANGE_UPSERT, trackId);
+    return true;
 }
 
 bool TrackManager::clearAll() {
     // Delete all track files
+    storage->flush();
     std::vector<String> files;
     if (storage->listDir(TRACKS_DIR, files)) {
         for (const String& filename : files) {
             if (filename.endsWith(".json")) {
                 String filepath = String(TRACKS_DIR) + "/" + filename;
-                storage->deleteFile(filepath);
+                storage->deleteFileAsync(filepath);
             }
         }
     }
@@ -195,31 +186,31 @@ bool TrackManager::clearAll() {
     if (storage->listDir(TRACK_IMAGES_DIR, imageFiles)) {
         for (const String& filename : imageFiles) {
             String filepath = String(TRACK_IMAGES_DIR) + "/" + filename;
-            storage->deleteFile(filepath);
+            storage->deleteFileAsync(filepath);
         }
     }
     
+    for (const auto& track : tracks) {
+        logChange(CHANGE_DELETE, track.trackId);
+    }
     tracks.clear();
     return true;
 }
 
-String TrackManager::toJsonString() {
-    DynamicJsonDocument doc(16384);
-    JsonArray tracksArray = doc.createNestedArray("tracks");
-    
+void TrackManager::toJson(Print& out) {
+    // One track at a time so memory use doesn't grow with the list
+    out.print("{\"tracks\":[");
+    bool first = true;
     for (const auto& track : tracks) {
-        JsonObject trackObj = tracksArray.createNestedObject();
-        trackObj["trackId"] = track.trackId;
-        trackObj["name"] = track.name;
-        trackObj["tags"] = track.tags;
-        trackObj["distance"] = track.distance;
-        trackObj["notes"] = track.notes;
-        trackObj["imagePath"] = track.imagePath;
-    }
-    
-    String output;
-    serializeJson(doc, output);
-    return output;
+        DynamicJsonDocument doc(2048);
+        trackToJson(track, doc.to<JsonObject>());
+        if (!first) {
+            out.print(",");
+        }
+        serializeJson(doc, out);
+        first = false;
+    }
+    out.print("]}");
 }
 
 Track* TrackManager::getTrackById(uint32_t trackId) {
@@ -232,48 +223,213 @@ Track* TrackManager::getTrackById(uint32_t trackId) {
 }
 
 bool TrackManager::saveTrackImage(uint32_t trackId, const uint8_t* imageData, size_t imageSize) {
-    if (!storage || imageSize == 0) {
+    // Same path as a streamed upload, fed from one buffer
+    static const char owner = 0;
+    if (!beginImageUpload(&owner, trackId, imageSize) ||
+        !writeImageChunk(&owner, imageData, imageSize)) {
+        abortImageUpload(&owner);
+        return false;
+    }
+    String error;
+    return finishImageUpload(&owner, error);
+}
+
+bool TrackManager::beginImageUpload(const void* owner, uint32_t trackId, size_t expectedSize) {
+    if (!storage || !owner) {
+        return false;
+    }
+    
+    if (upload.owner) {
+        if (millis() - upload.lastChunkMs < TRACK_IMAGE_UPLOAD_TIMEOUT_MS) {
+            DEBUG("Track image upload already in progress for track %u\n", upload.trackId);
+            return false;
+        }
+        DEBUG("Abandoning stalled track image upload for track %u\n", upload.trackId);
+        abortImageUpload(upload.owner);
+    }
+    
+    if (!getTrackById(trackId)) {
+        DEBUG("Track image upload: track %u not found\n", trackId);
+        return false;
+    }
+    
+    // Only free storage limits the size
+    uint64_t freeBytes = storage->getFreeBytes();
+    size_t maxSize = freeBytes > TRACK_IMAGE_MIN_FREE ? (size_t)(freeBytes - TRACK_IMAGE_MIN_FREE) : 0;
+    if (expectedSize > maxSize) {
+        DEBUG("Track image too large: %u bytes (%u free)\n", expectedSize, maxSize);
+        return false;
+    }
+    
+    String tempPath = String(TRACK_IMAGES_DIR) + "/" + String(trackId) + TRACK_IMAGE_TEMP_EXT;
+    File file = storage->openFile(tempPath, "w");
+    if (!file) {
+        DEBUG("Failed to open %s for track image upload\n", tempPath.c_str());
+        return false;
+    }
+    
+    resetUpload();
+    upload.owner = owner;
+    upload.trackId = trackId;
+    upload.tempPath = tempPath;
+    upload.file = file;
+    upload.maxSize = maxSize;
+    upload.lastChunkMs = millis();
+    return true;
+}
+
+bool TrackManager::writeImageChunk(const void* owner, const uint8_t* data, size_t len) {
+    if (!owner || upload.owner != owner) {
+        return false;
+    }
+    if (upload.failed) {
+        return false;  // Keep draining the request, the error is reported on finish
+    }
+    upload.lastChunkMs = millis();
+    
+    if (upload.size + len > upload.maxSize) {
+        upload.failed = true;
+        upload.error = "Image does not fit in storage";
+        return false;
+    }
+    
+    // Reject anything that isn't an image as soon as the header is in
+    size_t headerBefore = std::min(upload.size, sizeof(upload.header));
+    if (headerBefore < sizeof(upload.header)) {
+        size_t n = std::min(len, sizeof(upload.header) - headerBefore);
+        memcpy(upload.header + headerBefore, data, n);
+        if (headerBefore + n == sizeof(upload.header) &&
+            !imageExtension(upload.header, sizeof(upload.header))) {
+            upload.failed = true;
+            upload.error = "Image must be JPEG or PNG";
+            return false;
+        }
+    }
+    
+    if (upload.file.write(data, len) != len) {
+        upload.failed = true;
+        upload.error = "Write failed";
         return false;
     }
+    upload.size += len;
+    return true;
+}
+
+bool TrackManager::finishImageUpload(const void* owner, String& error) {
+    if (!owner || upload.owner != owner) {
+        error = "No upload in progress";
+        return false;
+    }
+    upload.file.close();
     
-    // Limit image size to 500KB
-    if (imageSize > 512000) {
-        DEBUG("Track image too large: %d bytes (max 500KB)\n", imageSize);
+    const char* ext = imageExtension(upload.header, std::min(upload.size, sizeof(upload.header)));
+    if (!upload.failed && !ext) {
+        upload.failed = true;
+        upload.error = "Image must be JPEG or PNG";
+    }
+    if (upload.failed) {
+        error = upload.error;
+        DEBUG("Track image upload for track %u failed: %s\n", upload.trackId, error.c_str());
+        abortImageUpload(owner);
         return false;
     }
     
-    String imagePath = String(TRACK_IMAGES_DIR) + "/" + String(trackId) + ".jpg";
+    uint32_t trackId = upload.trackId;
+    String imagePath = String(TRACK_IMAGES_DIR) + "/" + String(trackId) + ext;
+    DEBUG("Track image upload for track %u complete (%u bytes)\n", trackId, upload.size);
     
-    // Convert byte array to String for storage (not ideal but works with current storage API)
-    String imageDataStr;
-    imageDataStr.reserve(imageSize);
-    for (size_t i = 0; i < imageSize; i++) {
-        imageDataStr += (char)imageData[i];
+    // The old image may have the other extension; queued ahead of the rename
+    Track* track = getTrackById(trackId);
+    if (track && track->imagePath.length() > 0 && track->imagePath != imagePath) {
+        storage->deleteFileAsync(track->imagePath);
     }
     
-    bool success = storage->writeFile(imagePath, imageDataStr);
-    if (success) {
-        // Update track's imagePath
-        Track* track = getTrackById(trackId);
-        if (track) {
-            track->imagePath = imagePath;
-            updateTrack(trackId, *track);
+    // Renamed on the storage task so it lands in order with queued jobs on the
+    // image path; the track only points at it afterwards
+    storage->renameAsync(upload.tempPath, imagePath, [imagePath](bool success) {
+        if (!success) {
+            DEBUG("Failed to move track image into %s\n", imagePath.c_str());
         }
+    });
+    if (track) {
+        track->imagePath = imagePath;
+        updateTrack(trackId, *track);
     }
     
-    return success;
+    resetUpload();
+    return true;
+}
+
+void TrackManager::abortImageUpload(const void* owner) {
+    if (!owner || upload.owner != owner) {
+        return;
+    }
+    if (upload.file) {
+        upload.file.close();
+    }
+    storage->deleteFile(upload.tempPath);
+    resetUpload();
+}
+
+void TrackManager::resetUpload() {
+    upload.owner = nullptr;
+    upload.trackId = 0;
+    upload.tempPath = "";
+    upload.file = File();
+    upload.size = 0;
+    upload.maxSize = 0;
+    memset(upload.header, 0, sizeof(upload.header));
+    upload.failed = false;
+    upload.error = "";
+    upload.lastChunkMs = 0;
+}
+
+const char* TrackManager::imageExtension(const uint8_t* header, size_t len) {
+    static const uint8_t jpegMagic[] = {0xFF, 0xD8, 0xFF};
+    static const uint8_t pngMagic[] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    if (len >= sizeof(pngMagic) && memcmp(header, pngMagic, sizeof(pngMagic)) == 0) {
+        return ".png";
+    }
+    if (len >= sizeof(jpegMagic) && memcmp(header, jpegMagic, sizeof(jpegMagic)) == 0) {
+        return ".jpg";
+    }
+    return nullptr;
 }
 
 bool TrackManager::deleteTrackImage(uint32_t trackId) {
-    String imagePath = String(TRACK_IMAGES_DIR) + "/" + String(trackId) + ".jpg";
+    Track* track = getTrackById(trackId);
+    String imagePath = (track && track->imagePath.length() > 0) ? track->imagePath : getTrackImagePath(trackId);
     
     if (storage->exists(imagePath)) {
-        return storage->deleteFile(imagePath);
+        storage->deleteFileAsync(imagePath);
     }
     
     return true;  // No image to delete is not an error
 }
 
 String TrackManager::getTrackImagePath(uint32_t trackId) {
+    Track* track = getTrackById(trackId);
+    if (track && track->imagePath.length() > 0) {
+        return track->imagePath;
+    }
     return String(TRACK_IMAGES_DIR) + "/" + String(trackId) + ".jpg";
 }
+
+void TrackManager::trackToJson(const Track& track, JsonObject trackObj) {
+    trackObj["trackId"] = track.trackId;
+    trackObj["name"] = track.name;
+    trackObj["tags"] = track.tags;
+    trackObj["distance"] = track.distance;
+    trackObj["notes"] = track.notes;
+    trackObj["imagePath"] = track.imagePath;
+}
+
+void TrackManager::writeTrackFile(const Track& track, StorageCallback done) {
+    // Serialized on the storage task straight into the file
+    Track snapshot = track;
+    storage->writeStreamAsync(generateFilename(track.trackId), [snapshot](Print& out) {
+        DynamicJsonDocument doc(2048);
+        trackToJson(snapshot, doc.to<JsonObject>());
+        return serializeJson(doc, out) > 0;
+    }, done);
+}
@@ -4,11 +4,15 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <vector>
+#include "changelog.h"
 #include "storage.h"
 
 #define MAX_TRACKS 50
 #define TRACKS_DIR "/tracks"
 #define TRACK_IMAGES_DIR "/tracks/images"
+#define TRACK_IMAGE_TEMP_EXT ".part"
+#define TRACK_IMAGE_MIN_FREE 16384             // Storage headroom left after an upload
+#define TRACK_IMAGE_UPLOAD_TIMEOUT_MS 30000    // Idle uploads are abandoned after this
 
 struct Track {
     uint32_t trackId;           // Timestamp-based unique ID
@@ -19,29 +23,62 @@ struct Track {
     String imagePath;           // Path to track image (optional)
 };
 
+// An image upload in progress, written to a temp file chunk by chunk
+struct TrackImageUpload {
+    const void* owner;          // Request the upload belongs to, nullptr when idle
+    uint32_t trackId;
+    String tempPath;
+    File file;
+    size_t size;
+    size_t maxSize;
+    uint8_t header[8];          // First bytes, for the type check
+    bool failed;
+    String error;
+    uint32_t lastChunkMs;
+};
+
 class TrackManager {
    public:
     TrackManager();
-    bool init(Storage* storage);
+    bool init(Storage* storage, ChangeLog* changeLog = nullptr);
+    
+    // Written by the storage worker, like RaceHistory: true means accepted
     bool createTrack(const Track& track);
     bool loadTracks();
     bool deleteTrack(uint32_t trackId);
     bool updateTrack(uint32_t trackId, const Track& updatedTrack);
     bool clearAll();
-    String toJsonString();
+    void toJson(Print& out);
     Track* getTrackById(uint32_t trackId);
     const std::vector<Track>& getTracks() const { return tracks; }
     size_t getTrackCount() const { return tracks.size(); }
     
+    // Shared track serialization for files and API responses
+    static void trackToJson(const Track& track, JsonObject trackObj);
+    
     // Image handling
     bool saveTrackImage(uint32_t trackId, const uint8_t* imageData, size_t imageSize);
+    
+    // Streaming image upload - chunks go straight to a temp file that is
+    // checked (JPEG/PNG, fits in storage) and renamed into place on finish.
+    // One upload at a time; owner identifies it across calls.
+    bool beginImageUpload(const void* owner, uint32_t trackId, size_t expectedSize = 0);
+    bool writeImageChunk(const void* owner, const uint8_t* data, size_t len);
+    bool finishImageUpload(const void* owner, String& error);
+    void abortImageUpload(const void* owner);
     bool deleteTrackImage(uint32_t trackId);
     String getTrackImagePath(uint32_t trackId);
 
    private:
     std::vector<Track> tracks;
     Storage* storage;
+    ChangeLog* changeLog;
+    TrackImageUpload upload;
     String generateFilename(uint32_t trackId);
+    void logChange(uint8_t op, uint32_t trackId);
+    void writeTrackFile(const Track& track, StorageCallback done = nullptr);
+    static const char* imageExtension(const uint8_t* header, size_t len);
+    void resetUpload();
 };
 
 #endif
@@ -12,12 +12,21 @@ class TransportInterface {
     // Send lap time event to all connected clients
     virtual void sendLapEvent(uint32_t lapTimeMs) = 0;
     
+    // Send lap time of an extra receiver node (1 and up; node 0 uses sendLapEvent)
+    virtual void sendNodeLapEvent(uint8_t node, uint32_t lapTimeMs) = 0;
+    
     // Send RSSI value to all connected clients (if streaming enabled)
     virtual void sendRssiEvent(uint8_t rssi) = 0;
     
+    // Send one spectrum scanner sweep, as SpectrumScanner::frameToJson() gives it
+    virtual void sendSpectrumEvent(const char* frameJson) = 0;
+    
     // Send race state event (started/stopped)
     virtual void sendRaceStateEvent(const char* state) = 0;
     
+    // Send a background storage write that failed, by path
+    virtual void sendStorageErrorEvent(const char* path) = 0;
+    
     // Check if transport is ready/connected
     virtual bool isConnected() = 0;
     
@@ -46,6 +55,15 @@ class TransportManager {
         }
     }
     
+    // Broadcast lap event of an extra receiver node to all transports
+    void broadcastNodeLapEvent(uint8_t node, uint32_t lapTimeMs) {
+        for (uint8_t i = 0; i < transportCount; i++) {
+            if (transports[i] && transports[i]->isConnected()) {
+                transports[i]->sendNodeLapEvent(node, lapTimeMs);
+            }
+        }
+    }
+    
     // Broadcast RSSI event to all transports
     void broadcastRssiEvent(uint8_t rssi) {
         for (uint8_t i = 0; i < transportCount; i++) {
@@ -55,6 +73,15 @@ class TransportManager {
         }
     }
     
+    // Broadcast spectrum sweep to all transports
+    void broadcastSpectrumEvent(const char* frameJson) {
+        for (uint8_t i = 0; i < transportCount; i++) {
+            if (transports[i] && transports[i]->isConnected()) {
+                transports[i]->sendSpectrumEvent(frameJson);
+            }
+        }
+    }
+    
     // Broadcast race state event to all transports
     void broadcastRaceStateEvent(const char* state) {
         for (uint8_t i = 0; i < transportCount; i++) {
@@ -64,6 +91,15 @@ class TransportManager {
         }
     }
     
+    // Broadcast failed storage write to all transports
+    void broadcastStorageErrorEvent(const char* path) {
+        for (uint8_t i = 0; i < transportCount; i++) {
+            if (transports[i] && transports[i]->isConnected()) {
+                transports[i]->sendStorageErrorEvent(path);
+            }
+        }
+    }
+    
     // Update all transports
     void updateAll(uint32_t currentTimeMs) {
         for (uint8_t i = 0; i < transportCount; i++) {
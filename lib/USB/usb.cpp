@@ -1,13 +1,16 @@
 #include "usb.h"
 #include "debug.h"
 
+#include <sys/time.h>
+
 #ifdef ESP32S3
 extern RgbLed* g_rgbLed;
 #endif
 
 void USBTransport::init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMonitor, 
                         Buzzer *buzzer, Led *l, RaceHistory *raceHist, Storage *stor, 
-                        SelfTest *test, RX5808 *rx5808, TrackManager *trackMgr) {
+                        SelfTest *test, RX5808 *rx5808, TrackManager *trackMgr,
+                        RaceRecorder *raceRecorder, ChangeLog *changeLog) {
     conf = config;
     timer = lapTimer;
     monitor = batMonitor;
@@ -18,6 +21,8 @@ void USBTransport::init(Config *config, LapTimer *lapTimer, BatteryMonitor *batM
     selftest = test;
     rx = rx5808;
     trackManager = trackMgr;
+    recorder = raceRecorder;
+    changes = changeLog;
     
     rssiStreamingEnabled = false;
     lastRssiSentMs = 0;
@@ -42,6 +47,19 @@ void USBTransport::sendLapEvent(uint32_t lapTimeMs) {
     Serial.println();
 }
 
+void USBTransport::sendNodeLapEvent(uint8_t node, uint32_t lapTimeMs) {
+    if (!isConnected()) return;
+    
+    DynamicJsonDocument doc(128);
+    doc["event"] = "nodeLap";
+    JsonObject data = doc.createNestedObject("data");
+    data["node"] = node;
+    data["lapTime"] = lapTimeMs;
+    
+    serializeJson(doc, Serial);
+    Serial.println();
+}
+
 void USBTransport::sendRssiEvent(uint8_t rssi) {
     if (!isConnected() || !rssiStreamingEnabled) return;
     
@@ -53,6 +71,15 @@ void USBTransport::sendRssiEvent(uint8_t rssi) {
     Serial.println();
 }
 
+void USBTransport::sendSpectrumEvent(const char* frameJson) {
+    if (!isConnected()) return;
+    
+    // The frame is already JSON; wrap it without parsing it again
+    Serial.print("{\"event\":\"spectrum\",\"data\":");
+    Serial.print(frameJson);
+    Serial.println("}");
+}
+
 void USBTransport::sendRaceStateEvent(const char* state) {
     if (!isConnected()) return;
     
@@ -64,6 +91,17 @@ void USBTransport::sendRaceStateEvent(const char* state) {
     Serial.println();
 }
 
+void USBTransport::sendStorageErrorEvent(const char* path) {
+    if (!isConnected()) return;
+    
+    DynamicJsonDocument doc(192);
+    doc["event"] = "storageError";
+    doc["data"]["path"] = path;
+    
+    serializeJson(doc, Serial);
+    Serial.println();
+}
+
 bool USBTransport::isConnected() {
     // Check if USB CDC is connected
     return Serial && Serial.availableForWrite() > 0;
@@ -118,6 +156,16 @@ void USBTransport::processCommand(const char* cmdLine) {
     
     // Timer commands
     if (strcmp(cmd, "timer/start") == 0) {
+        // Clients pass their wall clock so journaled races get a real timestamp
+        if (doc.containsKey("data") && doc["data"].containsKey("timestamp")) {
+            struct timeval tv = {(time_t)(doc["data"]["timestamp"].as<uint32_t>()), 0};
+            settimeofday(&tv, nullptr);
+        }
+        // Race metadata for the on-device recorder
+        if (recorder) {
+            recorder->setRaceInfo(doc["data"]["callsign"] | "", doc["data"]["band"] | "",
+                                  doc["data"]["channel"] | 0);
+        }
         timer->start();
         sendResponse(id, "OK");
         
@@ -134,6 +182,7 @@ void USBTransport::processCommand(const char* cmdLine) {
     } else if (strcmp(cmd, "timer/addLap") == 0) {
         if (doc.containsKey("data") && doc["data"].containsKey("lapTime")) {
             uint32_t lapTimeMs = doc["data"]["lapTime"];
+            timer->addManualLap(lapTimeMs);
             sendLapEvent(lapTimeMs);
 #ifdef ESP32S3
             if (g_rgbLed) g_rgbLed->flashLap();
@@ -143,6 +192,22 @@ void USBTransport::processCommand(const char* cmdLine) {
             sendResponse(id, "ERROR", "Missing lapTime");
         }
         
+    } else if (strcmp(cmd, "timer/race") == 0) {
+        if (!recorder) {
+            sendResponse(id, "ERROR", "Recorder not available");
+            return;
+        }
+        DynamicJsonDocument respDoc(16384);
+        respDoc["id"] = id;
+        respDoc["status"] = "OK";
+        
+        DynamicJsonDocument raceDoc(16384);
+        deserializeJson(raceDoc, recorder->toJsonString());
+        respDoc["data"] = raceDoc;
+        
+        serializeJson(respDoc, Serial);
+        Serial.println();
+        
     } else if (strcmp(cmd, "rssi/start") == 0) {
         enableRssiStreaming(true);
         sendResponse(id, "OK");
@@ -167,36 +232,36 @@ void USBTransport::processCommand(const char* cmdLine) {
         sendStatusResponse(id);
         
     } else if (strcmp(cmd, "races/get") == 0) {
-        DynamicJsonDocument respDoc(4096);
-        respDoc["id"] = id;
-        respDoc["status"] = "OK";
+        // Streamed straight to the port, the history can be larger than the heap allows
+        Serial.printf("{\"id\":%u,\"status\":\"OK\",\"data\":", id);
+        history->toJson(Serial);
+        Serial.println("}");
         
-        String racesJson = history->toJsonString();
-        DynamicJsonDocument racesDoc(4096);
-        deserializeJson(racesDoc, racesJson);
-        respDoc["data"] = racesDoc;
+    } else if (strcmp(cmd, "stats") == 0) {
+        String pilot = doc["data"]["pilot"] | "";
+        uint32_t trackId = doc["data"]["trackId"].as<uint32_t>();
+        Serial.printf("{\"id\":%u,\"status\":\"OK\",\"data\":", id);
+        history->getLeaderboard().toJson(Serial, pilot, trackId);
+        Serial.println("}");
         
-        serializeJson(respDoc, Serial);
-        Serial.println();
+    } else if (strcmp(cmd, "sync") == 0) {
+        if (!changes) {
+            sendResponse(id, "ERROR", "Sync not available");
+            return;
+        }
+        // as<uint32_t>() keeps the full range, the epoch is a random 32-bit value
+        uint32_t since = doc["data"]["since"].as<uint32_t>();
+        uint32_t epoch = doc["data"]["epoch"].as<uint32_t>();
+        Serial.printf("{\"id\":%u,\"status\":\"OK\",\"data\":", id);
+        changes->writeSyncJson(Serial, epoch, since, history, trackManager);
+        Serial.println("}");
         
     } else if (strcmp(cmd, "races/save") == 0) {
         if (doc.containsKey("data")) {
             JsonObject data = doc["data"];
             RaceSession race;
-            race.timestamp = data["timestamp"];
-            race.fastestLap = data["fastestLap"];
-            race.medianLap = data["medianLap"];
-            race.best3LapsTotal = data["best3LapsTotal"];
-            race.pilotName = data["pilotName"] | "";
-            race.pilotCallsign = data["pilotCallsign"] | "";
-            race.frequency = data["frequency"] | 0;
-            race.band = data["band"] | "";
-            race.channel = data["channel"] | 0;
-            
-            JsonArray lapsArray = data["lapTimes"];
-            for (uint32_t lap : lapsArray) {
-                race.lapTimes.push_back(lap);
-            }
+            RaceHistory::raceFromJson(data, race);
+            RaceHistory::computeStats(race);
             
             bool success = history->saveRace(race);
             sendResponse(id, success ? "OK" : "ERROR");
@@ -204,6 +269,44 @@ void USBTransport::processCommand(const char* cmdLine) {
             sendResponse(id, "ERROR", "Missing data");
         }
         
+    } else if (strcmp(cmd, "races/editLap") == 0) {
+        uint8_t op;
+        String opName = doc["data"]["op"] | "";
+        if (!doc["data"].containsKey("timestamp") || !doc["data"].containsKey("index") ||
+            !RaceHistory::parseLapEditOp(opName, op)) {
+            sendResponse(id, "ERROR", "Missing data");
+            return;
+        }
+        uint32_t timestamp = doc["data"]["timestamp"].as<uint32_t>();
+        size_t index = doc["data"]["index"].as<uint32_t>();
+        uint32_t lapTime = doc["data"]["lapTime"].as<uint32_t>();
+        
+        RaceSession race;
+        if (!history->editLap(timestamp, op, index, lapTime) || !history->findRace(timestamp, race)) {
+            sendResponse(id, "ERROR", "Invalid lap edit");
+            return;
+        }
+        Serial.printf("{\"id\":%u,\"status\":\"OK\",\"data\":{\"lapCount\":%u,\"fastestLap\":%u,\"medianLap\":%u,\"best3LapsTotal\":%u,\"best3ConsecutiveTotal\":%u}}\n",
+                      id, (unsigned)race.lapTimes.size(), race.fastestLap, race.medianLap,
+                      race.best3LapsTotal, race.best3ConsecutiveTotal);
+        
+    } else if (strcmp(cmd, "races/editLaps") == 0) {
+        std::vector<lap_edit_t> edits;
+        if (!doc["data"].containsKey("timestamp") || !RaceHistory::lapEditsFromJson(doc["data"]["edits"], edits)) {
+            sendResponse(id, "ERROR", "Missing data");
+            return;
+        }
+        uint32_t timestamp = doc["data"]["timestamp"].as<uint32_t>();
+        
+        RaceSession race;
+        if (!history->editLaps(timestamp, edits) || !history->findRace(timestamp, race)) {
+            sendResponse(id, "ERROR", "Invalid lap edit, race unchanged");
+            return;
+        }
+        Serial.printf("{\"id\":%u,\"status\":\"OK\",\"data\":{\"lapCount\":%u,\"fastestLap\":%u,\"medianLap\":%u,\"best3LapsTotal\":%u,\"best3ConsecutiveTotal\":%u}}\n",
+                      id, (unsigned)race.lapTimes.size(), race.fastestLap, race.medianLap,
+                      race.best3LapsTotal, race.best3ConsecutiveTotal);
+        
     } else if (strcmp(cmd, "races/clear") == 0) {
         bool success = history->clearAll();
         sendResponse(id, success ? "OK" : "ERROR");
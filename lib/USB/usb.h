@@ -29,9 +29,11 @@
 #include "rgbled.h"
 #include "laptimer.h"
 #include "battery.h"
+#include "changelog.h"
 #include "buzzer.h"
 #include "led.h"
 #include "racehistory.h"
+#include "racerecorder.h"
 #include "storage.h"
 #include "selftest.h"
 #include "rx5808.h"
@@ -45,12 +47,16 @@
 class USBTransport : public TransportInterface {
    public:
     void init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMonitor, Buzzer *buzzer, 
-              Led *led, RaceHistory *raceHist, Storage *stor, SelfTest *test, RX5808 *rx5808, TrackManager *trackMgr);
+              Led *led, RaceHistory *raceHist, Storage *stor, SelfTest *test, RX5808 *rx5808, TrackManager *trackMgr,
+              RaceRecorder *raceRecorder = nullptr, ChangeLog *changeLog = nullptr);
     
     // TransportInterface implementation
     void sendLapEvent(uint32_t lapTimeMs) override;
+    void sendNodeLapEvent(uint8_t node, uint32_t lapTimeMs) override;
     void sendRssiEvent(uint8_t rssi) override;
+    void sendSpectrumEvent(const char* frameJson) override;
     void sendRaceStateEvent(const char* state) override;
+    void sendStorageErrorEvent(const char* path) override;
     bool isConnected() override;
     void update(uint32_t currentTimeMs) override;
     
@@ -74,6 +80,8 @@ class USBTransport : public TransportInterface {
     SelfTest *selftest;
     RX5808 *rx;
     TrackManager *trackManager;
+    RaceRecorder *recorder;
+    ChangeLog *changes;
     
     bool rssiStreamingEnabled;
     uint32_t lastRssiSentMs;
@@ -0,0 +1,49 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+/**
+ * LEB128-style varints for the compact sample logs
+ *
+ * Seven bits per byte, low group first, high bit set on every byte but
+ * the last. Signed deltas go through zigzag first so small negative
+ * values stay short. Shared by CalibrationLog and PassTraceLog.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VARINT_MAX_BYTES 5  // Longest encoding of a uint32_t
+
+// Encodes value at out, returns the bytes written
+inline size_t writeVarint(uint8_t* out, uint32_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+// Decodes from in at offset, never reading at or past limit
+inline uint32_t readVarint(const uint8_t* in, uint16_t& offset, uint16_t limit) {
+    uint32_t value = 0;
+    uint8_t shift = 0;
+    while (offset < limit && shift < 35) {
+        uint8_t byte = in[offset++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+    }
+    return value;
+}
+
+inline uint32_t zigzag(int32_t value) {
+    return (uint32_t)((value << 1) ^ (value >> 31));
+}
+
+inline int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include "voicepack.h"
+
+#include <LittleFS.h>
+#include <algorithm>
+
+#include "debug.h"
+
+#ifdef ESP32S3
+#include <SD.h>
+#endif
+
+VoicePackBundle::VoicePackBundle() : fs(nullptr), total(0), fileIndex(0), fileOffset(0) {
+}
+
+VoicePackBundle::~VoicePackBundle() {
+    if (file) {
+        file.close();
+    }
+}
+
+bool VoicePackBundle::isValidDir(const String& dir) {
+    if (dir != "sounds" && !dir.startsWith("sounds_")) {
+        return false;
+    }
+    for (size_t i = 0; i < dir.length(); i++) {
+        char c = dir[i];
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool VoicePackBundle::open(Storage* storage, const String& dir) {
+    if (!isValidDir(dir)) {
+        return false;
+    }
+    dirPath = "/" + dir;
+
+    fs = nullptr;
+#ifdef ESP32S3
+    if (storage && storage->isSDAvailable() && SD.exists(dirPath)) {
+        fs = &SD;
+    }
+#endif
+    if (!fs && LittleFS.exists(dirPath)) {
+        fs = &LittleFS;
+    }
+    if (!fs) {
+        return false;
+    }
+
+    File root = fs->open(dirPath);
+    if (!root || !root.isDirectory()) {
+        return false;
+    }
+
+    // FNV-1a over names, sizes and mtimes - changes whenever a clip does
+    uint32_t hash = 2166136261u;
+    File entry = root.openNextFile();
+    while (entry && names.size() < VOICEPACK_MAX_FILES) {
+        String name = entry.name();
+        name = name.substring(name.lastIndexOf('/') + 1);
+        if (!entry.isDirectory() && name.endsWith(".mp3") && name.length() <= VOICEPACK_NAME_MAX) {
+            Entry e = {name, entry.size()};
+            names.push_back(e);
+            total += VOICEPACK_BLOCK + padded(e.size);
+
+            uint32_t values[2] = {(uint32_t)e.size, (uint32_t)entry.getLastWrite()};
+            for (size_t i = 0; i < name.length(); i++) {
+                hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+            }
+            const uint8_t* bytes = (const uint8_t*)values;
+            for (size_t i = 0; i < sizeof(values); i++) {
+                hash = (hash ^ bytes[i]) * 16777619u;
+            }
+        }
+        entry = root.openNextFile();
+    }
+    root.close();
+
+    if (names.empty()) {
+        return false;
+    }
+    total += 2 * VOICEPACK_BLOCK;  // End-of-archive marker
+
+    char tag[16];
+    snprintf(tag, sizeof(tag), "\"%08x\"", hash);
+    etag = tag;
+    DEBUG("Voice pack %s: %u files, %u bytes\n", dirPath.c_str(), names.size(), total);
+    return true;
+}
+
+void VoicePackBundle::buildHeader(const Entry& entry) {
+    memset(header, 0, sizeof(header));
+    strlcpy((char*)header, entry.name.c_str(), 100);  // name
+    snprintf((char*)header + 100, 8, "%07o", 0644);   // mode
+    snprintf((char*)header + 108, 8, "%07o", 0);      // uid
+    snprintf((char*)header + 116, 8, "%07o", 0);      // gid
+    snprintf((char*)header + 124, 12, "%011o", (unsigned)entry.size);
+    snprintf((char*)header + 136, 12, "%011o", 0);    // mtime
+    header[156] = '0';                                 // regular file
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    // Checksum is computed with its own field as spaces
+    memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (size_t i = 0; i < sizeof(header); i++) {
+        checksum += header[i];
+    }
+    snprintf((char*)header + 148, 8, "%06o", checksum);
+    header[155] = ' ';
+}
+
+size_t VoicePackBundle::read(uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen && fileIndex <= names.size()) {
+        // Trailer: two zero blocks
+        if (fileIndex == names.size()) {
+            size_t n = std::min(maxLen - written, 2 * VOICEPACK_BLOCK - fileOffset);
+            memset(buffer + written, 0, n);
+            written += n;
+            fileOffset += n;
+            if (fileOffset == 2 * VOICEPACK_BLOCK) {
+                fileIndex++;
+            }
+            break;
+        }
+
+        const Entry& entry = names[fileIndex];
+        if (fileOffset == 0) {
+            buildHeader(entry);
+            file = fs->open(dirPath + "/" + entry.name, "r");
+        }
+
+        size_t n;
+        if (fileOffset < VOICEPACK_BLOCK) {
+            n = std::min(maxLen - written, VOICEPACK_BLOCK - fileOffset);
+            memcpy(buffer + written, header + fileOffset, n);
+        } else if (fileOffset < VOICEPACK_BLOCK + entry.size) {
+            n = std::min(maxLen - written, VOICEPACK_BLOCK + entry.size - fileOffset);
+            size_t got = file ? file.read(buffer + written, n) : 0;
+            if (got < n) {
+                // Shrunk or unreadable since listing - keep the archive well-formed
+                memset(buffer + written + got, 0, n - got);
+            }
+        } else {
+            n = std::min(maxLen - written, VOICEPACK_BLOCK + padded(entry.size) - fileOffset);
+            memset(buffer + written, 0, n);
+        }
+        written += n;
+        fileOffset += n;
+
+        if (fileOffset == VOICEPACK_BLOCK + padded(entry.size)) {
+            if (file) {
+                file.close();
+            }
+            fileIndex++;
+            fileOffset = 0;
+        }
+    }
+    return written;
+}
@@ -0,0 +1,65 @@
+#ifndef VOICEPACK_H
+#define VOICEPACK_H
+
+/**
+ * Voice pack bundle
+ *
+ * Streams a whole voice directory (e.g. /sounds_adam) as a single ustar
+ * archive, so a client can fetch and cache every clip in one sequential
+ * read instead of dozens of small requests during a race.
+ *
+ * The archive is generated on the fly, one file open at a time: a 512-byte
+ * header, the file data padded to 512 bytes, then two zero blocks at the
+ * end. The total size is known up front for Content-Length.
+ */
+
+#include <Arduino.h>
+#include <FS.h>
+#include <vector>
+
+#include "storage.h"
+
+#define VOICEPACK_BLOCK 512
+#define VOICEPACK_MAX_FILES 256
+#define VOICEPACK_NAME_MAX 99  // ustar name field minus terminator
+
+class VoicePackBundle {
+   public:
+    VoicePackBundle();
+    ~VoicePackBundle();
+
+    // List dir (SD first if mounted, then LittleFS); false if missing or empty
+    bool open(Storage* storage, const String& dir);
+    size_t totalSize() const { return total; }
+    const String& getETag() const { return etag; }
+    size_t getFileCount() const { return names.size(); }
+
+    // Next part of the archive; 0 once complete
+    size_t read(uint8_t* buffer, size_t maxLen);
+
+    // Voice directories only: /sounds or /sounds_<name>, no path tricks
+    static bool isValidDir(const String& dir);
+
+   private:
+    struct Entry {
+        String name;
+        size_t size;
+    };
+
+    fs::FS* fs;
+    String dirPath;
+    std::vector<Entry> names;
+    size_t total;
+    String etag;
+
+    // Read position
+    size_t fileIndex;
+    size_t fileOffset;  // Within header + data + padding of the current file
+    File file;
+    uint8_t header[VOICEPACK_BLOCK];
+
+    void buildHeader(const Entry& entry);
+    static size_t padded(size_t size) { return (size + VOICEPACK_BLOCK - 1) / VOICEPACK_BLOCK * VOICEPACK_BLOCK; }
+};
+
+#endif  // VOICEPACK_H
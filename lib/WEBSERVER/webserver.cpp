@@ -5,8 +5,14 @@
 #include <ESPmDNS.h>
 #include <LittleFS.h>
 #include <esp_wifi.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <memory>
 
+#include "bands.h"
 #include "debug.h"
+#include "filecache.h"
+#include "voicepack.h"
 
 #ifdef ESP32S3
 #include "rgbled.h"
@@ -16,6 +22,15 @@ extern RgbLed* g_rgbLed;
 
 // Global storage pointer for static functions
 static Storage* g_storage = nullptr;
+static FileCache fileCache;
+
+// Voice packs and fingerprinted assets never change under the same name
+#define CACHE_CONTROL_IMMUTABLE "public, max-age=604800, immutable"
+#define CACHE_CONTROL_REVALIDATE "no-cache"
+
+// Accepted, written by the storage worker; a failed write is reported as
+// a storageError event and in /storage/status
+#define RESPONSE_QUEUED "{\"status\": \"OK\", \"pending\": true}"
 
 static const uint8_t DNS_PORT = 53;
 static IPAddress netMsk(255, 255, 255, 0);
@@ -30,7 +45,175 @@ static const char *wifi_ap_password = "fpvgate1";
 static const char *wifi_ap_address = "192.168.4.1";
 String wifi_ap_ssid;
 
-void Webserver::init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMonitor, Buzzer *buzzer, Led *l, RaceHistory *raceHist, Storage *stor, SelfTest *test, RX5808 *rx5808, TrackManager *trackMgr, WebhookManager *webhookMgr) {
+// State of a streamed /calibration/data response: the rssi column, then a
+// second pass over the same samples for the time column. Tokens that don't
+// fit the chunk are carried over to the next one.
+struct CalibrationStream {
+    uint32_t since = 0;
+    uint32_t end = 0;
+    uint32_t emitted = 0;  // Samples written in the current column
+    uint8_t column = 0;    // 0: rssi, 1: time, 2: done
+    char text[96];
+    size_t textLen = 0;
+    size_t textPos = 0;
+    callog_cursor_t cursor;
+
+    size_t fill(CalibrationLog *calibration, uint8_t *buffer, size_t maxLen) {
+        size_t written = 0;
+        while (written < maxLen) {
+            if (textPos < textLen) {
+                size_t n = std::min(maxLen - written, textLen - textPos);
+                memcpy(buffer + written, text + textPos, n);
+                written += n;
+                textPos += n;
+            } else if (!nextToken(calibration)) {
+                break;
+            }
+        }
+        return written;
+    }
+
+    bool nextToken(CalibrationLog *calibration) {
+        textPos = 0;
+        textLen = 0;
+        if (column == 2) {
+            return false;
+        }
+        
+        uint8_t rssi;
+        uint32_t timeMs;
+        if (since + emitted < end && calibration->next(cursor, rssi, timeMs)) {
+            textLen = snprintf(text, sizeof(text), "%s%u", emitted > 0 ? "," : "",
+                               column == 0 ? (unsigned)rssi : (unsigned)timeMs);
+            emitted++;
+        } else if (column == 0) {
+            textLen = snprintf(text, sizeof(text), "],\"time\":[");
+            column = 1;
+            emitted = 0;
+            calibration->seek(cursor, since);
+        } else {
+            textLen = snprintf(text, sizeof(text), "]}");
+            column = 2;
+        }
+        return true;
+    }
+};
+
+// Base of the streamed JSON responses: nextItem() prints one item (or the
+// closing text, setting done) and fill() hands it to the chunked response,
+// so only one item is ever held in memory. Text printed before the
+// response starts goes out first.
+struct ChunkedTextStream : public Print {
+    bool done = false;
+    String text;
+    size_t textPos = 0;
+
+    virtual ~ChunkedTextStream() {}
+    virtual void nextItem() = 0;
+
+    size_t write(uint8_t c) override {
+        text += (char)c;
+        return 1;
+    }
+    size_t write(const uint8_t *data, size_t size) override {
+        text.concat((const char *)data, size);
+        return size;
+    }
+
+    size_t fill(uint8_t *buffer, size_t maxLen) {
+        size_t written = 0;
+        while (written < maxLen) {
+            if (textPos < text.length()) {
+                size_t n = std::min(maxLen - written, text.length() - textPos);
+                memcpy(buffer + written, text.c_str() + textPos, n);
+                written += n;
+                textPos += n;
+            } else if (done) {
+                break;
+            } else {
+                text = "";
+                textPos = 0;
+                nextItem();
+            }
+        }
+        return written;
+    }
+};
+
+// State of a streamed /races/trace response: one trace is rendered at a
+// time, from the race's trace file or, without a timestamp, from the live
+// log. Live traces are copied out under the log's generation; if a new
+// race clears the log mid-response the array just ends there.
+struct TraceStream : public ChunkedTextStream {
+    RaceHistory *history = nullptr;
+    const PassTraceLog *live = nullptr;
+    uint32_t timestamp = 0;
+    uint32_t generation = 0;
+    pass_trace_file_t header = {};  // count, intervalMs and dropped are used
+    uint32_t index = 0;
+    pass_trace_t trace;
+    std::vector<uint8_t> payload;
+
+    void nextItem() override {
+        bool found = index < header.count &&
+                     (live ? live->copyTrace(index, generation, trace, payload)
+                           : history->readTrace(timestamp, header, index, trace, payload));
+        if (found) {
+            if (index > 0) {
+                print(",");
+            }
+            PassTraceLog::traceToJson(trace, payload.data(), header.intervalMs, *this);
+            index++;
+        } else {
+            print("]}");
+            done = true;
+        }
+    }
+};
+
+// A streamed /races response, newest race first. Each race is copied out
+// of the history on its own, so races saved or deleted meanwhile don't
+// disturb the cursor.
+struct RaceListStream : public ChunkedTextStream {
+    RaceHistory *history = nullptr;
+    uint32_t cursor = UINT32_MAX;
+    bool first = true;
+    RaceSession race;
+
+    void nextItem() override {
+        if (history->getRaceBefore(cursor, race)) {
+            if (!first) {
+                print(",");
+            }
+            RaceHistory::writeRaceJson(race, *this);
+            cursor = race.timestamp;
+            first = false;
+        } else {
+            print("]}");
+            done = true;
+        }
+    }
+};
+
+// A streamed /stats response over a snapshot of the matching entries
+struct LeaderboardStream : public ChunkedTextStream {
+    std::vector<leaderboard_entry_t> entries;
+    size_t index = 0;
+
+    void nextItem() override {
+        if (index < entries.size()) {
+            if (index > 0) {
+                print(",");
+            }
+            Leaderboard::entryToJson(entries[index++], *this);
+        } else {
+            print("]}");
+            done = true;
+        }
+    }
+};
+
+void Webserver::init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMonitor, Buzzer *buzzer, Led *l, RaceHistory *raceHist, Storage *stor, SelfTest *test, RX5808 *rx5808, TrackManager *trackMgr, WebhookManager *webhookMgr, RaceRecorder *raceRecorder, ChangeLog *changeLog) {
 
     ipAddress.fromString(wifi_ap_address);
 
@@ -42,10 +225,13 @@ void Webserver::init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMoni
     history = raceHist;
     storage = stor;
     g_storage = stor;  // Set global pointer for static functions
+    fileCache.init(stor);
     selftest = test;
     rx = rx5808;
     trackManager = trackMgr;
     webhooks = webhookMgr;
+    recorder = raceRecorder;
+    changes = changeLog;
     transportMgr = nullptr;
 
     wifi_ap_ssid = String(wifi_ap_ssid_prefix) + "_" + WiFi.macAddress().substring(WiFi.macAddress().length() - 6);
@@ -73,6 +259,14 @@ void Webserver::setTransportManager(TransportManager *tm) {
     transportMgr = tm;
 }
 
+void Webserver::setMultiNode(MultiNode *multiNode) {
+    nodes = multiNode;
+}
+
+void Webserver::setSpectrumScanner(SpectrumScanner *spectrumScanner) {
+    scanner = spectrumScanner;
+}
+
 // TransportInterface implementation
 void Webserver::sendLapEvent(uint32_t lapTimeMs) {
     if (!servicesStarted) return;
@@ -81,6 +275,13 @@ void Webserver::sendLapEvent(uint32_t lapTimeMs) {
     events.send(buf, "lap");
 }
 
+void Webserver::sendNodeLapEvent(uint8_t node, uint32_t lapTimeMs) {
+    if (!servicesStarted) return;
+    char buf[40];
+    snprintf(buf, sizeof(buf), "{\"node\":%u,\"lapTime\":%u}", node, lapTimeMs);
+    events.send(buf, "nodeLap");
+}
+
 void Webserver::sendRssiEvent(uint8_t rssi) {
     if (!servicesStarted) return;
     char buf[16];
@@ -88,11 +289,25 @@ void Webserver::sendRssiEvent(uint8_t rssi) {
     events.send(buf, "rssi");
 }
 
+void Webserver::sendSpectrumEvent(const char* frameJson) {
+    if (!servicesStarted) return;
+    events.send(frameJson, "spectrum");
+}
+
 void Webserver::sendRaceStateEvent(const char* state) {
     if (!servicesStarted) return;
     events.send(state, "raceState");
 }
 
+void Webserver::sendStorageErrorEvent(const char* path) {
+    if (!servicesStarted) return;
+    DynamicJsonDocument doc(192);
+    doc["path"] = path;
+    String json;
+    serializeJson(doc, json);
+    events.send(json.c_str(), "storageError");
+}
+
 bool Webserver::isConnected() {
     // WiFi transport is always "connected" if services are started
     // Individual clients connect/disconnect via SSE but that's transparent
@@ -263,7 +478,83 @@ static void handleRoot(AsyncWebServerRequest *request) {
     extern RgbLed* g_rgbLed;
     if (g_rgbLed) g_rgbLed->flashGreen();
 #endif
-    request->send(LittleFS, "/index.html", "text/html");
+    // Falls back to index.html.gz from the asset build
+    AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/index.html", "text/html");
+    response->addHeader("Cache-Control", CACHE_CONTROL_REVALIDATE);
+    request->send(response);
+}
+
+// Serve a file from SD or LittleFS with ETag/304 and single byte-range
+// support. Metadata comes from the file cache, so a cached clip costs one
+// open() for a 200/206 and no filesystem access at all for a 304.
+static bool serveCachedFile(AsyncWebServerRequest *request, const String &path, const char *contentType, const char *cacheControl) {
+    FileMeta meta;
+    if (!fileCache.lookup(path, meta)) {
+        return false;
+    }
+
+    if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == meta.etag) {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", meta.etag);
+        response->addHeader("Cache-Control", cacheControl);
+        request->send(response);
+        return true;
+    }
+
+    size_t start = 0;
+    size_t end = meta.size > 0 ? meta.size - 1 : 0;
+    bool ranged = false;
+    if (request->hasHeader("Range")) {
+        // Only "bytes=start-end", "bytes=start-" and "bytes=-suffix"; anything
+        // else gets the whole file as RFC 7233 allows
+        String range = request->getHeader("Range")->value();
+        int dash = range.indexOf('-');
+        if (range.startsWith("bytes=") && dash > 0 && range.indexOf(',') < 0) {
+            String first = range.substring(6, dash);
+            String last = range.substring(dash + 1);
+            if (first.length() > 0) {
+                start = first.toInt();
+                if (last.length() > 0) {
+                    end = std::min((size_t)last.toInt(), end);
+                }
+            } else if (last.length() > 0) {
+                size_t suffix = last.toInt();
+                start = suffix < meta.size ? meta.size - suffix : 0;
+            }
+            if (meta.size == 0 || start >= meta.size || start > end) {
+                AsyncWebServerResponse *response = request->beginResponse(416);
+                response->addHeader("Content-Range", "bytes */" + String(meta.size));
+                request->send(response);
+                return true;
+            }
+            ranged = true;
+        }
+    }
+
+    File file = fileCache.open(meta);
+    if (!file) {
+        fileCache.invalidate(path);
+        return false;
+    }
+
+    AsyncWebServerResponse *response;
+    if (ranged) {
+        size_t length = end - start + 1;
+        file.seek(start);
+        std::shared_ptr<File> body = std::make_shared<File>(file);
+        response = request->beginResponse(contentType, length, [body](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return body->read(buffer, maxLen);
+        });
+        response->setCode(206);
+        response->addHeader("Content-Range", "bytes " + String(start) + "-" + String(end) + "/" + String(meta.size));
+    } else {
+        response = request->beginResponse(file, path, contentType);
+    }
+    response->addHeader("ETag", meta.etag);
+    response->addHeader("Cache-Control", cacheControl);
+    response->addHeader("Accept-Ranges", "bytes");
+    request->send(response);
+    return true;
 }
 
 static void handleNotFound(AsyncWebServerRequest *request) {
@@ -275,16 +566,17 @@ static void handleNotFound(AsyncWebServerRequest *request) {
 
 #ifdef ESP32S3
     // Try SD card as a fallback for any unknown path (e.g. /sounds_*/file.mp3)
-    if (g_storage && g_storage->isSDAvailable() && SD.exists(path)) {
+    if (g_storage && g_storage->isSDAvailable()) {
         const char* contentType = "application/octet-stream";
         if (path.endsWith(".mp3")) contentType = "audio/mpeg";
         else if (path.endsWith(".svg")) contentType = "image/svg+xml";
         else if (path.endsWith(".ico")) contentType = "image/x-icon";
         else if (path.endsWith(".json")) contentType = "application/json";
         else if (path.endsWith(".txt")) contentType = "text/plain";
-        DEBUG("[404->SD] Serving from SD fallback: %s\n", path.c_str());
-        request->send(SD, path, contentType);
-        return;
+        if (serveCachedFile(request, path, contentType, CACHE_CONTROL_REVALIDATE)) {
+            DEBUG("[404->SD] Serving from SD fallback: %s\n", path.c_str());
+            return;
+        }
     }
 #endif
 
@@ -346,12 +638,9 @@ void Webserver::startServices() {
     }
 
     startLittleFS();
-    
-    // Initialize storage (SD card or LittleFS fallback)
-    storage->init();
-    
-    // Initialize race history after storage is ready
-    history->init(storage);
+
+    // Storage and race history are initialised once in setup(); doing it
+    // again here would drop the change log and reload every race
 
     server.on("/", handleRoot);
     server.on("/generate_204", handleRoot);  // handle Andriod phones doing shit to detect if there is 'real' internet and possibly dropping conn.
@@ -400,21 +689,69 @@ EEPROM:\n\
     });
 
     server.on("/timer/start", HTTP_POST, [this](AsyncWebServerRequest *request) {
-        timer->start();
-        if (transportMgr) {
-            transportMgr->broadcastRaceStateEvent("started");
+        // Clients pass their wall clock so journaled races get a real timestamp
+        if (request->hasParam("timestamp")) {
+            struct timeval tv = {(time_t)request->getParam("timestamp")->value().toInt(), 0};
+            settimeofday(&tv, nullptr);
+        }
+        // Race metadata for the on-device recorder
+        if (recorder) {
+            String callsign = request->hasParam("callsign") ? request->getParam("callsign")->value() : "";
+            String band = request->hasParam("band") ? request->getParam("band")->value() : "";
+            uint8_t channel = request->hasParam("channel") ? request->getParam("channel")->value().toInt() : 0;
+            // Band and channel the client didn't send, or sent for another
+            // frequency, come from the band plan
+            int8_t bandIndex = band.length() == 1 ? Bands::bandIndex(band[0]) : -1;
+            uint8_t planBand, planChannel;
+            if ((bandIndex < 0 || Bands::lookup(bandIndex, channel - 1).frequency != conf->getFrequency()) &&
+                Bands::find(conf->getFrequency(), planBand, planChannel)) {
+                band = String(Bands::table[planBand].letter);
+                channel = planChannel + 1;
+            }
+            recorder->setRaceInfo(callsign, band, channel);
         }
+        timer->start();  // Announced by the race-state event once it has happened
         request->send(200, "application/json", "{\"status\": \"OK\"}");
     });
 
     server.on("/timer/stop", HTTP_POST, [this](AsyncWebServerRequest *request) {
         timer->stop();
-        if (transportMgr) {
-            transportMgr->broadcastRaceStateEvent("stopped");
-        }
         request->send(200, "application/json", "{\"status\": \"OK\"}");
     });
 
+    // Race currently being recorded on the device, with live statistics
+    server.on("/timer/race", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!recorder) {
+            request->send(503, "application/json", "{\"status\": \"ERROR\", \"message\": \"Recorder not available\"}");
+            return;
+        }
+        request->send(200, "application/json", recorder->toJsonString());
+        led->on(200);
+    });
+
+    // Laps of the running race from index "since" on, so clients can catch up
+    server.on("/timer/laps", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        uint32_t since = request->hasParam("since") ? request->getParam("since")->value().toInt() : 0;
+        uint32_t count = timer->getLapCount();
+        
+        DynamicJsonDocument doc(16384);
+        doc["count"] = count;
+        JsonArray lapsArray = doc.createNestedArray("laps");
+        lap_record_t lap;
+        for (uint32_t i = since; i < count && !doc.overflowed(); i++) {
+            if (!timer->getLap(i, lap)) break;
+            JsonObject lapObj = lapsArray.createNestedObject();
+            lapObj["index"] = i;
+            lapObj["lapTime"] = lap.lapTimeMs;
+            lapObj["timestamp"] = lap.timestampMs;
+            lapObj["peakRssi"] = lap.peakRssi;
+        }
+        
+        String json;
+        serializeJson(doc, json);
+        request->send(200, "application/json", json);
+    });
+
     server.on("/timer/lap", HTTP_POST, [this](AsyncWebServerRequest *request) {
 #ifdef ESP32S3
         if (g_rgbLed) {
@@ -429,6 +766,7 @@ EEPROM:\n\
         JsonObject jsonObj = json.as<JsonObject>();
         if (jsonObj.containsKey("lapTime")) {
             uint32_t lapTimeMs = jsonObj["lapTime"].as<uint32_t>();
+            timer->addManualLap(lapTimeMs);
             if (transportMgr) {
                 transportMgr->broadcastLapEvent(lapTimeMs);
             }
@@ -480,19 +818,8 @@ EEPROM:\n\
     server.on("^\\/sounds_.+\\/.+\\.mp3$", HTTP_GET, [this](AsyncWebServerRequest *request) {
         String path = request->url();
         
-#ifdef ESP32S3
-        // Try SD card first if available
-        if (storage->isSDAvailable() && SD.exists(path)) {
-            DEBUG("Serving audio from SD: %s\n", path.c_str());
-            request->send(SD, path, "audio/mpeg");
-            return;
-        }
-#endif
-        
-        // Fall back to LittleFS
-        if (LittleFS.exists(path)) {
-            DEBUG("Serving audio from LittleFS: %s\n", path.c_str());
-            request->send(LittleFS, path, "audio/mpeg");
+        // SD first if mounted, then LittleFS
+        if (serveCachedFile(request, path, "audio/mpeg", CACHE_CONTROL_IMMUTABLE)) {
             return;
         }
         
@@ -505,19 +832,8 @@ EEPROM:\n\
     server.on("^\\/sounds\\/.+\\.mp3$", HTTP_GET, [this](AsyncWebServerRequest *request) {
         String path = request->url();
         
-#ifdef ESP32S3
-        // Try SD card first if available
-        if (storage->isSDAvailable() && SD.exists(path)) {
-            DEBUG("Serving audio from SD: %s\n", path.c_str());
-            request->send(SD, path, "audio/mpeg");
-            return;
-        }
-#endif
-        
-        // Fall back to LittleFS
-        if (LittleFS.exists(path)) {
-            DEBUG("Serving audio from LittleFS: %s\n", path.c_str());
-            request->send(LittleFS, path, "audio/mpeg");
+        // SD first if mounted, then LittleFS
+        if (serveCachedFile(request, path, "audio/mpeg", CACHE_CONTROL_IMMUTABLE)) {
             return;
         }
         
@@ -526,6 +842,43 @@ EEPROM:\n\
         request->send(404, "text/plain", "Audio file not found");
     });
     
+    // Whole voice directory as one tar archive for the client-side audio cache
+    server.on("/voices/bundle", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        String dir = request->hasParam("dir") ? request->getParam("dir")->value() : "";
+        if (!VoicePackBundle::isValidDir(dir)) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Invalid voice directory\"}");
+            return;
+        }
+        std::shared_ptr<VoicePackBundle> bundle = std::make_shared<VoicePackBundle>();
+        if (!bundle->open(storage, dir)) {
+            request->send(404, "application/json", "{\"status\": \"ERROR\", \"message\": \"Voice pack not found\"}");
+            return;
+        }
+        if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == bundle->getETag()) {
+            AsyncWebServerResponse *response = request->beginResponse(304);
+            response->addHeader("ETag", bundle->getETag());
+            request->send(response);
+            return;
+        }
+        AsyncWebServerResponse *response = request->beginResponse("application/x-tar", bundle->totalSize(), [bundle](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return bundle->read(buffer, maxLen);
+        });
+        response->addHeader("ETag", bundle->getETag());
+        response->addHeader("Cache-Control", CACHE_CONTROL_REVALIDATE);
+        request->send(response);
+        led->on(200);
+    });
+    
+    // Track images can be replaced under the same name - always revalidated,
+    // and re-resolved so a fresh upload is picked up straight away
+    server.on("^\\/tracks\\/images\\/[0-9]+\\.(jpg|png)$", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        String path = request->url();
+        fileCache.invalidate(path);
+        if (!serveCachedFile(request, path, path.endsWith(".png") ? "image/png" : "image/jpeg", CACHE_CONTROL_REVALIDATE)) {
+            request->send(404, "text/plain", "Image not found");
+        }
+    });
+    
     // WiFi status endpoint (register before serveStatic to prevent VFS errors)
     server.on("/api/wifi", HTTP_GET, [this](AsyncWebServerRequest *request) {
         DynamicJsonDocument doc(512);
@@ -560,8 +913,13 @@ EEPROM:\n\
         led->on(200);
     });
     
-    // Serve other static files from LittleFS only
-    server.serveStatic("/", LittleFS, "/").setCacheControl("max-age=600");
+    // Fingerprinted build output (tools/build_web_assets.py) never changes
+    // under the same name; .gz variants are picked up by serveStatic
+    server.serveStatic("/assets/", LittleFS, "/assets/").setCacheControl(CACHE_CONTROL_IMMUTABLE);
+
+    // Serve other static files from LittleFS only. Pages are revalidated so
+    // they always point at the current assets.
+    server.serveStatic("/", LittleFS, "/").setCacheControl(CACHE_CONTROL_REVALIDATE);
 
     events.onConnect([this](AsyncEventSourceClient *client) {
         if (client->lastId()) {
@@ -582,17 +940,59 @@ EEPROM:\n\
     server.addHandler(configJsonHandler);
 
     // Race history endpoints
+    // Streamed a race at a time, so memory use doesn't grow with the history
     server.on("/races", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        String json = history->toJsonString();
-        request->send(200, "application/json", json);
+        std::shared_ptr<RaceListStream> stream = std::make_shared<RaceListStream>();
+        stream->history = history;
+        stream->print("{\"races\":[");
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return stream->fill(buffer, maxLen);
+            });
+        response->addHeader("Cache-Control", "no-store");
+        request->send(response);
+        led->on(200);
+    });
+
+    // Per pilot/track bests and lap statistics, optionally filtered
+    server.on("/stats", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        String pilot = request->hasParam("pilot") ? request->getParam("pilot")->value() : "";
+        uint32_t trackId = request->hasParam("trackId") ? strtoul(request->getParam("trackId")->value().c_str(), nullptr, 10) : 0;
+        std::shared_ptr<LeaderboardStream> stream = std::make_shared<LeaderboardStream>();
+        history->getLeaderboard().getEntries(stream->entries, pilot, trackId);
+        stream->print("{\"entries\":[");
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return stream->fill(buffer, maxLen);
+            });
+        response->addHeader("Cache-Control", "no-store");
+        request->send(response);
+        led->on(200);
+    });
+
+    // Races and tracks changed since the client's last sync (see ChangeLog)
+    server.on("/sync", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!changes) {
+            request->send(503, "application/json", "{\"status\": \"ERROR\", \"message\": \"Sync not available\"}");
+            return;
+        }
+        uint32_t since = request->hasParam("since") ? strtoul(request->getParam("since")->value().c_str(), nullptr, 10) : 0;
+        uint32_t epoch = request->hasParam("epoch") ? strtoul(request->getParam("epoch")->value().c_str(), nullptr, 10) : 0;
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        changes->writeSyncJson(*response, epoch, since, history, trackManager);
+        request->send(response);
         led->on(200);
     });
 
     server.on("/races/download", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        String json = history->toJsonString();
-        AsyncWebServerResponse *response = request->beginResponse(200, "application/octet-stream", json);
+        std::shared_ptr<RaceListStream> stream = std::make_shared<RaceListStream>();
+        stream->history = history;
+        stream->print("{\"races\":[");
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return stream->fill(buffer, maxLen);
+            });
         response->addHeader("Content-Disposition", "attachment; filename=\"races.json\"");
-        response->addHeader("Content-Type", "application/json");
         request->send(response);
         led->on(200);
     });
@@ -601,30 +1001,12 @@ EEPROM:\n\
         JsonObject jsonObj = json.as<JsonObject>();
         
         RaceSession race;
-        race.timestamp = jsonObj["timestamp"];
-        race.fastestLap = jsonObj["fastestLap"];
-        race.medianLap = jsonObj["medianLap"];
-        race.best3LapsTotal = jsonObj["best3LapsTotal"];
-        race.pilotName = jsonObj["pilotName"] | "";
-        race.pilotCallsign = jsonObj["pilotCallsign"] | "";
-        race.frequency = jsonObj["frequency"] | 0;
-        race.band = jsonObj["band"] | "";
-        race.channel = jsonObj["channel"] | 0;
-        
-        DEBUG("Parsing race save: trackId=%u\n", (uint32_t)(jsonObj["trackId"] | 0));
-        race.trackId = jsonObj["trackId"] | 0;
-        race.trackName = jsonObj["trackName"] | "";
-        DEBUG("Parsing totalDistance...\n");
-        race.totalDistance = jsonObj["totalDistance"] | 0.0;
-        DEBUG("Parsed totalDistance=%.2f\n", race.totalDistance);
-        
-        JsonArray lapsArray = jsonObj["lapTimes"];
-        for (uint32_t lap : lapsArray) {
-            race.lapTimes.push_back(lap);
-        }
+        RaceHistory::raceFromJson(jsonObj, race);
+        // Stats are always computed on the device so every client agrees
+        RaceHistory::computeStats(race);
         
         bool success = history->saveRace(race);
-        request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
+        request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
         led->on(200);
     });
 
@@ -640,7 +1022,7 @@ EEPROM:\n\
         if (request->hasParam("timestamp", true)) {
             uint32_t timestamp = request->getParam("timestamp", true)->value().toInt();
             bool success = history->deleteRace(timestamp);
-            request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
+            request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
         } else {
             request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Missing timestamp\"}");
         }
@@ -649,7 +1031,7 @@ EEPROM:\n\
 
     server.on("/races/clear", HTTP_POST, [this](AsyncWebServerRequest *request) {
         bool success = history->clearAll();
-        request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
+        request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
         led->on(200);
     });
 
@@ -665,13 +1047,64 @@ EEPROM:\n\
                 totalDistance = request->getParam("totalDistance", true)->value().toFloat();
             }
             bool success = history->updateRace(timestamp, name, tag, totalDistance);
-            request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
+            request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
         } else {
             request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Missing parameters\"}");
         }
         led->on(200);
     });
 
+    // Single lap correction; only the stats it touches are recomputed
+    server.on("/races/editLap", HTTP_POST, [this](AsyncWebServerRequest *request) {
+        uint8_t op;
+        if (!request->hasParam("timestamp", true) || !request->hasParam("op", true) ||
+            !request->hasParam("index", true) ||
+            !RaceHistory::parseLapEditOp(request->getParam("op", true)->value(), op)) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Missing parameters\"}");
+            return;
+        }
+        uint32_t timestamp = request->getParam("timestamp", true)->value().toInt();
+        size_t index = request->getParam("index", true)->value().toInt();
+        uint32_t lapTime = request->hasParam("lapTime", true) ? request->getParam("lapTime", true)->value().toInt() : 0;
+        
+        RaceSession race;
+        if (!history->editLap(timestamp, op, index, lapTime) || !history->findRace(timestamp, race)) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Invalid lap edit\"}");
+            return;
+        }
+        char buf[192];
+        snprintf(buf, sizeof(buf),
+                 "{\"status\": \"OK\", \"pending\": true, \"lapCount\": %u, \"fastestLap\": %u, \"medianLap\": %u, \"best3LapsTotal\": %u, \"best3ConsecutiveTotal\": %u}",
+                 (unsigned)race.lapTimes.size(), race.fastestLap, race.medianLap,
+                 race.best3LapsTotal, race.best3ConsecutiveTotal);
+        request->send(200, "application/json", buf);
+        led->on(200);
+    });
+
+    // Lap corrections of one race in one request, applied all or none
+    AsyncCallbackJsonWebHandler *editLapsHandler = new AsyncCallbackJsonWebHandler("/races/editLaps", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        JsonObject jsonObj = json.as<JsonObject>();
+        std::vector<lap_edit_t> edits;
+        if (!jsonObj.containsKey("timestamp") || !RaceHistory::lapEditsFromJson(jsonObj["edits"], edits)) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Missing parameters\"}");
+            return;
+        }
+        uint32_t timestamp = jsonObj["timestamp"];
+        
+        RaceSession race;
+        if (!history->editLaps(timestamp, edits) || !history->findRace(timestamp, race)) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Invalid lap edit, race unchanged\"}");
+            return;
+        }
+        char buf[192];
+        snprintf(buf, sizeof(buf),
+                 "{\"status\": \"OK\", \"pending\": true, \"lapCount\": %u, \"fastestLap\": %u, \"medianLap\": %u, \"best3LapsTotal\": %u, \"best3ConsecutiveTotal\": %u}",
+                 (unsigned)race.lapTimes.size(), race.fastestLap, race.medianLap,
+                 race.best3LapsTotal, race.best3ConsecutiveTotal);
+        request->send(200, "application/json", buf);
+        led->on(200);
+    });
+
     AsyncCallbackJsonWebHandler *updateLapsHandler = new AsyncCallbackJsonWebHandler("/races/updateLaps", [this](AsyncWebServerRequest *request, JsonVariant &json) {
         JsonObject jsonObj = json.as<JsonObject>();
         
@@ -689,49 +1122,247 @@ EEPROM:\n\
         }
         
         bool success = history->updateLaps(timestamp, lapTimes);
+        request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
+        led->on(200);
+    });
+
+    // Shadow detector: settings, its laps and how they compare to the live ones
+    server.on("/shadow", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        lap_detector_config_t config = timer->getShadowConfig();
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        response->printf("{\"enabled\":%s,\"config\":{\"enterRssi\":%u,\"exitRssi\":%u,\"minLap\":%u,"
+                         "\"smoothing\":%u,\"peakMargin\":%u,\"filterQ\":%u,\"filterR\":%u},",
+                         timer->isShadowEnabled() ? "true" : "false", config.enterRssi, config.exitRssi,
+                         config.minLapMs, config.smoothing, config.peakMargin, config.filterQ, config.filterR);
+        lap_compare_t report;
+        if (timer->getShadowReport(report)) {
+            response->printf("\"report\":{\"livePasses\":%u,\"shadowPasses\":%u,\"matched\":%u,\"missed\":%u,"
+                             "\"extra\":%u,\"meanPassDeltaMs\":%d,\"maxPassDeltaMs\":%u,\"lapsCompared\":%u,"
+                             "\"meanLapDeltaMs\":%d,\"maxLapDeltaMs\":%u},",
+                             report.livePasses, report.shadowPasses, report.matched, report.missed, report.extra,
+                             report.meanPassDeltaMs, report.maxPassDeltaMs, report.lapsCompared,
+                             report.meanLapDeltaMs, report.maxLapDeltaMs);
+        }
+        const LapLog &laps = timer->getShadowLaps();
+        uint32_t count = laps.size();
+        response->print("\"laps\":[");
+        for (uint32_t i = 0; i < count; i++) {
+            response->printf("%s{\"lapTime\":%u,\"timestamp\":%u,\"peakRssi\":%u}", i > 0 ? "," : "",
+                             laps[i].lapTimeMs, laps[i].timestampMs, laps[i].peakRssi);
+        }
+        response->print("]}");
+        request->send(response);
+        led->on(200);
+    });
+
+    AsyncCallbackJsonWebHandler *shadowConfigHandler = new AsyncCallbackJsonWebHandler("/shadow", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        JsonObject jsonObj = json.as<JsonObject>();
+        // Fields left out keep their current value
+        lap_detector_config_t config = timer->getShadowConfig();
+        bool enabled = jsonObj["enabled"] | timer->isShadowEnabled();
+        config.enterRssi = jsonObj["enterRssi"] | config.enterRssi;
+        config.exitRssi = jsonObj["exitRssi"] | config.exitRssi;
+        config.minLapMs = jsonObj["minLap"] | config.minLapMs;
+        config.smoothing = jsonObj["smoothing"] | config.smoothing;
+        config.peakMargin = jsonObj["peakMargin"] | config.peakMargin;
+        config.filterQ = jsonObj["filterQ"] | config.filterQ;
+        config.filterR = jsonObj["filterR"] | config.filterR;
+        if (!timer->setShadowDetector(enabled, config)) {
+            request->send(409, "application/json", "{\"status\": \"ERROR\", \"message\": \"Race running\"}");
+            return;
+        }
+        request->send(200, "application/json", "{\"status\": \"OK\"}");
+        led->on(200);
+    });
+    server.addHandler(shadowConfigHandler);
+
+    // Every receiver node; settings for nodes 1 and up are in /config "nodes"
+    server.on("/nodes", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        uint8_t nodeCount = nodes ? nodes->getNodeCount() : 1;
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        response->printf("{\"count\":%u,\"nodes\":[{\"node\":0,\"frequency\":%u,\"enterRssi\":%u,"
+                         "\"exitRssi\":%u,\"rssi\":%u,\"laps\":%u}",
+                         nodeCount, conf->getFrequency(), conf->getEnterRssi(), conf->getExitRssi(),
+                         timer->getRssi(), timer->getLapCount());
+        for (uint8_t node = 1; node < nodeCount; node++) {
+            const LapLog *laps = nodes->getLaps(node);
+            response->printf(",{\"node\":%u,\"frequency\":%u,\"enterRssi\":%u,\"exitRssi\":%u,"
+                             "\"rssi\":%u,\"laps\":%u}",
+                             node, conf->getNodeFrequency(node), conf->getNodeEnterRssi(node),
+                             conf->getNodeExitRssi(node), nodes->getRssi(node), laps ? laps->size() : 0);
+        }
+        response->print("]");
+        hop_stats_t hop;
+        if (nodes && nodes->getHopStats(hop)) {
+            response->printf(",\"hop\":{\"pilots\":%u,\"dwellMs\":%u,\"cycleMs\":%u,\"settleMs\":%u,"
+                             "\"uncertaintyMs\":%u,\"writeUs\":%u,\"serviceBusyPct\":%u,"
+                             "\"driver\":\"%s\",\"sampleRateHz\":[",
+                             hop.pilots, hop.dwellMs, hop.cycleMs, hop.settleMs, hop.uncertaintyMs,
+                             hop.writeUs, hop.serviceBusyPct, hop.spiDriver ? "spi" : "bitbang");
+            for (uint8_t i = 0; i < hop.pilots; i++) {
+                response->printf("%s%u", i > 0 ? "," : "", hop.sampleRateHz[i]);
+            }
+            response->print("]}");
+        }
+        response->print("}");
+        request->send(response);
+        led->on(200);
+    });
+
+    // Band plan with RX5808 register values, built at compile time
+    server.on("/bands", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        Bands::toJson(*response);
+        request->send(response);
+        led->on(200);
+    });
+
+    // Spectrum scanner; sweeps also go out as "spectrum" events
+    server.on("/spectrum", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!scanner) {
+            request->send(503, "application/json", "{\"status\": \"ERROR\", \"message\": \"Scanner not available\"}");
+            return;
+        }
+        String frame;
+        scanner->frameToJson(frame);
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        response->printf("{\"scanning\":%s,\"settleMs\":%u,\"frame\":", scanner->isScanning() ? "true" : "false",
+                         scanner->getSettleMs());
+        response->print(frame);
+        response->print("}");
+        request->send(response);
+        led->on(200);
+    });
+
+    AsyncCallbackJsonWebHandler *spectrumStartHandler = new AsyncCallbackJsonWebHandler("/spectrum/start", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        JsonObject jsonObj = json.as<JsonObject>();
+        if (!scanner) {
+            request->send(503, "application/json", "{\"status\": \"ERROR\", \"message\": \"Scanner not available\"}");
+            return;
+        }
+        if (timer->isRaceActive()) {
+            request->send(409, "application/json", "{\"status\": \"ERROR\", \"message\": \"Race running\"}");
+            return;
+        }
+        // Range-checked before narrowing, so a step of 261 isn't taken as 5
+        uint32_t start = jsonObj["start"] | SPECTRUM_MIN_MHZ;
+        uint32_t end = jsonObj["end"] | SPECTRUM_MAX_MHZ;
+        uint32_t step = jsonObj["step"] | SPECTRUM_DEFAULT_STEP;
+        if (start > SPECTRUM_MAX_MHZ || end > SPECTRUM_MAX_MHZ || step == 0 || step > UINT8_MAX ||
+            !scanner->start(start, end, step)) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Invalid range\"}");
+            return;
+        }
+        request->send(200, "application/json", "{\"status\": \"OK\"}");
+        led->on(200);
+    });
+    server.addHandler(spectrumStartHandler);
+
+    server.on("/spectrum/stop", HTTP_POST, [this](AsyncWebServerRequest *request) {
+        if (scanner) {
+            scanner->stop();
+        }
+        request->send(200, "application/json", "{\"status\": \"OK\"}");
+        led->on(200);
+    });
+
+    // Raw RSSI race recordings on SD
+    server.on("/rawrssi", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        RssiRecorder *rawRecorder = timer->getRssiRecorder();
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        if (rawRecorder) {
+            rawRecorder->listToJson(*response);
+        } else {
+            response->print("{\"recording\":false,\"recordings\":[]}");
+        }
+        request->send(response);
+        led->on(200);
+    });
+
+    server.on("/rawrssi/download", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!request->hasParam("timestamp")) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Missing timestamp\"}");
+            return;
+        }
+        uint32_t timestamp = request->getParam("timestamp")->value().toInt();
+        String path = RssiRecorder::recordingPath(timestamp);
+        File file = storage->openFile(path, "r");
+        if (!file) {
+            request->send(404, "application/json", "{\"status\": \"ERROR\", \"message\": \"Recording not found\"}");
+            return;
+        }
+        String filename = "rawrssi_" + String(timestamp) + ".bin";
+        AsyncWebServerResponse *response = request->beginResponse(file, filename, "application/octet-stream", true);
+        request->send(response);
+        led->on(200);
+    });
+
+    server.on("/rawrssi/delete", HTTP_POST, [this](AsyncWebServerRequest *request) {
+        RssiRecorder *rawRecorder = timer->getRssiRecorder();
+        if (!rawRecorder || !request->hasParam("timestamp", true)) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Missing timestamp\"}");
+            return;
+        }
+        bool success = rawRecorder->deleteRecording(request->getParam("timestamp", true)->value().toInt());
         request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
         led->on(200);
     });
 
+    // RSSI around every pass candidate: a saved race, or the current one
+    // Streamed a trace at a time, so memory use doesn't grow with the race
+    server.on("/races/trace", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        std::shared_ptr<TraceStream> stream = std::make_shared<TraceStream>();
+        if (request->hasParam("timestamp")) {
+            stream->history = history;
+            stream->timestamp = request->getParam("timestamp")->value().toInt();
+            if (!history->readTraceHeader(stream->timestamp, stream->header)) {
+                request->send(404, "application/json", "{\"status\": \"ERROR\", \"message\": \"No traces for this race\"}");
+                return;
+            }
+            stream->printf("{\"timestamp\":%u,\"intervalMs\":%u,\"dropped\":%u,\"traces\":[",
+                           stream->timestamp, stream->header.intervalMs, stream->header.dropped);
+        } else {
+            const PassTraceLog &traces = timer->getPassTraces();
+            stream->live = &traces;
+            stream->generation = traces.getGeneration();
+            stream->header.count = traces.size();
+            stream->header.intervalMs = PASSTRACE_INTERVAL_MS;
+            stream->header.dropped = traces.getDropped();
+            stream->printf("{\"intervalMs\":%u,\"dropped\":%u,\"traces\":[", PASSTRACE_INTERVAL_MS, stream->header.dropped);
+        }
+        
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return stream->fill(buffer, maxLen);
+            });
+        response->addHeader("Cache-Control", "no-store");
+        request->send(response);
+        led->on(200);
+    });
+
     server.on("/races/downloadOne", HTTP_GET, [this](AsyncWebServerRequest *request) {
         if (request->hasParam("timestamp")) {
             uint32_t timestamp = request->getParam("timestamp")->value().toInt();
             
             // Find the race
-            const auto& races = history->getRaces();
-            for (const auto& race : races) {
-                if (race.timestamp == timestamp) {
-                    // Create JSON for single race
-                    DynamicJsonDocument doc(16384);
-                    JsonArray racesArray = doc.createNestedArray("races");
-                    JsonObject raceObj = racesArray.createNestedObject();
-                    raceObj["timestamp"] = race.timestamp;
-                    raceObj["fastestLap"] = race.fastestLap;
-                    raceObj["medianLap"] = race.medianLap;
-                    raceObj["best3LapsTotal"] = race.best3LapsTotal;
-                    raceObj["name"] = race.name;
-                    raceObj["tag"] = race.tag;
-                    raceObj["pilotName"] = race.pilotName;
-                    raceObj["pilotCallsign"] = race.pilotCallsign;
-                    raceObj["frequency"] = race.frequency;
-                    raceObj["band"] = race.band;
-                    raceObj["channel"] = race.channel;
-                    JsonArray lapsArray = raceObj.createNestedArray("lapTimes");
-                    for (uint32_t lap : race.lapTimes) {
-                        lapsArray.add(lap);
-                    }
-                    
-                    String json;
-                    serializeJson(doc, json);
-                    
-                    String filename = "race_" + String(timestamp) + ".json";
-                    AsyncWebServerResponse *response = request->beginResponse(200, "application/octet-stream", json);
-                    response->addHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
-                    response->addHeader("Content-Type", "application/json");
-                    request->send(response);
-                    led->on(200);
-                    return;
-                }
+            RaceSession race;
+            if (history->findRace(timestamp, race)) {
+                // Create JSON for single race
+                DynamicJsonDocument doc(16384);
+                JsonArray racesArray = doc.createNestedArray("races");
+                JsonObject raceObj = racesArray.createNestedObject();
+                RaceHistory::raceToJson(race, raceObj);
+                
+                String json;
+                serializeJson(doc, json);
+                
+                String filename = "race_" + String(timestamp) + ".json";
+                AsyncWebServerResponse *response = request->beginResponse(200, "application/octet-stream", json);
+                response->addHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
+                response->addHeader("Content-Type", "application/json");
+                request->send(response);
+                led->on(200);
+                return;
             }
             request->send(404, "application/json", "{\"status\": \"ERROR\", \"message\": \"Race not found\"}");
         } else {
@@ -743,11 +1374,13 @@ EEPROM:\n\
     server.addHandler(raceSaveHandler);
     server.addHandler(raceUploadHandler);
     server.addHandler(updateLapsHandler);
+    server.addHandler(editLapsHandler);
 
     // Track endpoints
     server.on("/tracks", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        String json = trackManager->toJsonString();
-        request->send(200, "application/json", json);
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        trackManager->toJson(*response);
+        request->send(response);
         led->on(200);
     });
 
@@ -763,7 +1396,7 @@ EEPROM:\n\
         track.imagePath = "";
         
         bool success = trackManager->createTrack(track);
-        request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
+        request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
         led->on(200);
     });
 
@@ -784,7 +1417,7 @@ EEPROM:\n\
         updatedTrack.notes = jsonObj["notes"] | "";
         
         bool success = trackManager->updateTrack(trackId, updatedTrack);
-        request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
+        request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
         led->on(200);
     });
 
@@ -799,13 +1432,62 @@ EEPROM:\n\
                 timer->setTrack(nullptr);
             }
             
-            request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
+            request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
         } else {
             request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Missing trackId\"}");
         }
         led->on(200);
     });
 
+    // Multipart image upload, streamed to storage chunk by chunk. The upload
+    // result is handed to the request handler as a malloc'd message in
+    // _tempObject (freed by the request): empty on success.
+    server.on("/tracks/image", HTTP_POST, [this](AsyncWebServerRequest *request) {
+        const char *error = (const char *)request->_tempObject;
+        if (!error) {
+            request->send(400, "application/json", "{\"status\": \"ERROR\", \"message\": \"Missing image\"}");
+        } else if (error[0] != '\0') {
+            DynamicJsonDocument doc(256);
+            doc["status"] = "ERROR";
+            doc["message"] = error;
+            String response;
+            serializeJson(doc, response);
+            request->send(400, "application/json", response);
+        } else {
+            request->send(200, "application/json", "{\"status\": \"OK\"}");
+        }
+        led->on(200);
+    }, [this](AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+        if (index == 0) {
+            if (request->_tempObject) {
+                return;  // Only the first file part is used
+            }
+            uint32_t trackId = 0;
+            if (request->hasParam("trackId")) {
+                trackId = request->getParam("trackId")->value().toInt();
+            } else if (request->hasParam("trackId", true)) {
+                trackId = request->getParam("trackId", true)->value().toInt();
+            }
+            if (!trackManager->beginImageUpload(request, trackId, request->contentLength())) {
+                request->_tempObject = strdup("Upload rejected");
+                return;
+            }
+            request->onDisconnect([this, request]() {
+                trackManager->abortImageUpload(request);
+            });
+        }
+
+        trackManager->writeImageChunk(request, data, len);
+
+        if (final) {
+            String error;
+            bool success = trackManager->finishImageUpload(request, error);
+            if (!request->_tempObject) {
+                request->_tempObject = strdup(success ? "" : error.c_str());
+            }
+        }
+    });
+
     server.on("/tracks/select", HTTP_POST, [this](AsyncWebServerRequest *request) {
         if (request->hasParam("trackId", true)) {
             uint32_t trackId = request->getParam("trackId", true)->value().toInt();
@@ -840,7 +1522,7 @@ EEPROM:\n\
             timer->setTrack(nullptr);
         }
         
-        request->send(200, "application/json", success ? "{\"status\": \"OK\"}" : "{\"status\": \"ERROR\"}");
+        request->send(200, "application/json", success ? RESPONSE_QUEUED : "{\"status\": \"ERROR\"}");
         led->on(200);
     });
 
@@ -884,6 +1566,19 @@ EEPROM:\n\
         ESP.restart();
     });
 
+    // Background writer: queued jobs and failures since boot
+    server.on("/storage/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(256);
+        doc["type"] = storage->getStorageType();
+        doc["pending"] = storage->getPendingJobs();
+        doc["failed"] = storage->getFailedJobs();
+        doc["lastFailed"] = storage->getLastFailedPath();
+        String json;
+        serializeJson(doc, json);
+        request->send(200, "application/json", json);
+        led->on(200);
+    });
+
     // SD card initialization endpoint
     server.on("/storage/initsd", HTTP_POST, [this](AsyncWebServerRequest *request) {
         bool success = storage->initSDDeferred();
@@ -1112,18 +1807,39 @@ EEPROM:\n\
         led->on(200);
     });
 
+    server.on("/calibration/clear", HTTP_POST, [this](AsyncWebServerRequest *request) {
+        timer->clearCalibration();
+        request->send(200, "application/json", "{\"status\": \"OK\"}");
+        led->on(200);
+    });
+
+    // Columnar JSON generated from the recording as the response is sent;
+    // since= returns only samples from that index, for polling while recording
     server.on("/calibration/data", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        uint16_t count = timer->getCalibrationRssiCount();
+        CalibrationLog *calibration = timer->getCalibrationLog();
+        if (!calibration) {
+            request->send(503, "application/json", "{\"status\": \"ERROR\", \"message\": \"Calibration not available\"}");
+            return;
+        }
         
-        // Build JSON response
-        String json = "{\"count\":" + String(count) + ",\"data\":[";
-        for (uint16_t i = 0; i < count; i++) {
-            if (i > 0) json += ",";
-            json += "{\"rssi\":" + String(timer->getCalibrationRssi(i)) + ",\"time\":" + String(timer->getCalibrationTimestamp(i)) + "}";
+        std::shared_ptr<CalibrationStream> stream = std::make_shared<CalibrationStream>();
+        stream->end = calibration->size();
+        stream->since = request->hasParam("since") ? request->getParam("since")->value().toInt() : 0;
+        if (stream->since > stream->end) {
+            stream->since = stream->end;  // Recording was restarted
         }
-        json += "]}";
+        stream->textLen = snprintf(stream->text, sizeof(stream->text),
+                                   "{\"count\":%u,\"since\":%u,\"next\":%u,\"recording\":%s,\"rssi\":[",
+                                   stream->end, stream->since, stream->end,
+                                   calibration->isRecording() ? "true" : "false");
+        calibration->seek(stream->cursor, stream->since);
         
-        request->send(200, "application/json", json);
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [calibration, stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return stream->fill(calibration, buffer, maxLen);
+            });
+        response->addHeader("Cache-Control", "no-store");
+        request->send(response);
         led->on(200);
     });
 
@@ -1156,7 +1872,7 @@ EEPROM:\n\
         // Run LittleFS test
         TestResult littleFSTest = selftest->testLittleFS();
         
-        // Run EEPROM test
+        // Run config storage (NVS) test
         TestResult eepromTest = selftest->testEEPROM();
         
         // Run WiFi test
@@ -2,10 +2,14 @@
 #include <WiFi.h>
 
 #include "battery.h"
+#include "changelog.h"
 #include "laptimer.h"
+#include "multinode.h"
 #include "racehistory.h"
+#include "racerecorder.h"
 #include "storage.h"
 #include "selftest.h"
+#include "spectrum.h"
 #include "transport.h"
 #include "trackmanager.h"
 #include "webhook.h"
@@ -17,14 +21,19 @@
 
 class Webserver : public TransportInterface {
    public:
-    void init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMonitor, Buzzer *buzzer, Led *l, RaceHistory *raceHist, Storage *stor, SelfTest *test, RX5808 *rx5808, TrackManager *trackMgr, WebhookManager *webhookMgr);
+    void init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMonitor, Buzzer *buzzer, Led *l, RaceHistory *raceHist, Storage *stor, SelfTest *test, RX5808 *rx5808, TrackManager *trackMgr, WebhookManager *webhookMgr, RaceRecorder *raceRecorder, ChangeLog *changeLog);
     void setTransportManager(TransportManager *tm);
+    void setMultiNode(MultiNode *multiNode);
+    void setSpectrumScanner(SpectrumScanner *spectrumScanner);
     void handleWebUpdate(uint32_t currentTimeMs);
     
     // TransportInterface implementation
     void sendLapEvent(uint32_t lapTimeMs) override;
+    void sendNodeLapEvent(uint8_t node, uint32_t lapTimeMs) override;
     void sendRssiEvent(uint8_t rssi) override;
+    void sendSpectrumEvent(const char* frameJson) override;
     void sendRaceStateEvent(const char* state) override;
+    void sendStorageErrorEvent(const char* path) override;
     bool isConnected() override;
     void update(uint32_t currentTimeMs) override;
 
@@ -42,7 +51,11 @@ class Webserver : public TransportInterface {
     RX5808 *rx;
     TrackManager *trackManager;
     WebhookManager *webhooks;
+    RaceRecorder *recorder;
+    ChangeLog *changes;
     TransportManager *transportMgr;
+    MultiNode *nodes = nullptr;
+    SpectrumScanner *scanner = nullptr;
 
     wifi_mode_t wifiMode = WIFI_OFF;
     wl_status_t lastStatus = WL_IDLE_STATUS;
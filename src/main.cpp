@@ -1,9 +1,16 @@
 #include "debug.h"
+#include "calibrationlog.h"
+#include "changelog.h"
 #include "led.h"
+#include "multinode.h"
 #include "webserver.h"
 #include "racehistory.h"
+#include "racejournal.h"
+#include "racerecorder.h"
+#include "rssirecorder.h"
 #include "storage.h"
 #include "selftest.h"
+#include "spectrum.h"
 #include "transport.h"
 #include "trackmanager.h"
 #include "usb.h"
@@ -53,7 +60,12 @@ static USBTransport usbTransport;
 static TransportManager transportManager;
 static Buzzer buzzer;
 static Led led;
+static CalibrationLog calibrationLog;
+static ChangeLog changeLog;
 static RaceHistory raceHistory;
+static RaceJournal raceJournal;
+static RaceRecorder raceRecorder;
+static RssiRecorder rssiRecorder;
 static TrackManager trackManager;
 static WebhookManager webhookManager;
 #ifdef ESP32S3
@@ -63,6 +75,11 @@ RgbLed* g_rgbLed = &rgbLed;
 void* g_rgbLed = nullptr;
 #endif
 static LapTimer timer;
+static MultiNode nodes;  // Receivers beyond the timer's own
+static SpectrumScanner scanner;
+static uint32_t spectrumSeq = 0;  // Last sweep broadcast
+static uint32_t storageFailures = 0;  // Failed background writes reported so far
+static uint32_t raceStateSeq = 0;  // Last race start/stop broadcast
 // Battery monitoring removed - legacy feature no longer used
 // static BatteryMonitor monitor;
 
@@ -80,7 +97,13 @@ static void parallelTask(void *pvArgs) {
         ws.handleWebUpdate(currentTimeMs);
         usbTransport.update(currentTimeMs);
         config.handleEeprom(currentTimeMs);
-        rx.handleFrequencyChange(currentTimeMs, config.getFrequency());
+        raceJournal.handleJournal(currentTimeMs);
+        raceRecorder.handleRecorder(currentTimeMs);
+        // The scanner has the receiver to itself while it runs
+        if (!scanner.handleScan(currentTimeMs, timer.isRaceActive())) {
+            rx.handleFrequencyChange(currentTimeMs, config.getFrequency());
+            nodes.handleFrequencyChange(currentTimeMs, timer.isRaceActive());
+        }
         // Battery monitoring removed
         // monitor.checkBatteryState(currentTimeMs, config.getAlarmThreshold());
         buzzer.handleBuzzer(currentTimeMs);
@@ -149,6 +172,11 @@ void setup() {
 #endif
     
     // Note: config.init() already called above
+    // Mount LittleFS early so race history, tracks and the race journal are readable during setup
+    storage.init();
+    raceJournal.init(&storage);
+    calibrationLog.init(&storage);
+    rssiRecorder.init(&storage);
     rx.init();
     buzzer.init(PIN_BUZZER, BUZZER_INVERTED);
     led.init(PIN_LED, false);
@@ -164,7 +192,8 @@ void setup() {
     // Apply preset last so all colors are set
     rgbLed.setPreset((led_preset_e)config.getLedPreset());
 #endif
-    timer.init(&config, &rx, &buzzer, &led, &webhookManager);
+    timer.init(&config, &rx, &buzzer, &led, &webhookManager, &raceJournal, &raceRecorder, &calibrationLog, &rssiRecorder);
+    raceStateSeq = timer.getRaceStateSeq();  // Nothing to announce for the initial stop
     // Battery monitoring removed
     // monitor.init(PIN_VBAT, VBAT_SCALE, VBAT_ADD, &buzzer, &led);
     
@@ -173,14 +202,19 @@ void setup() {
     
     // Initialize race history with storage backend
     // Note: This uses LittleFS initially; SD card will be mounted later in loop()
-    if (raceHistory.init(&storage)) {
+    changeLog.init(&storage);
+    if (raceHistory.init(&storage, &changeLog)) {
         DEBUG("Race history initialized, %d races loaded\n", raceHistory.getRaceCount());
     } else {
         DEBUG("Race history initialization failed\n");
     }
     
+    raceRecorder.init(&config, &raceHistory, &timer);
+    nodes.init(&config, &raceRecorder, &rx);
+    scanner.init(&rx);
+    
     // Initialize track manager
-    if (trackManager.init(&storage)) {
+    if (trackManager.init(&storage, &changeLog)) {
         DEBUG("Track manager initialized, %d tracks loaded\n", trackManager.getTrackCount());
     } else {
         DEBUG("Track manager initialization failed\n");
@@ -205,10 +239,10 @@ void setup() {
         }
     }
     
-    ws.init(&config, &timer, nullptr, &buzzer, &led, &raceHistory, &storage, &selfTest, &rx, &trackManager, &webhookManager);
+    ws.init(&config, &timer, nullptr, &buzzer, &led, &raceHistory, &storage, &selfTest, &rx, &trackManager, &webhookManager, &raceRecorder, &changeLog);
     
     // Initialize USB transport
-    usbTransport.init(&config, &timer, nullptr, &buzzer, &led, &raceHistory, &storage, &selfTest, &rx, &trackManager);
+    usbTransport.init(&config, &timer, nullptr, &buzzer, &led, &raceHistory, &storage, &selfTest, &rx, &trackManager, &raceRecorder, &changeLog);
     
     // Register transports with TransportManager
     transportManager.addTransport(&ws);
@@ -216,6 +250,8 @@ void setup() {
     
     // Set TransportManager in webserver for event broadcasting
     ws.setTransportManager(&transportManager);
+    ws.setMultiNode(&nodes);
+    ws.setSpectrumScanner(&scanner);
     
     DEBUG("Transport system initialized (WiFi + USB)\n");
     
@@ -247,12 +283,40 @@ void loop() {
     // Timing always runs
     timer.handleLapTimerUpdate(currentTimeMs);
     
+    // Start/stop from the web or USB lands here, one event per change
+    if (timer.getRaceStateSeq() != raceStateSeq) {
+        raceStateSeq = timer.getRaceStateSeq();
+        transportManager.broadcastRaceStateEvent(timer.isRaceActive() ? "started" : "stopped");
+    }
+    
     // Broadcast lap events to all transports (WiFi + USB)
     if (timer.isLapAvailable()) {
         uint32_t lapTime = timer.getLapTime();
         transportManager.broadcastLapEvent(lapTime);
     }
     
+    // Extra receivers, sampled right after the timer's
+    nodes.scan(currentTimeMs, timer.isRaceActive(), timer.getRaceStartMs());
+    uint8_t node;
+    uint32_t nodeLapTime;
+    while (nodes.popLap(node, nodeLapTime)) {
+        transportManager.broadcastNodeLapEvent(node, nodeLapTime);
+    }
+    
+    // One message per spectrum sweep
+    if (scanner.getFrameSeq() != spectrumSeq) {
+        String frame;
+        spectrumSeq = scanner.frameToJson(frame);
+        transportManager.broadcastSpectrumEvent(frame.c_str());
+    }
+    
+    // Background writes answer their callers before they land; failures
+    // are reported here
+    if (storage.getFailedJobs() != storageFailures) {
+        storageFailures = storage.getFailedJobs();
+        transportManager.broadcastStorageErrorEvent(storage.getLastFailedPath().c_str());
+    }
+    
     // WiFi mode - original behavior (RotorHazard mode disabled)
     ElegantOTA.loop();
     
@@ -271,6 +335,9 @@ void loop() {
                 DEBUG("Recommend: delete /sounds from LittleFS to reclaim space\n");
             }
             
+            // The card holds its own data set, and its own change log
+            changeLog.load();
+            
             // Reload race history from SD card
             if (raceHistory.loadRaces()) {
                 DEBUG("Race history reloaded from SD card, %d races available\n", raceHistory.getRaceCount());
@@ -296,6 +363,12 @@ void loop() {
         } else {
             DEBUG("SD card not available - using LittleFS only\n");
         }
+        
+        // Race history is on its final backend now; recover a race that was
+        // still running when power was lost (the journal itself is on LittleFS)
+        if (raceJournal.recover(&raceHistory, config.getPilotName())) {
+            DEBUG("Unfinished race recovered from journal\n");
+        }
     }
     
     /* DISABLED: RotorHazard mode loop
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Build the LittleFS image contents from data/
+
+- JS and CSS are minified (when rjsmin / rcssmin are installed), gzipped and
+  fingerprinted: data/script.js -> assets/script.<hash>.js.gz
+- HTML is rewritten to reference the fingerprinted names and gzipped
+- Other text files (svg, ico, json) are gzipped under their own name
+- Everything else (voice packs, images) is copied as-is
+
+Only the .gz variant of a compressed file is written; the webserver serves it
+with Content-Encoding: gzip. Fingerprinted files never change under the same
+name, so they are served with an immutable cache lifetime.
+
+Usage:
+    python tools/build_web_assets.py [--src data] [--out data_build]
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import os
+import re
+import shutil
+import sys
+
+try:
+    import rjsmin
+except ImportError:
+    rjsmin = None
+
+try:
+    import rcssmin
+except ImportError:
+    rcssmin = None
+
+HASHED_EXTENSIONS = ('.js', '.css')
+GZIP_EXTENSIONS = ('.html', '.svg', '.ico', '.json', '.txt')
+ASSETS_DIR = 'assets'
+HASH_LENGTH = 8
+
+
+def minify(name, data):
+    if name.endswith('.min.js') or name.endswith('.min.css'):
+        return data
+    if name.endswith('.js') and rjsmin:
+        return rjsmin.jsmin(data.decode('utf-8')).encode('utf-8')
+    if name.endswith('.css') and rcssmin:
+        return rcssmin.cssmin(data.decode('utf-8')).encode('utf-8')
+    return data
+
+
+def write_gzip(path, data):
+    # mtime=0 keeps the output byte-identical between builds
+    with open(path, 'wb') as f:
+        with gzip.GzipFile(filename='', mode='wb', fileobj=f, compresslevel=9, mtime=0) as gz:
+            gz.write(data)
+    return os.path.getsize(path)
+
+
+def build(src, out):
+    if os.path.exists(out):
+        shutil.rmtree(out)
+    os.makedirs(os.path.join(out, ASSETS_DIR))
+
+    manifest = {}
+    html_files = []
+    size_in = 0
+    size_out = 0
+
+    # Fingerprinted assets first, so HTML can be rewritten against the manifest
+    for name in sorted(os.listdir(src)):
+        path = os.path.join(src, name)
+        if not os.path.isfile(path) or not name.endswith(HASHED_EXTENSIONS):
+            continue
+        with open(path, 'rb') as f:
+            data = f.read()
+        minified = minify(name, data)
+        digest = hashlib.sha256(minified).hexdigest()[:HASH_LENGTH]
+        base, ext = os.path.splitext(name)
+        hashed = '%s/%s.%s%s' % (ASSETS_DIR, base, digest, ext)
+        size_in += len(data)
+        size_out += write_gzip(os.path.join(out, hashed + '.gz'), minified)
+        manifest[name] = hashed
+
+    for name in sorted(os.listdir(src)):
+        path = os.path.join(src, name)
+        if name in manifest:
+            continue
+        if os.path.isdir(path):
+            shutil.copytree(path, os.path.join(out, name))
+            continue
+        with open(path, 'rb') as f:
+            data = f.read()
+        if name.endswith('.html'):
+            html_files.append(name)
+            data = rewrite_html(data.decode('utf-8'), manifest).encode('utf-8')
+        if name.endswith(GZIP_EXTENSIONS):
+            size_in += len(data)
+            size_out += write_gzip(os.path.join(out, name + '.gz'), data)
+        else:
+            shutil.copyfile(path, os.path.join(out, name))
+
+    with open(os.path.join(out, ASSETS_DIR, 'manifest.json'), 'w') as f:
+        json.dump(manifest, f, indent=2, sort_keys=True)
+
+    print('Web assets: %d fingerprinted, %d pages, %d KB -> %d KB compressed' %
+          (len(manifest), len(html_files), size_in // 1024, size_out // 1024))
+    if not rjsmin or not rcssmin:
+        print('Note: install rjsmin and rcssmin to minify before compressing')
+
+
+def rewrite_html(html, manifest):
+    def replace(match):
+        attr, quote, ref = match.group(1), match.group(2), match.group(3)
+        return '%s=%s%s%s' % (attr, quote, manifest.get(ref.lstrip('/'), ref), quote)
+    return re.sub(r'\b(src|href)=(["\'])([^"\']+)\2', replace, html)
+
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description='Build compressed, fingerprinted web assets')
+    parser.add_argument('--src', default=os.path.join(root, 'data'))
+    parser.add_argument('--out', default=os.path.join(root, 'data_build'))
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.src):
+        print('Source directory not found: %s' % args.src)
+        return 1
+    build(args.src, args.out)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,16 @@
+# PlatformIO hook: rebuild data_build/ from data/ before a filesystem image
+# is built or uploaded
+Import("env")
+
+import os
+import subprocess
+import sys
+
+FS_TARGETS = ("buildfs", "uploadfs", "uploadfsota")
+
+if any(target in FS_TARGETS for target in COMMAND_LINE_TARGETS):
+    project_dir = env.subst("$PROJECT_DIR")
+    script = os.path.join(project_dir, "tools", "build_web_assets.py")
+    subprocess.check_call([sys.executable, script,
+                           "--src", os.path.join(project_dir, "data"),
+                           "--out", env.subst("$PROJECT_DATA_DIR")])